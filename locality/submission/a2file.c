@@ -0,0 +1,475 @@
+/***********************************************************************
+ *                              a2file.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the out-of-core arrays in a2file.h. Each
+ *          array has its own cache: a set of block-sized slots kept in a
+ *          doubly linked list from most to least recently used, and a
+ *          table from block to slot. at remembers the last block it
+ *          returned, so the list is only updated when an access moves to
+ *          another block. Every slot handed out by at is assumed written,
+ *          since at cannot tell a read from a write, except in arrays
+ *          opened by A2File_load_tiled, which are never written back.
+ *
+ *          Read-ahead uses posix_fadvise(POSIX_FADV_WILLNEED), which
+ *          starts the reads in the kernel and returns at once, so the
+ *          next blocks are on their way while the current one is mapped.
+ ***********************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "assert.h"
+#include "memstats.h"
+#include "storage.h"
+#include "tiled.h"
+#include "trace.h"
+#include "uarray2b_storage.h"
+#include "a2file.h"
+
+typedef A2Methods_UArray2 A2;
+
+Except_T A2File_failed = { "Out-of-core array I/O failed" };
+
+/* Blocks that map_block_major asks the kernel to read ahead */
+#define PREFETCH_BLOCKS 8
+
+static long cache_bytes = 64L * 1024 * 1024;
+
+struct A2File {
+        int width, height, size, blocksize;
+        int blocks_across, blocks_down;
+        long block_bytes, nblocks;
+        int fd;
+        long data_offset;               /* of block 0 in the file */
+        int read_only;                  /* from A2File_load_tiled */
+
+        int nslots;
+        char *slots;                    /* nslots * block_bytes */
+        long *slot_block;               /* block in each slot, or -1 */
+        char *dirty;                    /* per slot */
+        int *newer, *older;             /* the LRU list, by slot */
+        int mru, lru;
+        int *block_slot;                /* per block: its slot, or -1 */
+        char *on_disk;                  /* per block: in the file yet */
+
+        long last_block;                /* at's fast path */
+        char *last_slot;
+};
+
+static struct A2File *new_array(int width, int height, int size,
+                                int blocksize);
+static int   make_temp_file(void);
+static char *fetch(struct A2File *a, long block);
+static void  prefetch(struct A2File *a, long block, long count);
+static void  read_block(struct A2File *a, long block, char *into);
+static void  write_block(struct A2File *a, long block, const char *from);
+static long  footprint(struct A2File *a);
+
+/*
+ * A2File_set_cache
+ *    Purpose: Sets how many bytes of blocks each array made afterwards
+ *             may keep in memory
+ *    Expects: bytes > 0 (checked)
+ */
+void A2File_set_cache(long bytes)
+{
+        assert(bytes > 0);
+        cache_bytes = bytes;
+}
+
+/*
+ * A2File_load_tiled
+ *    Purpose: Opens a tiled image as an array of this suite. A regular
+ *             file is read in place, a block at a time, as the array is
+ *             used; anything else, such as a pipe, is first copied to a
+ *             temporary file a block at a time.
+ * Parameters: An open file at the start of a tiled image
+ *    Returns: The image, whose pixels use a2file_methods; free it with
+ *             Ppmio_free. It keeps its own descriptor for the file, so fp
+ *             may be closed.
+ *    Expects: fp holds a tiled image (raises Tiled_badformat otherwise);
+ *             raises A2File_failed if the file cannot be read
+ */
+Pnm_ppm A2File_load_tiled(FILE *fp)
+{
+        struct Tiled_header h;
+        struct A2File *a;
+        struct stat st;
+        Pnm_ppm pic;
+
+        assert(fp != NULL);
+        Tiled_read_header(fp, &h);
+        a = new_array(h.width, h.height, h.elem_size, h.blocksize);
+        assert(a->block_bytes == h.tile_bytes && a->nblocks == h.ntiles);
+        if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode)) {
+                close(a->fd);
+                a->fd = dup(fileno(fp));
+                if (a->fd < 0) {
+                        RAISE(A2File_failed);
+                }
+                a->data_offset = h.data_offset;
+                a->read_only   = 1;
+                memset(a->on_disk, 1, a->nblocks);
+        } else {
+                char *block = malloc(a->block_bytes);
+                assert(block != NULL);
+                for (long k = 0; k < a->nblocks; k++) {
+                        if (fread(block, a->block_bytes, 1, fp) != 1) {
+                                free(block);
+                                RAISE(Tiled_badformat);
+                        }
+                        write_block(a, k, block);
+                }
+                free(block);
+        }
+        pic = malloc(sizeof(*pic));
+        assert(pic != NULL);
+        pic->width       = h.width;
+        pic->height      = h.height;
+        pic->denominator = h.maxval;
+        pic->pixels      = a;
+        pic->methods     = a2file_methods;
+        return pic;
+}
+
+/************************************************/
+/* The private functions of the A2Methods_T     */
+/************************************************/
+
+static A2 new(int width, int height, int size)
+{
+        int blocksize;
+
+        assert(size >= 1);
+        blocksize = sqrt(64 * 1024 / size);
+        return new_array(width, height, size, blocksize < 1 ? 1 : blocksize);
+}
+
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+        return new_array(width, height, size, blocksize);
+}
+
+static void a2free(A2 *a2p)
+{
+        struct A2File *a;
+
+        assert(a2p != NULL && *a2p != NULL);
+        a = *a2p;
+        Memstats_free(footprint(a));
+        close(a->fd);
+        Storage_free(a->slots, (long)a->nslots * a->block_bytes);
+        free(a->slot_block);
+        free(a->dirty);
+        free(a->newer);
+        free(a->older);
+        free(a->block_slot);
+        free(a->on_disk);
+        free(a);
+        *a2p = NULL;
+}
+
+static int width(A2 a2)
+{
+        return ((struct A2File *)a2)->width;
+}
+
+static int height(A2 a2)
+{
+        return ((struct A2File *)a2)->height;
+}
+
+static int size(A2 a2)
+{
+        return ((struct A2File *)a2)->size;
+}
+
+static int blocksize(A2 a2)
+{
+        return ((struct A2File *)a2)->blocksize;
+}
+
+static A2Methods_Object *at(A2 a2, int i, int j)
+{
+        struct A2File *a = a2;
+        int bs;
+        long block;
+        char *slot;
+
+        assert(a != NULL && i >= 0 && i < a->width && j >= 0
+               && j < a->height);
+        bs    = a->blocksize;
+        block = (long)(i / bs) * a->blocks_down + j / bs;
+        slot  = block == a->last_block ? a->last_slot : fetch(a, block);
+        return slot + ((long)(j % bs) * bs + i % bs) * a->size;
+}
+
+static void map_block_major(A2 a2, A2Methods_applyfun apply, void *cl)
+{
+        struct A2File *a = a2;
+        int bs = a->blocksize;
+
+        TRACE_SCOPE(TRACE_DETAIL, "A2File_map_block_major");
+        for (long block = 0; block < a->nblocks; block++) {
+                int x0 = block / a->blocks_down * bs;
+                int y0 = block % a->blocks_down * bs;
+                int x1 = x0 + bs < a->width ? x0 + bs : a->width;
+                int y1 = y0 + bs < a->height ? y0 + bs : a->height;
+                prefetch(a, block + 1, PREFETCH_BLOCKS);
+                for (int y = y0; y < y1; y++) {
+                        for (int x = x0; x < x1; x++) {
+                                apply(x, y, a, at(a, x, y), cl);
+                        }
+                }
+        }
+}
+
+struct small_closure {
+        A2Methods_smallapplyfun *apply;
+        void *cl;
+};
+
+static void apply_small(int i, int j, A2 a2, void *elem, void *vcl)
+{
+        struct small_closure *cl = vcl;
+
+        (void) i;
+        (void) j;
+        (void) a2;
+        cl->apply(elem, cl->cl);
+}
+
+static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
+                                  void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_block_major(a2, apply_small, &mycl);
+}
+
+static struct A2Methods_T a2file_methods_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        NULL,                   /* map_row_major */
+        NULL,                   /* map_col_major */
+        map_block_major,
+        map_block_major,        /* map_default */
+        NULL,                   /* small_map_row_major */
+        NULL,                   /* small_map_col_major */
+        small_map_block_major,
+        small_map_block_major,  /* small_map_default */
+};
+
+A2Methods_T a2file_methods = &a2file_methods_struct;
+
+/************************************************/
+/* The cache                                    */
+/************************************************/
+
+/*
+ * new_array
+ *    Purpose: Makes an array backed by a new temporary file, with every
+ *             block zero and none of them yet in the file
+ *    Expects: The dimensions are at least 1 (checked); raises
+ *             A2File_failed if no temporary file can be made
+ */
+static struct A2File *new_array(int width, int height, int size,
+                                int blocksize)
+{
+        struct A2File *a = malloc(sizeof(*a));
+        long slots;
+
+        assert(a != NULL);
+        assert(width >= 1 && height >= 1 && size >= 1 && blocksize >= 1);
+        a->width         = width;
+        a->height        = height;
+        a->size          = size;
+        a->blocksize     = blocksize;
+        a->blocks_across = (width + blocksize - 1) / blocksize;
+        a->blocks_down   = (height + blocksize - 1) / blocksize;
+        a->nblocks       = (long)a->blocks_across * a->blocks_down;
+        /* the same padded blocks as a UArray2b, and a tiled file */
+        a->block_bytes   = UArray2b_block_bytes(blocksize, size);
+        a->fd            = make_temp_file();
+        a->data_offset   = 0;
+        a->read_only     = 0;
+
+        slots = cache_bytes / a->block_bytes;
+        slots = slots < A2FILE_MIN_BLOCKS ? A2FILE_MIN_BLOCKS : slots;
+        slots = slots > a->nblocks ? a->nblocks : slots;
+        a->nslots     = slots;
+        a->slots      = Storage_alloc((long)a->nslots * a->block_bytes);
+        a->slot_block = malloc(a->nslots * sizeof(long));
+        a->dirty      = calloc(a->nslots, 1);
+        a->newer      = malloc(a->nslots * sizeof(int));
+        a->older      = malloc(a->nslots * sizeof(int));
+        a->block_slot = malloc(a->nblocks * sizeof(int));
+        a->on_disk    = calloc(a->nblocks, 1);
+        assert(a->slot_block != NULL && a->dirty != NULL
+               && a->newer != NULL && a->older != NULL
+               && a->block_slot != NULL && a->on_disk != NULL);
+        /* every slot starts empty, in a list from slot 0 to the last */
+        for (int s = 0; s < a->nslots; s++) {
+                a->slot_block[s] = -1;
+                a->newer[s] = s - 1;
+                a->older[s] = s + 1 < a->nslots ? s + 1 : -1;
+        }
+        a->mru = 0;
+        a->lru = a->nslots - 1;
+        for (long k = 0; k < a->nblocks; k++) {
+                a->block_slot[k] = -1;
+        }
+        a->last_block = -1;
+        a->last_slot  = NULL;
+        Memstats_alloc(footprint(a), 0);
+        return a;
+}
+
+/* Makes a temporary file in $TMPDIR, or /tmp, and unlinks it at once */
+static int make_temp_file(void)
+{
+        const char *dir = getenv("TMPDIR");
+        char *path;
+        int fd;
+
+        if (dir == NULL || dir[0] == '\0') {
+                dir = "/tmp";
+        }
+        path = malloc(strlen(dir) + sizeof("/a2file-XXXXXX"));
+        assert(path != NULL);
+        strcpy(path, dir);
+        strcat(path, "/a2file-XXXXXX");
+        fd = mkstemp(path);
+        if (fd < 0) {
+                free(path);
+                RAISE(A2File_failed);
+        }
+        unlink(path);
+        free(path);
+        return fd;
+}
+
+/*
+ * fetch
+ *    Purpose: The slow path of at: finds a block's slot, reading the block
+ *             into the least recently used slot if it is not cached, and
+ *             makes the slot the most recently used
+ *    Returns: The start of the block in its slot
+ */
+static char *fetch(struct A2File *a, long block)
+{
+        int s = a->block_slot[block];
+        char *slot;
+
+        if (s < 0) {
+                s = a->lru;
+                slot = a->slots + (long)s * a->block_bytes;
+                if (a->slot_block[s] >= 0) {
+                        if (a->dirty[s]) {
+                                write_block(a, a->slot_block[s], slot);
+                        }
+                        a->block_slot[a->slot_block[s]] = -1;
+                }
+                read_block(a, block, slot);
+                a->slot_block[s]     = block;
+                a->block_slot[block] = s;
+        }
+        if (s != a->mru) {
+                /* unlink s, then put it at the front */
+                a->older[a->newer[s]] = a->older[s];
+                if (a->older[s] >= 0) {
+                        a->newer[a->older[s]] = a->newer[s];
+                } else {
+                        a->lru = a->newer[s];
+                }
+                a->newer[s] = -1;
+                a->older[s] = a->mru;
+                a->newer[a->mru] = s;
+                a->mru = s;
+        }
+        a->dirty[s]   = !a->read_only;
+        a->last_block = block;
+        a->last_slot  = a->slots + (long)s * a->block_bytes;
+        return a->last_slot;
+}
+
+/*
+ * prefetch
+ *    Purpose: Asks the kernel to start reading up to count blocks from
+ *             the given one, skipping any past the end or never written
+ */
+static void prefetch(struct A2File *a, long block, long count)
+{
+        if (block + count > a->nblocks) {
+                count = a->nblocks - block;
+        }
+        while (count > 0 && !a->on_disk[block]) {
+                block++;
+                count--;
+        }
+        if (count > 0) {
+                posix_fadvise(a->fd, a->data_offset + block * a->block_bytes,
+                              count * a->block_bytes, POSIX_FADV_WILLNEED);
+        }
+}
+
+/* Reads a block from the file, or zeros if it was never written */
+static void read_block(struct A2File *a, long block, char *into)
+{
+        off_t offset = a->data_offset + block * a->block_bytes;
+        long done = 0;
+
+        if (!a->on_disk[block]) {
+                memset(into, 0, a->block_bytes);
+                return;
+        }
+        while (done < a->block_bytes) {
+                ssize_t n = pread(a->fd, into + done, a->block_bytes - done,
+                                  offset + done);
+                if (n < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (n <= 0) {
+                        RAISE(A2File_failed);
+                }
+                done += n;
+        }
+}
+
+static void write_block(struct A2File *a, long block, const char *from)
+{
+        off_t offset = a->data_offset + block * a->block_bytes;
+        long done = 0;
+
+        while (done < a->block_bytes) {
+                ssize_t n = pwrite(a->fd, from + done, a->block_bytes - done,
+                                   offset + done);
+                if (n < 0 && errno == EINTR) {
+                        continue;
+                }
+                if (n <= 0) {
+                        RAISE(A2File_failed);
+                }
+                done += n;
+        }
+        a->on_disk[block] = 1;
+}
+
+/* The memory an array holds, for memstats: the cache and its tables */
+static long footprint(struct A2File *a)
+{
+        return sizeof(*a) + Storage_round((long)a->nslots * a->block_bytes)
+               + a->nslots * (sizeof(long) + 1 + 2 * sizeof(int))
+               + a->nblocks * (sizeof(int) + 1);
+}
@@ -0,0 +1,49 @@
+/***********************************************************************
+ *                              a2file.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: An A2Methods suite of out-of-core blocked arrays, for images
+ *          larger than memory. The blocks are laid out as in a UArray2b
+ *          (see uarray2b_storage.h) but live in a file, unlinked as soon
+ *          as it is made, and only a bounded number of them are held in
+ *          memory at once, in a cache with least recently used
+ *          replacement. A block is read in when at first touches it and,
+ *          if it may have been written, written back when it is evicted;
+ *          blocks never written are not read at all. The map functions
+ *          ask the kernel to read ahead the blocks they will visit next.
+ *
+ *          Each array's cache holds A2File_set_cache bytes of blocks (64MB
+ *          unless set), and never fewer than A2FILE_MIN_BLOCKS blocks.
+ *          A pointer from at stays valid until A2FILE_MIN_BLOCKS - 1
+ *          other blocks of the same array have been touched, so code that
+ *          holds a pointer into one array while touching another, as the
+ *          transforms do, is safe.
+ *
+ *          Like uarray2_methods_blocked it is a blocked suite, with no
+ *          row- or column-major maps: those would cross a whole row or
+ *          column of blocks for each row or column of cells, and so only
+ *          run at disk speed if the cache held that many blocks.
+ *          map_default is map_block_major, which touches each block once.
+ *
+ *          A2File_load_tiled opens an image file of tiled.h as an array
+ *          of this suite that reads its blocks in place, without copying
+ *          the file. Writes to such an array are not kept.
+ ***********************************************************************/
+
+#ifndef A2FILE_H
+#define A2FILE_H
+
+#include <stdio.h>
+#include "except.h"
+#include "a2methods.h"
+#include "pnm.h"
+
+#define A2FILE_MIN_BLOCKS 4
+
+extern A2Methods_T a2file_methods;
+extern Except_T    A2File_failed;
+
+void    A2File_set_cache (long bytes);
+Pnm_ppm A2File_load_tiled(FILE *fp);
+
+#endif
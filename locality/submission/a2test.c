@@ -1,9 +1,16 @@
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "assert.h"
+#include "except.h"
 #include "a2methods.h"
 #include "a2plain.h"
 #include "a2blocked.h"
+#include "a2view.h"
+#include "a2file.h"
+#include "crop.h"
+#include "uarray2.h"
 
 
 #define W 13
@@ -161,12 +168,183 @@ static void test_methods(A2Methods_T methods_under_test)
         methods->free(&array);
 }
 
+/* Fills a UArray2 with 1000 * col + row, so every element names itself */
+static UArray2_T numbered_uarray2(int w, int h)
+{
+        UArray2_T array = UArray2_new(w, h, sizeof(unsigned));
+        for (int i = 0; i < w; i++) {
+                for (int j = 0; j < h; j++) {
+                        *(unsigned *)UArray2_at(array, i, j) = 1000 * i + j;
+                }
+        }
+        return array;
+}
+
+/* Checks that view (i, j) holds what the numbered array had at (col, row) */
+static void check_view(UArray2_T view, int i, int j, int col, int row)
+{
+        assert(*(unsigned *)UArray2_at(view, i, j)
+               == (unsigned)(1000 * col + row));
+}
+
+/* Counts the elements a map visits, checking each against UArray2_at */
+static void count_visit(int i, int j, UArray2_T a, void *elem, void *cl)
+{
+        assert(elem == UArray2_at(a, i, j));
+        *(int *)cl += 1;
+}
+
+static void test_uarray2_views()
+{
+        UArray2_T array = numbered_uarray2(W, H);
+        UArray2_T view, crop, copy;
+        int visits;
+
+        /* transpose and flips: the strides change, the elements do not */
+        view = UArray2_transpose(array);
+        assert(UArray2_width(view) == H && UArray2_height(view) == W);
+        for (int i = 0; i < H; i++) {
+                for (int j = 0; j < W; j++) {
+                        check_view(view, i, j, j, i);
+                }
+        }
+        UArray2_free(&view);
+        view = UArray2_flip_horizontal(array);
+        for (int i = 0; i < W; i++) {
+                for (int j = 0; j < H; j++) {
+                        check_view(view, i, j, W - 1 - i, j);
+                }
+        }
+        UArray2_free(&view);
+
+        /* rotations, where both strides may be negative */
+        for (int degrees = 0; degrees < 360; degrees += 90) {
+                view = UArray2_rotate(array, degrees);
+                for (int i = 0; i < W; i++) {
+                        for (int j = 0; j < H; j++) {
+                                int c = i, r = j;
+                                if (degrees == 90) {
+                                        c = H - 1 - j;
+                                        r = i;
+                                } else if (degrees == 180) {
+                                        c = W - 1 - i;
+                                        r = H - 1 - j;
+                                } else if (degrees == 270) {
+                                        c = j;
+                                        r = W - 1 - i;
+                                }
+                                check_view(view, c, r, i, j);
+                        }
+                }
+                visits = 0;
+                UArray2_map_row_major(view, count_visit, &visits);
+                assert(visits == W * H);
+                visits = 0;
+                UArray2_map_col_major(view, count_visit, &visits);
+                assert(visits == W * H);
+                UArray2_free(&view);
+        }
+
+        /* a crop of a flipped view, written through, then copied */
+        view = UArray2_flip_vertical(array);
+        crop = UArray2_crop(view, 2, 3, 5, 4);
+        assert(UArray2_width(crop) == 5 && UArray2_height(crop) == 4);
+        for (int i = 0; i < 5; i++) {
+                for (int j = 0; j < 4; j++) {
+                        check_view(crop, i, j, 2 + i, H - 1 - (3 + j));
+                }
+        }
+        *(unsigned *)UArray2_at(crop, 0, 0) = 7;
+        assert(*(unsigned *)UArray2_at(array, 2, H - 4) == 7);
+        *(unsigned *)UArray2_at(crop, 0, 0) = 1000 * 2 + H - 4;
+        copy = UArray2_copy(crop);
+        UArray2_free(&view);
+        UArray2_free(&crop);
+        for (int i = 0; i < 5; i++) {
+                for (int j = 0; j < 4; j++) {
+                        check_view(copy, i, j, 2 + i, H - 1 - (3 + j));
+                }
+        }
+        *(unsigned *)UArray2_at(copy, 0, 0) = 7;
+        assert(*(unsigned *)UArray2_at(array, 2, H - 4) != 7);
+        UArray2_free(&copy);
+
+        /* a view outlives the array it was made from */
+        view = UArray2_rotate(array, 90);
+        UArray2_free(&array);
+        assert(array == NULL);
+        for (int i = 0; i < H; i++) {
+                for (int j = 0; j < W; j++) {
+                        check_view(view, i, j, j, H - 1 - i);
+                }
+        }
+        UArray2_free(&view);
+}
+
+/* Whether UArray2_crop refuses a rectangle */
+static bool crop_raises(UArray2_T array, int col, int row, int w, int h)
+{
+        volatile bool raised = false;
+
+        TRY
+                UArray2_T view = UArray2_crop(array, col, row, w, h);
+                UArray2_free(&view);
+        EXCEPT(Bad_coords)
+                raised = true;
+        END_TRY;
+        return raised;
+}
+
+/*
+ * Crops that are not inside the image, including ones whose far edge
+ * overflows an int, are refused by each path: UArray2_crop, the region
+ * check of -lazy and -box-stats, and Crop_load, whose NULL ppmtrans
+ * reports as "not inside the image"
+ */
+static void test_crop_bounds()
+{
+        UArray2_T array = numbered_uarray2(W, H);
+        static const struct A2View_region outside[] = {
+                {INT_MAX, 0, 10, 10}, {0, INT_MAX, 10, 10},
+                {1, 0, INT_MAX, 1},   {0, 1, 1, INT_MAX},
+                {W, 0, 1, 1},         {0, 0, W + 1, 1},
+                {-1, 0, 1, 1},        {0, 0, 0, 1}
+        };
+        struct A2View_region whole = {0, 0, W, H};
+        char image[64] = "P6\n4 3\n255\n";    /* then a black raster */
+        size_t size = strlen(image) + 4 * 3 * 3;
+
+        assert(A2View_inside(&whole, W, H));
+        assert(!crop_raises(array, 0, 0, W, H));
+        for (size_t k = 0; k < sizeof(outside) / sizeof(outside[0]); k++) {
+                const struct A2View_region *r = &outside[k];
+                struct A2View_region small = *r;
+                FILE *fp = fmemopen(image, size, "rb");
+
+                assert(!A2View_inside(r, W, H));
+                assert(crop_raises(array, r->x, r->y, r->width, r->height));
+                if (small.x == W) {
+                        small.x = 4;            /* just off the 4 x 3 image */
+                } else if (small.width == W + 1) {
+                        small.width = 5;
+                }
+                assert(fp != NULL);
+                assert(Crop_load(fp, &small, 0, uarray2_methods_plain)
+                       == NULL);
+                fclose(fp);
+        }
+        UArray2_free(&array);
+}
+
 int main(int argc, char *argv[])
 {
         assert(argc == 1);
         (void)argv;
         test_methods(uarray2_methods_plain);
         test_methods(uarray2_methods_blocked);
+        test_methods(a2file_methods);
+        test_uarray2_views();
+        test_crop_bounds();
         printf("Passed.\n");  /* only if we reach this point without
                                * assertion failure
                                */
@@ -0,0 +1,332 @@
+/***********************************************************************
+ *                              a2view.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the lazy views in a2view.h. A view keeps the
+ *          coordinates calculator of its transform (the same one
+ *          transform.c uses to move pixels) to go from the wrapped array
+ *          to the view, and the calculator of the inverse transform to go
+ *          back: transpose and the flips are their own inverses, and a
+ *          rotation by a is undone by a rotation by 360 - a of the view.
+ ***********************************************************************/
+
+#include <stdlib.h>
+
+#include "assert.h"
+#include "a2plain.h"
+#include "transform.h"
+#include "a2view.h"
+
+typedef A2Methods_UArray2 A2;
+typedef struct Coordinates (*Coords_calc)(int img_height, int img_width,
+                                          int amount, struct Coordinates c);
+
+struct A2View {
+        A2Methods_T methods;            /* of the wrapped array          */
+        A2 base;
+        int owns_base;
+        struct A2View_region region;    /* in the wrapped array          */
+        int width, height;              /* of the view                   */
+        int amount, inverse_amount;
+        Coords_calc forward, inverse;   /* region -> view, view -> region */
+};
+
+/*
+ * A2View_new
+ *    Purpose: Creates a view of a region of an array, transformed
+ * Parameters: The methods of the array, the array, the rotation or code
+ *             (as in transform.h), and the region, or NULL for all of it
+ *    Returns: The view, to be used with a2view_methods
+ *    Expects: methods and base are nonnull, the region lies inside the
+ *             array and is not empty, and the rotation is valid (all
+ *             checked)
+ */
+A2 A2View_new(A2Methods_T methods, A2 base, int rotation,
+              const struct A2View_region *region)
+{
+        struct A2View *view;
+        struct transform_closure cl = {rotation, methods, NULL, NULL};
+
+        assert(methods != NULL && base != NULL);
+        view = malloc(sizeof(*view));
+        assert(view != NULL);
+        view->methods   = methods;
+        view->base      = base;
+        view->owns_base = 0;
+        if (region != NULL) {
+                view->region = *region;
+        } else {
+                view->region.x      = 0;
+                view->region.y      = 0;
+                view->region.width  = methods->width(base);
+                view->region.height = methods->height(base);
+        }
+        assert(A2View_inside(&view->region, methods->width(base),
+                             methods->height(base)));
+
+        assign_coords_calc(&cl);        /* raises on a bad rotation */
+        view->forward        = cl.coords_calc;
+        view->inverse        = cl.coords_calc;
+        view->amount         = rotation;
+        view->inverse_amount = rotation;
+        if (cl.coords_calc == rotate_calc) {
+                view->inverse_amount = (360 - rotation) % 360;
+        }
+        if (rotation == 90 || rotation == 270
+            || rotation == TRANSPOSE_CODE) {
+                view->width  = view->region.height;
+                view->height = view->region.width;
+        } else {
+                view->width  = view->region.width;
+                view->height = view->region.height;
+        }
+        return view;
+}
+
+/************************************************/
+/* The private functions of the A2Methods_T     */
+/************************************************/
+
+static A2 new(int width, int height, int size)
+{
+        A2 base = uarray2_methods_plain->new(width, height, size);
+        struct A2View *view = A2View_new(uarray2_methods_plain, base, 0,
+                                         NULL);
+        view->owns_base = 1;
+        return view;
+}
+
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+        (void) blocksize;
+        return new(width, height, size);
+}
+
+static void a2free(A2 *a2p)
+{
+        struct A2View *view;
+
+        assert(a2p != NULL && *a2p != NULL);
+        view = *a2p;
+        if (view->owns_base) {
+                view->methods->free(&view->base);
+        }
+        free(view);
+        *a2p = NULL;
+}
+
+static int width(A2 a2)
+{
+        return ((struct A2View *)a2)->width;
+}
+
+static int height(A2 a2)
+{
+        return ((struct A2View *)a2)->height;
+}
+
+static int size(A2 a2)
+{
+        struct A2View *view = a2;
+        return view->methods->size(view->base);
+}
+
+static int blocksize(A2 a2)
+{
+        (void) a2;
+        return 1;
+}
+
+static A2Methods_Object *at(A2 a2, int i, int j)
+{
+        struct A2View *view = a2;
+        struct Coordinates c = {i, j};
+
+        assert(i >= 0 && i < view->width && j >= 0 && j < view->height);
+        c = view->inverse(view->height, view->width, view->inverse_amount,
+                          c);
+        return view->methods->at(view->base, c.col + view->region.x,
+                                 c.row + view->region.y);
+}
+
+static void map_row_major(A2 a2, A2Methods_applyfun apply, void *cl)
+{
+        struct A2View *view = a2;
+
+        for (int j = 0; j < view->height; j++) {
+                for (int i = 0; i < view->width; i++) {
+                        apply(i, j, a2, at(a2, i, j), cl);
+                }
+        }
+}
+
+static void map_col_major(A2 a2, A2Methods_applyfun apply, void *cl)
+{
+        struct A2View *view = a2;
+
+        for (int i = 0; i < view->width; i++) {
+                for (int j = 0; j < view->height; j++) {
+                        apply(i, j, a2, at(a2, i, j), cl);
+                }
+        }
+}
+
+/*
+ * visit_rect
+ *    Purpose: Applies apply to the view pixel of every wrapped-array pixel
+ *             in a rectangle of the region, row by row
+ * Parameters: The view, the rectangle in wrapped-array coordinates (inside
+ *             the region), and the apply function and closure
+ */
+static void visit_rect(struct A2View *view, int x0, int y0, int x1, int y1,
+                       A2Methods_applyfun apply, void *cl)
+{
+        const struct A2View_region *r = &view->region;
+
+        for (int y = y0; y < y1; y++) {
+                for (int x = x0; x < x1; x++) {
+                        struct Coordinates c = {x - r->x, y - r->y};
+                        c = view->forward(r->height, r->width, view->amount,
+                                          c);
+                        apply(c.col, c.row, view,
+                              view->methods->at(view->base, x, y), cl);
+                }
+        }
+}
+
+static void map_default(A2 a2, A2Methods_applyfun apply, void *cl)
+{
+        struct A2View *view = a2;
+        const struct A2View_region *r = &view->region;
+        int block = view->methods->blocksize(view->base);
+        int x_end = r->x + r->width, y_end = r->y + r->height;
+
+        if (block <= 1) {
+                visit_rect(view, r->x, r->y, x_end, y_end, apply, cl);
+                return;
+        }
+        /* whole blocks of the wrapped array, clipped to the region */
+        for (int by = r->y / block * block; by < y_end; by += block) {
+                for (int bx = r->x / block * block; bx < x_end;
+                     bx += block) {
+                        visit_rect(view, bx > r->x ? bx : r->x,
+                                   by > r->y ? by : r->y,
+                                   bx + block < x_end ? bx + block : x_end,
+                                   by + block < y_end ? by + block : y_end,
+                                   apply, cl);
+                }
+        }
+}
+
+struct small_closure {
+        A2Methods_smallapplyfun *apply;
+        void                    *cl;
+};
+
+static void apply_small(int i, int j, A2 a2, void *elem, void *vcl)
+{
+        struct small_closure *cl = vcl;
+        (void) i;
+        (void) j;
+        (void) a2;
+        cl->apply(elem, cl->cl);
+}
+
+static void small_map_row_major(A2 a2, A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_row_major(a2, apply_small, &mycl);
+}
+
+static void small_map_col_major(A2 a2, A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_col_major(a2, apply_small, &mycl);
+}
+
+static void small_map_default(A2 a2, A2Methods_smallapplyfun apply,
+                              void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_default(a2, apply_small, &mycl);
+}
+
+static struct A2Methods_T a2view_methods_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        map_row_major,
+        map_col_major,
+        NULL,                   /* map_block_major */
+        map_default,
+        small_map_row_major,
+        small_map_col_major,
+        NULL,                   /* small_map_block_major */
+        small_map_default,
+};
+
+A2Methods_T a2view_methods = &a2view_methods_struct;
+
+struct copy_closure {
+        A2Methods_T methods;
+        A2 copy;
+        int size;
+};
+
+/* Copies one pixel of a view into the same place in the copy */
+static void copy_pixel(int i, int j, A2 a2, void *elem, void *vcl)
+{
+        struct copy_closure *cl = vcl;
+        char *to = cl->methods->at(cl->copy, i, j), *from = elem;
+        (void) a2;
+        for (int k = 0; k < cl->size; k++) {
+                to[k] = from[k];
+        }
+}
+
+/*
+ * A2View_inside
+ *    Purpose: Tells whether a region is not empty and lies inside an array
+ *             of the given size
+ * Parameters: The region and the width and height of the array
+ *    Returns: 1 if it does, 0 otherwise
+ *    Notes: The far edges are compared by subtraction, as x + width could
+ *           overflow for a region read from the command line
+ */
+int A2View_inside(const struct A2View_region *region, int width,
+                  int height)
+{
+        assert(region != NULL);
+        return region->x >= 0 && region->y >= 0
+               && region->width >= 1 && region->height >= 1
+               && region->x <= width && region->width <= width - region->x
+               && region->y <= height
+               && region->height <= height - region->y;
+}
+
+/*
+ * A2View_copy
+ *    Purpose: Materializes a view into a real array
+ * Parameters: The view and the methods for the copy
+ *    Returns: A new array of the view's size holding its pixels, to be
+ *             freed with methods->free
+ *    Expects: view and methods are nonnull (checked)
+ */
+A2 A2View_copy(A2 view, A2Methods_T methods)
+{
+        struct copy_closure cl;
+
+        assert(view != NULL && methods != NULL);
+        cl.methods = methods;
+        cl.size    = size(view);
+        cl.copy    = methods->new(width(view), height(view), cl.size);
+        map_default(view, copy_pixel, &cl);
+        return cl.copy;
+}
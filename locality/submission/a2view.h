@@ -0,0 +1,46 @@
+/***********************************************************************
+ *                              a2view.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: An A2Methods suite of lazy views. A view wraps an existing A2
+ *          (of any suite, views included) together with one of the
+ *          ppmtrans transforms and, optionally, a crop rectangle, and
+ *          looks like the transformed region without any pixel having
+ *          moved: width, height and at translate coordinates on the fly
+ *          through coords_calcs, and the map functions walk the wrapped
+ *          array. A view never copies the pixels; A2View_copy does, for a
+ *          caller that needs a real array.
+ *
+ *          The crop is taken from the wrapped array first, in its own
+ *          coordinates, and then transformed. map_row_major and
+ *          map_col_major visit the view in its own row- or column-major
+ *          order; map_default instead visits the pixels in the order the
+ *          wrapped array stores them (block by block for a blocked array),
+ *          which is the fast way to read a view whose order does not
+ *          matter. There is no block-major map.
+ *
+ *          The view does not own the wrapped array, which must outlive
+ *          it, except for views made by the suite's own new, which wrap a
+ *          fresh plain array and free it with the view.
+ ***********************************************************************/
+
+#ifndef A2VIEW_H
+#define A2VIEW_H
+
+#include "a2methods.h"
+
+/* A rectangle of the wrapped array: its top left corner and its size */
+struct A2View_region {
+        int x, y, width, height;
+};
+
+extern A2Methods_T a2view_methods;
+
+A2Methods_UArray2 A2View_new (A2Methods_T methods, A2Methods_UArray2 base,
+                              int rotation,
+                              const struct A2View_region *region);
+A2Methods_UArray2 A2View_copy(A2Methods_UArray2 view, A2Methods_T methods);
+int               A2View_inside(const struct A2View_region *region,
+                                int width, int height);
+
+#endif
@@ -0,0 +1,290 @@
+/***********************************************************************
+ *                              batch.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the batch mode in batch.h. The jobs are the
+ *          tasks of a Parallel_for, so the list needs no lock and the
+ *          jobs are started in order. Images are read and written
+ *          with ppmio.h, since the course Pnm functions are not safe to
+ *          call from several threads at once. Times are wall clock, so
+ *          that the per-image numbers add up to what the user waited for.
+ ***********************************************************************/
+
+#define _DEFAULT_SOURCE         /* DT_REG */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+
+#include "assert.h"
+#include "pnm.h"
+#include "ppmio.h"
+#include "trace.h"
+#include "transform.h"
+#include "parallel.h"
+#include "batch.h"
+
+struct pool {
+        struct Batch_job *jobs;
+        const struct Batch_spec *spec;
+};
+
+static void    run_task(int i, int worker, void *pool);
+static void    run_job(struct Batch_job *job, const struct Batch_spec *spec);
+static double  now_ms(void);
+static void    add_job(struct Batch_job **jobs, int *njobs, int *capacity,
+                       char *input, char *output);
+static char   *join_path(const char *dir, const char *name);
+static int     compare_names(const void *a, const void *b);
+
+/*
+ * Batch_read_list
+ *    Purpose: Reads a job list, one "input output" pair of paths per line
+ * Parameters: The open list file and where to put the new job array
+ *    Returns: The number of jobs; blank lines are skipped
+ *    Expects: Paths contain no whitespace. A line with only one path is
+ *             reported on stderr and skipped.
+ */
+int Batch_read_list(FILE *list, struct Batch_job **jobs)
+{
+        char line[4096], input[2048], output[2048];
+        int njobs = 0, capacity = 0, lineno = 0;
+
+        *jobs = NULL;
+        while (fgets(line, sizeof(line), list) != NULL) {
+                int fields = sscanf(line, "%2047s %2047s", input, output);
+                lineno++;
+                if (fields == 2) {
+                        add_job(jobs, &njobs, &capacity, strdup(input),
+                                strdup(output));
+                } else if (fields == 1) {
+                        fprintf(stderr, "batch list line %d: no output "
+                                        "path, skipped\n", lineno);
+                }
+        }
+        return njobs;
+}
+
+/*
+ * Batch_read_dir
+ *    Purpose: Makes a job for every .ppm file in a directory, writing each
+ *             result under the same name in another directory
+ * Parameters: The input and output directories and where to put the new
+ *             job array
+ *    Returns: The number of jobs, sorted by name, or -1 if indir cannot be
+ *             read
+ *    Expects: outdir exists and is not indir (unchecked)
+ */
+int Batch_read_dir(const char *indir, const char *outdir,
+                   struct Batch_job **jobs)
+{
+        DIR *dir = opendir(indir);
+        struct dirent *entry;
+        char **names = NULL;
+        int nnames = 0, njobs = 0, capacity = 0;
+
+        *jobs = NULL;
+        if (dir == NULL) {
+                return -1;
+        }
+        while ((entry = readdir(dir)) != NULL) {
+                size_t len = strlen(entry->d_name);
+                if (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN) {
+                        continue;
+                }
+                if (len < 4 || strcmp(entry->d_name + len - 4, ".ppm") != 0) {
+                        continue;
+                }
+                names = realloc(names, (nnames + 1) * sizeof(char *));
+                assert(names != NULL);
+                names[nnames++] = strdup(entry->d_name);
+        }
+        closedir(dir);
+
+        qsort(names, nnames, sizeof(char *), compare_names);
+        for (int i = 0; i < nnames; i++) {
+                add_job(jobs, &njobs, &capacity, join_path(indir, names[i]),
+                        join_path(outdir, names[i]));
+                free(names[i]);
+        }
+        free(names);
+        return njobs;
+}
+
+/*
+ * Batch_run
+ *    Purpose: Runs every job on a pool of spec->threads workers, filling in
+ *             the error and times of each
+ * Parameters: The jobs, how many there are, and the transform to apply
+ *    Returns: The wall-clock time of the whole batch in milliseconds
+ *    Expects: spec is nonnull with at least one thread (checked)
+ */
+double Batch_run(struct Batch_job *jobs, int njobs,
+                 const struct Batch_spec *spec)
+{
+        struct pool pool = { jobs, spec };
+        double start = now_ms();
+
+        assert(spec != NULL && spec->threads >= 1);
+        Parallel_for(njobs, spec->threads, run_task, &pool);
+        return now_ms() - start;
+}
+
+/*
+ * Batch_report
+ *    Purpose: Prints a line per image and then the totals: how many images
+ *             succeeded, the time spent in each phase summed over all
+ *             workers, and the throughput over the wall-clock time
+ * Parameters: The output file, the jobs after Batch_run, their number, and
+ *             the wall-clock time Batch_run returned
+ *    Returns: Nothing
+ */
+void Batch_report(FILE *out, const struct Batch_job *jobs, int njobs,
+                  double wall_ms)
+{
+        double read = 0, xform = 0, write = 0, pixels = 0;
+        int done = 0;
+
+        fprintf(out, "%-32s %11s %9s %10s %9s\n", "image", "size",
+                "read ms", "xform ms", "write ms");
+        for (int i = 0; i < njobs; i++) {
+                const struct Batch_job *job = &jobs[i];
+                if (job->error != NULL) {
+                        fprintf(out, "%-32s %s\n", job->input, job->error);
+                        continue;
+                }
+                fprintf(out, "%-32s %5dx%-5d %9.2f %10.2f %9.2f\n",
+                        job->input, job->width, job->height, job->read_ms,
+                        job->transform_ms, job->write_ms);
+                read   += job->read_ms;
+                xform  += job->transform_ms;
+                write  += job->write_ms;
+                pixels += (double)job->width * job->height;
+                done++;
+        }
+        fprintf(out, "images: %d of %d\n", done, njobs);
+        fprintf(out, "total read %.2f ms, transform %.2f ms, write %.2f ms\n",
+                read, xform, write);
+        if (wall_ms > 0) {
+                fprintf(out, "wall %.2f ms, %.1f images/s, %.1f Mpixels/s\n",
+                        wall_ms, done * 1000.0 / wall_ms,
+                        pixels / 1000.0 / wall_ms);
+        }
+}
+
+/*
+ * Batch_free
+ *    Purpose: Frees a job array and sets *jobs to NULL
+ */
+void Batch_free(struct Batch_job **jobs, int njobs)
+{
+        assert(jobs != NULL);
+        for (int i = 0; i < njobs; i++) {
+                free((*jobs)[i].input);
+                free((*jobs)[i].output);
+        }
+        free(*jobs);
+        *jobs = NULL;
+}
+
+/*
+ * run_task
+ *    Purpose: Runs job i, a Parallel_for task
+ */
+static void run_task(int i, int worker, void *pool)
+{
+        struct pool *p = pool;
+
+        (void)worker;
+        run_job(&p->jobs[i], p->spec);
+}
+
+/*
+ * run_job
+ *    Purpose: Loads, transforms and writes one image, timing each phase
+ */
+static void run_job(struct Batch_job *job, const struct Batch_spec *spec)
+{
+        A2Methods_T methods = spec->methods;
+        FILE *in, *out;
+        Pnm_ppm pic;
+        double t0, t1, t2;
+
+        TRACE_SCOPE(TRACE_DETAIL, "batch job");
+        in = fopen(job->input, "rb");
+        if (in == NULL) {
+                job->error = "could not open input";
+                return;
+        }
+        t0  = now_ms();
+        pic = Ppmio_try_load(in, methods);
+        fclose(in);
+        if (pic == NULL) {
+                job->error = "could not read a P6 image";
+                return;
+        }
+        t1  = now_ms();
+        struct Pnm_ppm result = { 0, 0, pic->denominator,
+                                  transform_image(pic, spec->rotation,
+                                                  methods, spec->map),
+                                  methods };
+        result.width  = methods->width(result.pixels);
+        result.height = methods->height(result.pixels);
+        t2  = now_ms();
+
+        job->width        = pic->width;
+        job->height       = pic->height;
+        job->read_ms      = t1 - t0;
+        job->transform_ms = t2 - t1;
+        Ppmio_free(&pic);
+
+        out = fopen(job->output, "wb");
+        if (out == NULL) {
+                job->error = "could not open output";
+        } else {
+                Ppmio_store(out, &result);
+                fclose(out);
+                job->write_ms = now_ms() - t2;
+        }
+        methods->free(&result.pixels);
+}
+
+/* Milliseconds on the monotonic clock */
+static double now_ms(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* Appends a job that owns the two malloc'd paths, growing the array */
+static void add_job(struct Batch_job **jobs, int *njobs, int *capacity,
+                    char *input, char *output)
+{
+        if (*njobs == *capacity) {
+                *capacity = *capacity == 0 ? 16 : 2 * *capacity;
+                *jobs = realloc(*jobs, *capacity * sizeof(struct Batch_job));
+                assert(*jobs != NULL);
+        }
+        assert(input != NULL && output != NULL);
+        memset(&(*jobs)[*njobs], 0, sizeof(struct Batch_job));
+        (*jobs)[*njobs].input  = input;
+        (*jobs)[*njobs].output = output;
+        (*njobs)++;
+}
+
+/* Returns a new string "dir/name" */
+static char *join_path(const char *dir, const char *name)
+{
+        char *path = malloc(strlen(dir) + strlen(name) + 2);
+        assert(path != NULL);
+        sprintf(path, "%s/%s", dir, name);
+        return path;
+}
+
+/* qsort comparison for an array of strings */
+static int compare_names(const void *a, const void *b)
+{
+        return strcmp(*(char *const *)a, *(char *const *)b);
+}
@@ -0,0 +1,61 @@
+/***********************************************************************
+ *                              batch.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Interface to the batch mode of ppmtrans, which applies one
+ *          transform to many images in a single process instead of
+ *          starting ppmtrans once per file.
+ *
+ *          The jobs (an input and an output path each) come either from a
+ *          list file, one "input output" pair per line, or from every
+ *          .ppm file in a directory. A pool of worker threads takes jobs
+ *          in order, each loading, transforming and writing a whole image
+ *          on its own, so several images are in flight at once. With the
+ *          storage pool on (storage.h), the arrays of a finished image are
+ *          handed to the next one instead of being unmapped, so after the
+ *          first few images the workers stop paying for fresh pages.
+ *
+ *          A job whose input or output cannot be opened, or whose input
+ *          is not a P6 image it can read, is skipped and its error
+ *          recorded; the other jobs still run. Batch_report counts only
+ *          the images written, and ppmtrans then exits with status 1.
+ *
+ *          Usage:
+ *
+ *          struct Batch_job *jobs;
+ *          int n = Batch_read_list(list, &jobs);
+ *          double wall = Batch_run(jobs, n, &spec);
+ *          Batch_report(stderr, jobs, n, wall);
+ *          Batch_free(&jobs, n);
+ ***********************************************************************/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include "a2methods.h"
+
+struct Batch_spec {
+        A2Methods_T methods;    /* layout of both arrays of every image */
+        A2Methods_mapfun *map;  /* traversal of the source              */
+        int rotation;           /* rotation or code, as in transform.h  */
+        int threads;            /* workers, at least 1                  */
+};
+
+struct Batch_job {
+        char *input, *output;
+        const char *error;      /* NULL if the job succeeded            */
+        int width, height;
+        double read_ms, transform_ms, write_ms;
+};
+
+int    Batch_read_list(FILE *list, struct Batch_job **jobs);
+int    Batch_read_dir (const char *indir, const char *outdir,
+                       struct Batch_job **jobs);
+double Batch_run      (struct Batch_job *jobs, int njobs,
+                       const struct Batch_spec *spec);
+void   Batch_report   (FILE *out, const struct Batch_job *jobs, int njobs,
+                       double wall_ms);
+void   Batch_free     (struct Batch_job **jobs, int njobs);
+
+#endif
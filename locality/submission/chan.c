@@ -0,0 +1,118 @@
+/***********************************************************************
+ *                              chan.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the bounded channel in chan.h as a circular
+ *          array guarded by a mutex, with one condition variable for
+ *          "not full" and one for "not empty".
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "assert.h"
+#include "chan.h"
+
+struct Chan_T {
+        void **items;
+        int capacity, head, length, closed;
+        pthread_mutex_t lock;
+        pthread_cond_t  not_full, not_empty;
+};
+
+/*
+ * Chan_new
+ *    Purpose: Creates an empty channel
+ * Parameters: The most items it may hold at once
+ *    Returns: The channel
+ *    Expects: capacity >= 1 (checked)
+ */
+Chan_T Chan_new(int capacity)
+{
+        assert(capacity >= 1);
+        Chan_T chan = malloc(sizeof(*chan));
+        assert(chan != NULL);
+        chan->items = malloc(capacity * sizeof(void *));
+        assert(chan->items != NULL);
+        chan->capacity = capacity;
+        chan->head     = 0;
+        chan->length   = 0;
+        chan->closed   = 0;
+        pthread_mutex_init(&chan->lock, NULL);
+        pthread_cond_init(&chan->not_full, NULL);
+        pthread_cond_init(&chan->not_empty, NULL);
+        return chan;
+}
+
+/*
+ * Chan_free
+ *    Purpose: Frees a channel and sets *chan to NULL
+ *    Expects: No thread is still using the channel (unchecked). Items
+ *             still in it are not freed.
+ */
+void Chan_free(Chan_T *chan)
+{
+        assert(chan != NULL && *chan != NULL);
+        pthread_mutex_destroy(&(*chan)->lock);
+        pthread_cond_destroy(&(*chan)->not_full);
+        pthread_cond_destroy(&(*chan)->not_empty);
+        free((*chan)->items);
+        free(*chan);
+        *chan = NULL;
+}
+
+/*
+ * Chan_put
+ *    Purpose: Appends an item, waiting for room if the channel is full
+ *    Expects: item is nonnull and the channel is not closed (checked)
+ */
+void Chan_put(Chan_T chan, void *item)
+{
+        assert(chan != NULL && item != NULL);
+        pthread_mutex_lock(&chan->lock);
+        assert(!chan->closed);
+        while (chan->length == chan->capacity) {
+                pthread_cond_wait(&chan->not_full, &chan->lock);
+        }
+        chan->items[(chan->head + chan->length) % chan->capacity] = item;
+        chan->length++;
+        pthread_cond_signal(&chan->not_empty);
+        pthread_mutex_unlock(&chan->lock);
+}
+
+/*
+ * Chan_get
+ *    Purpose: Removes the oldest item, waiting for one if necessary
+ *    Returns: The item, or NULL once the channel is closed and empty
+ */
+void *Chan_get(Chan_T chan)
+{
+        void *item = NULL;
+
+        assert(chan != NULL);
+        pthread_mutex_lock(&chan->lock);
+        while (chan->length == 0 && !chan->closed) {
+                pthread_cond_wait(&chan->not_empty, &chan->lock);
+        }
+        if (chan->length > 0) {
+                item = chan->items[chan->head];
+                chan->head = (chan->head + 1) % chan->capacity;
+                chan->length--;
+                pthread_cond_signal(&chan->not_full);
+        }
+        pthread_mutex_unlock(&chan->lock);
+        return item;
+}
+
+/*
+ * Chan_close
+ *    Purpose: Says no more items will be put, waking every waiting reader
+ */
+void Chan_close(Chan_T chan)
+{
+        assert(chan != NULL);
+        pthread_mutex_lock(&chan->lock);
+        chan->closed = 1;
+        pthread_cond_broadcast(&chan->not_empty);
+        pthread_mutex_unlock(&chan->lock);
+}
@@ -0,0 +1,28 @@
+/***********************************************************************
+ *                              chan.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: A bounded, blocking, thread-safe FIFO of pointers, used to
+ *          link the stages of a pipeline. Chan_put blocks while the
+ *          channel is full, which keeps a fast producer from running
+ *          arbitrarily far ahead; Chan_get blocks while it is empty.
+ *          Once the producer side calls Chan_close, Chan_get drains what
+ *          is left and then returns NULL, so NULL cannot be sent.
+ *
+ *          The naming follows Hanson's conventions (Chan_new, Chan_free).
+ ***********************************************************************/
+
+#ifndef CHAN_H
+#define CHAN_H
+
+#define T Chan_T
+typedef struct T *T;
+
+extern T     Chan_new  (int capacity);
+extern void  Chan_free (T *chan);
+extern void  Chan_put  (T chan, void *item);
+extern void *Chan_get  (T chan);
+extern void  Chan_close(T chan);
+
+#undef T
+#endif
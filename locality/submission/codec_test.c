@@ -0,0 +1,418 @@
+/***********************************************************************
+ *                              codec_test.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Throughput benchmark of the QOI codec in qoi.h against raw
+ *          P6, for deciding which to use between pipeline stages. The
+ *          image is encoded to and decoded from memory, so the figures
+ *          leave out the disk or pipe and show how fast each format can
+ *          feed one; together with the encoded size they tell whether a
+ *          link is better spent on raw bytes or on QOI.
+ *
+ *          With -formats it instead compares the transform paths for
+ *          the three image types: the same picture as a P6 of struct
+ *          Pnm_rgb, as a P5 gray image (pgm.h) and as a bit-packed P4
+ *          bitonal image (pbm.h), made from the P6 in memory by taking
+ *          its luma and thresholding that at half the maxval. For each
+ *          it prints the bytes an array needs per pixel and the time per
+ *          pixel of several transforms.
+ *
+ *          A deep-color image (maxval above 255) has no QOI row, since
+ *          QOI holds only eight-bit samples. Both tables instead gain a
+ *          P6/16 row for the packed two-byte path of deep.h, next to the
+ *          generic struct Pnm_rgb path of the P6 row.
+ *
+ *          Usage: codec_test [-repeat n] [-formats] image.ppm
+ *
+ *          Throughput is counted in raw pixel bytes (three samples per
+ *          pixel, of one byte or two) so that the formats are directly
+ *          comparable. Every decode is checked against the original.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "assert.h"
+#include "a2plain.h"
+#include "cputiming.h"
+#include "ppmio.h"
+#include "qoi.h"
+#include "pgm.h"
+#include "pbm.h"
+#include "transform.h"
+#include "deep.h"
+
+struct codec {
+        const char *name;
+        void    (*encode)(FILE *fp, Pnm_ppm pic);
+        Pnm_ppm (*decode)(FILE *fp, A2Methods_T methods);
+};
+
+/* The transforms -formats times, by their -out names */
+static const char *const transform_names[] = {
+        "rot90", "rot180", "transpose", "fliph"
+};
+#define NTRANSFORMS (sizeof(transform_names) / sizeof(transform_names[0]))
+
+static void measure(CPUTime_T timer, const struct codec *codec,
+                    Pnm_ppm pic, int repeat);
+static void measure_deep(CPUTime_T timer, Pnm_ppm pic, int repeat);
+static int  same_pixels(Pnm_ppm a, Pnm_ppm b);
+static Deep_T deep_image(Pnm_ppm pic);
+static void compare_formats(CPUTime_T timer, Pnm_ppm pic, int repeat);
+static FILE *gray_image(Pnm_ppm pic, int bitonal, char **bytes);
+
+int
+main(int argc, char *argv[])
+{
+        static const struct codec codecs[] = {
+                { "P6",  Ppmio_store, Ppmio_load },
+                { "QOI", Qoi_write,   Qoi_read }
+        };
+        const char *image_name = NULL;
+        int repeat = 5, formats = 0;
+        CPUTime_T timer;
+        Pnm_ppm pic;
+        FILE *fp;
+
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-repeat") == 0 && i + 1 < argc) {
+                        repeat = strtol(argv[++i], NULL, 10);
+                } else if (strcmp(argv[i], "-formats") == 0) {
+                        formats = 1;
+                } else if (image_name == NULL && argv[i][0] != '-') {
+                        image_name = argv[i];
+                } else {
+                        image_name = NULL;
+                        break;
+                }
+        }
+        if (image_name == NULL || repeat < 1) {
+                fprintf(stderr, "Usage: %s [-repeat n] [-formats] "
+                        "image.ppm\n", argv[0]);
+                exit(1);
+        }
+        fp = fopen(image_name, "rb");
+        if (fp == NULL) {
+                fprintf(stderr, "Could not open %s\n", image_name);
+                exit(EXIT_FAILURE);
+        }
+        pic = Ppmio_load(fp, uarray2_methods_plain);
+        fclose(fp);
+        timer = CPUTime_New();
+        if (formats) {
+                compare_formats(timer, pic, repeat);
+                CPUTime_Free(&timer);
+                Ppmio_free(&pic);
+                return EXIT_SUCCESS;
+        }
+
+        printf("%u x %u, %d runs each\n", pic->width, pic->height, repeat);
+        printf("%-6s %12s %8s %12s %12s\n", "format", "bytes", "ratio",
+               "encode MB/s", "decode MB/s");
+        measure(timer, &codecs[0], pic, repeat);
+        if (pic->denominator > 255) {
+                measure_deep(timer, pic, repeat);
+        } else {
+                measure(timer, &codecs[1], pic, repeat);
+        }
+        CPUTime_Free(&timer);
+        Ppmio_free(&pic);
+
+        return EXIT_SUCCESS;
+}
+
+/*
+ * measure
+ *    Purpose: Encodes the image repeat times into a memory buffer, then
+ *             decodes it repeat times, checking each result, and prints
+ *             one row of the table
+ * Parameters: The timer, the codec, the image, and the number of runs
+ *    Expects: The codec round-trips the image exactly (checked)
+ */
+static void measure(CPUTime_T timer, const struct codec *codec,
+                    Pnm_ppm pic, int repeat)
+{
+        double raw = (pic->denominator > 255 ? 6.0 : 3.0) * pic->width
+                     * pic->height;
+        double encode_ns = 0, decode_ns = 0;
+        char *bytes = NULL;
+        size_t size = 0;
+
+        for (int rep = 0; rep < repeat; rep++) {
+                FILE *fp = open_memstream(&bytes, &size);
+                assert(fp != NULL);
+                CPUTime_Start(timer);
+                codec->encode(fp, pic);
+                fflush(fp);
+                encode_ns += CPUTime_Stop(timer);
+                fclose(fp);
+                if (rep + 1 < repeat) {
+                        free(bytes);
+                }
+        }
+        for (int rep = 0; rep < repeat; rep++) {
+                FILE *fp = fmemopen(bytes, size, "rb");
+                Pnm_ppm copy;
+                assert(fp != NULL);
+                CPUTime_Start(timer);
+                copy = codec->decode(fp, uarray2_methods_plain);
+                decode_ns += CPUTime_Stop(timer);
+                fclose(fp);
+                assert(same_pixels(pic, copy));
+                Ppmio_free(&copy);
+        }
+        free(bytes);
+
+        /* bytes per nanosecond is GB/s; 1000 times that is MB/s */
+        printf("%-6s %12zu %8.3f %12.1f %12.1f\n", codec->name, size,
+               size / raw, 1000.0 * raw * repeat / encode_ns,
+               1000.0 * raw * repeat / decode_ns);
+}
+
+/*
+ * measure_deep
+ *    Purpose: Like measure, for a deep-color image written with Deep_write
+ *             and read with Ppmio_read_header and Deep_read
+ * Parameters: The timer, the image, and the number of runs
+ *    Expects: The maxval is above 255; Deep_write of each decoded image
+ *             gives the same bytes as the first encoding (checked)
+ */
+static void measure_deep(CPUTime_T timer, Pnm_ppm pic, int repeat)
+{
+        double raw = 6.0 * pic->width * pic->height;
+        double encode_ns = 0, decode_ns = 0;
+        Deep_T deep = deep_image(pic);
+        char *bytes = NULL, *again = NULL;
+        size_t size = 0, again_size = 0;
+
+        for (int rep = 0; rep < repeat; rep++) {
+                FILE *fp = open_memstream(&bytes, &size);
+                assert(fp != NULL);
+                CPUTime_Start(timer);
+                Deep_write(fp, deep);
+                fflush(fp);
+                encode_ns += CPUTime_Stop(timer);
+                fclose(fp);
+                if (rep + 1 < repeat) {
+                        free(bytes);
+                }
+        }
+        Deep_free(&deep);
+        for (int rep = 0; rep < repeat; rep++) {
+                FILE *fp = fmemopen(bytes, size, "rb");
+                struct Ppmio_header h;
+                assert(fp != NULL);
+                CPUTime_Start(timer);
+                Ppmio_read_header(fp, &h);
+                deep = Deep_read(fp, &h, uarray2_methods_plain);
+                decode_ns += CPUTime_Stop(timer);
+                fclose(fp);
+
+                fp = open_memstream(&again, &again_size);
+                assert(fp != NULL);
+                Deep_write(fp, deep);
+                fclose(fp);
+                assert(again_size == size
+                       && memcmp(again, bytes, size) == 0);
+                free(again);
+                Deep_free(&deep);
+        }
+        free(bytes);
+
+        printf("%-6s %12zu %8.3f %12.1f %12.1f\n", "P6/16", size,
+               size / raw, 1000.0 * raw * repeat / encode_ns,
+               1000.0 * raw * repeat / decode_ns);
+}
+
+/* Whether two images have the same size and pixels */
+static int same_pixels(Pnm_ppm a, Pnm_ppm b)
+{
+        if (a->width != b->width || a->height != b->height) {
+                return 0;
+        }
+        for (unsigned y = 0; y < a->height; y++) {
+                for (unsigned x = 0; x < a->width; x++) {
+                        struct Pnm_rgb *p = a->methods->at(a->pixels, x, y);
+                        struct Pnm_rgb *q = b->methods->at(b->pixels, x, y);
+                        if (p->red != q->red || p->green != q->green
+                            || p->blue != q->blue) {
+                                return 0;
+                        }
+                }
+        }
+        return 1;
+}
+
+/*
+ * compare_formats
+ *    Purpose: Prints the -formats table: for the image as a P6, a P5 and a
+ *             P4, and as a P6/16 if it is deep-color, the bytes per pixel
+ *             of its array and the mean time per pixel of each transform
+ *             in transform_names
+ * Parameters: The timer, the image, and the number of runs of each
+ *             transform
+ */
+static void compare_formats(CPUTime_T timer, Pnm_ppm pic, int repeat)
+{
+        A2Methods_T methods = uarray2_methods_plain;
+        double pixels = (double)pic->width * pic->height * repeat;
+        int nformats = pic->denominator > 255 ? 4 : 3;
+        double ns[4][NTRANSFORMS];
+        Deep_T deep = nformats == 4 ? deep_image(pic) : NULL;
+        char *bytes;
+        FILE *fp;
+        Pgm_T pgm;
+        Pbm_T pbm;
+
+        fp  = gray_image(pic, 0, &bytes);
+        pgm = Pgm_read(fp, methods);
+        fclose(fp);
+        free(bytes);
+        fp  = gray_image(pic, 1, &bytes);
+        pbm = Pbm_read(fp);
+        fclose(fp);
+        free(bytes);
+
+        for (size_t t = 0; t < NTRANSFORMS; t++) {
+                int rotation;
+                transform_from_name(transform_names[t], &rotation);
+                ns[0][t] = ns[1][t] = ns[2][t] = ns[3][t] = 0;
+                for (int rep = 0; rep < repeat; rep++) {
+                        A2Methods_UArray2 ppm_out;
+                        Pgm_T pgm_out;
+                        Pbm_T pbm_out;
+
+                        CPUTime_Start(timer);
+                        ppm_out = transform_image(pic, rotation, methods,
+                                                  methods->map_default);
+                        ns[0][t] += CPUTime_Stop(timer);
+                        methods->free(&ppm_out);
+
+                        CPUTime_Start(timer);
+                        pgm_out = Pgm_transform(pgm, rotation,
+                                                methods->map_default);
+                        ns[1][t] += CPUTime_Stop(timer);
+                        Pgm_free(&pgm_out);
+
+                        CPUTime_Start(timer);
+                        pbm_out = Pbm_transform(pbm, rotation);
+                        ns[2][t] += CPUTime_Stop(timer);
+                        Pbm_free(&pbm_out);
+
+                        if (deep != NULL) {
+                                Deep_T deep_out;
+                                CPUTime_Start(timer);
+                                deep_out = Deep_transform(deep, rotation,
+                                                methods->map_default);
+                                ns[3][t] += CPUTime_Stop(timer);
+                                Deep_free(&deep_out);
+                        }
+                }
+        }
+
+        printf("%u x %u, %d runs each, ns per pixel\n", pic->width,
+               pic->height, repeat);
+        printf("%-6s %12s", "format", "bytes/pixel");
+        for (size_t t = 0; t < NTRANSFORMS; t++) {
+                printf(" %10s", transform_names[t]);
+        }
+        printf("\n");
+        for (int f = 0; f < nformats; f++) {
+                static const char *const names[] = {
+                        "P6", "P5", "P4", "P6/16"
+                };
+                double size[] = { sizeof(struct Pnm_rgb),
+                                  Pgm_maxval(pgm) > 255 ? 2 : 1, 0.125,
+                                  sizeof(struct Deep_rgb) };
+                printf("%-6s %12.3f", names[f], size[f]);
+                for (size_t t = 0; t < NTRANSFORMS; t++) {
+                        printf(" %10.2f", ns[f][t] / pixels);
+                }
+                printf("\n");
+        }
+        Pgm_free(&pgm);
+        Pbm_free(&pbm);
+        if (deep != NULL) {
+                Deep_free(&deep);
+        }
+}
+
+/*
+ * deep_image
+ *    Purpose: Makes the packed copy of a deep-color image, by writing it
+ *             to memory as a P6 and reading that back with Deep_read
+ * Parameters: The image
+ *    Returns: The copy, to be freed with Deep_free
+ *    Expects: The maxval is above 255
+ */
+static Deep_T deep_image(Pnm_ppm pic)
+{
+        struct Ppmio_header h;
+        char *bytes = NULL;
+        size_t size = 0;
+        Deep_T deep;
+        FILE *fp = open_memstream(&bytes, &size);
+
+        assert(fp != NULL);
+        Ppmio_store(fp, pic);
+        fclose(fp);
+        fp = fmemopen(bytes, size, "rb");
+        assert(fp != NULL);
+        Ppmio_read_header(fp, &h);
+        deep = Deep_read(fp, &h, uarray2_methods_plain);
+        fclose(fp);
+        free(bytes);
+        return deep;
+}
+
+/*
+ * gray_image
+ *    Purpose: Writes the luma of an image into memory as a binary PGM with
+ *             the same maxval, or, if bitonal, as a binary PBM in which a
+ *             pixel is black when its luma is below half the maxval
+ * Parameters: The image, which of the two to make, and where to put the
+ *             buffer, to be freed once the returned file is closed
+ *    Returns: The file, open for reading at the start of the image
+ */
+static FILE *gray_image(Pnm_ppm pic, int bitonal, char **bytes)
+{
+        unsigned maxval = pic->denominator;
+        size_t size = 0;
+        FILE *fp = open_memstream(bytes, &size);
+
+        assert(fp != NULL);
+        fprintf(fp, "P%c\n%u %u\n", bitonal ? '4' : '5', pic->width,
+                pic->height);
+        if (!bitonal) {
+                fprintf(fp, "%u\n", maxval);
+        }
+        for (unsigned y = 0; y < pic->height; y++) {
+                int bits = 0, nbits = 0;
+                for (unsigned x = 0; x < pic->width; x++) {
+                        struct Pnm_rgb *p = pic->methods->at(pic->pixels, x,
+                                                             y);
+                        unsigned luma = (299 * p->red + 587 * p->green
+                                         + 114 * p->blue + 500) / 1000;
+                        if (!bitonal) {
+                                if (maxval > 255) {
+                                        putc(luma >> 8, fp);
+                                }
+                                putc(luma & 0xff, fp);
+                                continue;
+                        }
+                        bits = bits << 1 | (2 * luma < maxval);
+                        if (++nbits == 8) {
+                                putc(bits, fp);
+                                bits = nbits = 0;
+                        }
+                }
+                if (nbits > 0) {
+                        putc(bits << (8 - nbits), fp);
+                }
+        }
+        fclose(fp);
+        fp = fmemopen(*bytes, size, "rb");
+        assert(fp != NULL);
+        return fp;
+}
@@ -0,0 +1,172 @@
+/***********************************************************************
+ *                              color.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the fused color conversion in color.h. The
+ *          coefficients are those of libjpeg, scaled by 2^16:
+ *
+ *              Y  =  0.29900 R + 0.58700 G + 0.11400 B
+ *              Cb = -0.16874 R - 0.33126 G + 0.50000 B + 128
+ *              Cr =  0.50000 R - 0.41869 G - 0.08131 B + 128
+ *
+ *          Each result is rounded by adding one half before the shift,
+ *          less one for the chroma, as libjpeg does, so that a full 0.5
+ *          weight on 255 cannot round up to 256.
+ *
+ *          The arithmetic is scalar on purpose. Pixels arrive one at a
+ *          time from the map, and a version that gathered them into
+ *          batches for SSE2 was slower than this one: the multiplies are
+ *          a small part of the cost of a pixel next to the map callback,
+ *          coords_calc and at. What does pay is calling at once per pixel
+ *          rather than once per plane. The planes of a UArray2 or
+ *          UArray2b share one layout, so a pixel sits at the same offset
+ *          in each of them, and its Cb and Cr places follow from its
+ *          place in the Y plane.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "assert.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "trace.h"
+#include "transform.h"
+#include "color.h"
+
+typedef A2Methods_UArray2 A2;
+
+#define SCALE_BITS 16
+#define ONE_HALF   (1 << (SCALE_BITS - 1))
+#define FIX(x)     ((int)((x) * (1 << SCALE_BITS) + 0.5))
+#define CHROMA_OFFSET (128 << SCALE_BITS)
+
+struct color_closure {
+        struct transform_closure transform;     /* output unused */
+        int width, height;                      /* of the source */
+        unsigned maxval;
+        int nplanes;
+        A2 *planes;
+        int same_layout;                        /* of all the planes */
+        intptr_t offset[COLOR_MAX_PLANES];      /* of each from plane 0 */
+};
+
+static void convert(int i, int j, A2 array, void *elem, void *cl);
+
+/*
+ * Color_transform
+ *    Purpose: Transforms an image and converts it to gray or YCbCr in one
+ *             traversal
+ * Parameters: The source image, the rotation or code, the color space,
+ *             the methods the source was read with (also used for the
+ *             planes), the map function to traverse the source, and where
+ *             to put the planes
+ *    Returns: The number of planes made: 1 for gray, 3 for YCbCr. Each is
+ *             an array of unsigned char, to be freed with methods->free.
+ *    Expects: pic, methods, map and planes are nonnull (checked); the
+ *             rotation is valid (raises invalid_parameter otherwise)
+ */
+int Color_transform(Pnm_ppm pic, int rotation, enum Color_space space,
+                    A2Methods_T methods, A2Methods_mapfun *map,
+                    A2 planes[COLOR_MAX_PLANES])
+{
+        struct color_closure cl = {{rotation, methods, NULL, NULL},
+                                   0, 0, 0, 0, planes, 0, {0, 0, 0}};
+        int swap = rotation == 90 || rotation == 270
+                   || rotation == TRANSPOSE_CODE;
+
+        assert(pic != NULL && methods != NULL && map != NULL
+               && planes != NULL);
+        assign_coords_calc(&cl.transform);
+        cl.width   = pic->width;
+        cl.height  = pic->height;
+        cl.maxval  = pic->denominator;
+        cl.nplanes = space == COLOR_YCBCR ? 3 : 1;
+        for (int k = 0; k < cl.nplanes; k++) {
+                planes[k] = methods->new(swap ? cl.height : cl.width,
+                                         swap ? cl.width : cl.height, 1);
+        }
+        cl.same_layout = methods == uarray2_methods_plain
+                         || methods == uarray2_methods_blocked;
+        for (int k = 0; k < cl.nplanes && cl.same_layout; k++) {
+                cl.offset[k] = (intptr_t)methods->at(planes[k], 0, 0)
+                               - (intptr_t)methods->at(planes[0], 0, 0);
+        }
+
+        TRACE_BEGIN(TRACE_DETAIL, "convert");
+        map(pic->pixels, convert, &cl);
+        TRACE_END(TRACE_DETAIL);
+        return cl.nplanes;
+}
+
+/*
+ * convert
+ *    Purpose: Meant to be passed into a map function. Converts a source
+ *             pixel and stores the results at its transformed place in
+ *             every plane
+ * Parameters: As for transform, with cl pointing to a color_closure
+ *    Returns: Nothing
+ *    Expects: The coordinates are in bounds (unchecked)
+ */
+static void convert(int i, int j, A2 array, void *elem, void *cl)
+{
+        struct color_closure *color = cl;
+        struct transform_closure *t = &color->transform;
+        struct Pnm_rgb *pixel = elem;
+        struct Coordinates to = {i, j};
+        int r = pixel->red, g = pixel->green, b = pixel->blue;
+        unsigned char *y, *cb, *cr;
+
+        (void) array;
+        if (color->maxval != 255) {
+                r = (r * 255 + color->maxval / 2) / color->maxval;
+                g = (g * 255 + color->maxval / 2) / color->maxval;
+                b = (b * 255 + color->maxval / 2) / color->maxval;
+        }
+        to = t->coords_calc(color->height, color->width, t->amount, to);
+        y  = t->methods->at(color->planes[0], to.col, to.row);
+        *y = (FIX(0.29900) * r + FIX(0.58700) * g + FIX(0.11400) * b
+              + ONE_HALF) >> SCALE_BITS;
+        if (color->nplanes == 1) {
+                return;
+        }
+        if (color->same_layout) {
+                cb = (unsigned char *)((intptr_t)y + color->offset[1]);
+                cr = (unsigned char *)((intptr_t)y + color->offset[2]);
+        } else {
+                cb = t->methods->at(color->planes[1], to.col, to.row);
+                cr = t->methods->at(color->planes[2], to.col, to.row);
+        }
+        *cb = (-FIX(0.16874) * r - FIX(0.33126) * g + FIX(0.50000) * b
+               + CHROMA_OFFSET + ONE_HALF - 1) >> SCALE_BITS;
+        *cr = (FIX(0.50000) * r - FIX(0.41869) * g - FIX(0.08131) * b
+               + CHROMA_OFFSET + ONE_HALF - 1) >> SCALE_BITS;
+}
+
+/*
+ * Color_write_plane
+ *    Purpose: Writes a plane as a binary PGM with a maxval of 255
+ * Parameters: The output file, the methods the plane was made with, and
+ *             the plane
+ *    Returns: Nothing
+ *    Expects: fp, methods and plane are nonnull (checked)
+ */
+void Color_write_plane(FILE *fp, A2Methods_T methods, A2 plane)
+{
+        int width, height;
+        unsigned char *row;
+
+        assert(fp != NULL && methods != NULL && plane != NULL);
+        width  = methods->width(plane);
+        height = methods->height(plane);
+        row    = malloc(width);
+        assert(row != NULL);
+        fprintf(fp, "P5\n%d %d\n255\n", width, height);
+        for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                        row[x] = *(unsigned char *)methods->at(plane, x, y);
+                }
+                fwrite(row, 1, width, fp);
+        }
+        free(row);
+}
@@ -0,0 +1,34 @@
+/***********************************************************************
+ *                              color.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Color space conversion fused with the ppmtrans transforms.
+ *          Color_transform maps over the source once, as transform_image
+ *          does, but stores at each pixel's transformed place its luma,
+ *          or its luma and two chroma values, in planes of one byte per
+ *          pixel instead of a 12-byte struct Pnm_rgb. The conversion is
+ *          that of JPEG (full-range ITU-R BT.601), in 16-bit fixed point.
+ *          Images with a maxval other than 255 are rescaled to 255 first.
+ *
+ *          Color_write_plane writes a plane as a binary (P5) PGM.
+ ***********************************************************************/
+
+#ifndef COLOR_H
+#define COLOR_H
+
+#include <stdio.h>
+#include "a2methods.h"
+#include "pnm.h"
+
+enum Color_space { COLOR_GRAY, COLOR_YCBCR };
+
+/* Planes of a Color_transform: Y, and for COLOR_YCBCR also Cb and Cr */
+#define COLOR_MAX_PLANES 3
+
+int  Color_transform  (Pnm_ppm pic, int rotation, enum Color_space space,
+                       A2Methods_T methods, A2Methods_mapfun *map,
+                       A2Methods_UArray2 planes[COLOR_MAX_PLANES]);
+void Color_write_plane(FILE *fp, A2Methods_T methods,
+                       A2Methods_UArray2 plane);
+
+#endif
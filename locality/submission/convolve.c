@@ -0,0 +1,305 @@
+/***********************************************************************
+ *                              convolve.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the tiled convolution in convolve.h.
+ *
+ *          Each worker owns its buffers: "in" holds a tile and its halo,
+ *          one plane of floats per channel; "mid" holds the result of the
+ *          horizontal pass of a separable kernel, as tall as "in" but only
+ *          as wide as the tile; "acc" accumulates one output row. The
+ *          loops put the kernel taps outside and the pixels of a row
+ *          inside, so the inner loop is a multiply-add over contiguous
+ *          floats.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "assert.h"
+#include "trace.h"
+#include "parallel.h"
+#include "convolve.h"
+
+typedef A2Methods_UArray2 A2;
+
+struct buffers {
+        int stride;                     /* of in, tile + 2 radius */
+        float *in[3], *mid[3], *acc;
+};
+
+struct convolution {
+        Pnm_ppm pic;
+        A2Methods_T methods;
+        A2 output;
+        const struct Convolve_kernel *kernel;
+        int radius, tile, tiles_across, ntiles;
+        struct buffers *buffers;        /* one set per worker */
+};
+
+static void  convolve_tile(int tile, int worker, void *convolution);
+static void  load_tile(struct convolution *c, struct buffers *b, int x0,
+                       int y0, int width, int height);
+static void  filter_tile(struct convolution *c, struct buffers *b, int x0,
+                         int y0, int width, int height);
+static void  store_row(struct convolution *c, const float *acc, int channel,
+                       int x0, int y, int width);
+static void  separable_kernel(struct Convolve_kernel *kernel, int size,
+                              const float *taps);
+
+/*
+ * Convolve_kernel_named
+ *    Purpose: Looks up a kernel by name: "blur" (a 3 by 3 Gaussian),
+ *             "box<n>" or "gauss<n>" for an n by n box or binomial
+ *             Gaussian with n odd, "sharpen", or "edge" (a Laplacian)
+ * Parameters: The name and where to put the kernel
+ *    Returns: 1 if the name is known, 0 otherwise
+ */
+int Convolve_kernel_named(const char *name, struct Convolve_kernel *kernel)
+{
+        static const float sharpen[9] = { 0, -1,  0,
+                                         -1,  5, -1,
+                                          0, -1,  0 };
+        static const float edge[9]    = {-1, -1, -1,
+                                         -1,  8, -1,
+                                         -1, -1, -1 };
+        float taps[CONVOLVE_MAX_SIZE];
+        int size;
+        char extra;
+
+        assert(name != NULL && kernel != NULL);
+        memset(kernel, 0, sizeof(*kernel));
+        if (strcmp(name, "sharpen") == 0 || strcmp(name, "edge") == 0) {
+                kernel->size      = 3;
+                kernel->separable = 0;
+                memcpy(kernel->weights, name[0] == 's' ? sharpen : edge,
+                       sizeof(sharpen));
+                return 1;
+        }
+        if (strcmp(name, "blur") == 0) {
+                name = "gauss3";
+        }
+        if (sscanf(name, "box%d%c", &size, &extra) == 1
+            && size >= 1 && size <= CONVOLVE_MAX_SIZE && size % 2 == 1) {
+                for (int k = 0; k < size; k++) {
+                        taps[k] = 1.0f / size;
+                }
+                separable_kernel(kernel, size, taps);
+                return 1;
+        }
+        if (sscanf(name, "gauss%d%c", &size, &extra) == 1
+            && size >= 1 && size <= CONVOLVE_MAX_SIZE && size % 2 == 1) {
+                /* row size - 1 of Pascal's triangle, over its sum */
+                double coefficient = 1, sum = 1 << (size - 1);
+                for (int k = 0; k < size; k++) {
+                        taps[k]     = coefficient / sum;
+                        coefficient = coefficient * (size - 1 - k) / (k + 1);
+                }
+                separable_kernel(kernel, size, taps);
+                return 1;
+        }
+        return 0;
+}
+
+/* Makes a separable kernel with the same taps in both directions */
+static void separable_kernel(struct Convolve_kernel *kernel, int size,
+                             const float *taps)
+{
+        kernel->size      = size;
+        kernel->separable = 1;
+        for (int k = 0; k < size; k++) {
+                kernel->horizontal[k] = taps[k];
+                kernel->vertical[k]   = taps[k];
+        }
+}
+
+/*
+ * Convolve_image
+ *    Purpose: Convolves an image with a kernel
+ * Parameters: The image, the methods it was read with (also used for the
+ *             output), the kernel, and the number of threads
+ *    Returns: A new array of Pnm_rgb the size of the image, to be freed
+ *             with methods->free
+ *    Expects: pic, methods and kernel are nonnull, the kernel size is odd
+ *             and at most CONVOLVE_MAX_SIZE, and threads is at least 1
+ *             (all checked)
+ */
+A2 Convolve_image(Pnm_ppm pic, A2Methods_T methods,
+                  const struct Convolve_kernel *kernel, int threads)
+{
+        struct convolution c;
+        int width, height, nworkers;
+
+        assert(pic != NULL && methods != NULL && kernel != NULL);
+        assert(kernel->size >= 1 && kernel->size <= CONVOLVE_MAX_SIZE
+               && kernel->size % 2 == 1 && threads >= 1);
+        width     = pic->width;
+        height    = pic->height;
+        c.pic     = pic;
+        c.methods = methods;
+        c.kernel  = kernel;
+        c.radius  = kernel->size / 2;
+        c.output  = methods->new(width, height, sizeof(struct Pnm_rgb));
+        /* tiles of a blocked source are its blocks */
+        c.tile    = Parallel_tile(methods, pic->pixels);
+        c.tiles_across = (width + c.tile - 1) / c.tile;
+        c.ntiles       = c.tiles_across * ((height + c.tile - 1) / c.tile);
+
+        nworkers  = Parallel_workers(c.ntiles, threads);
+        c.buffers = malloc(nworkers * sizeof(struct buffers));
+        assert(c.buffers != NULL);
+        for (int i = 0; i < nworkers; i++) {
+                struct buffers *b = &c.buffers[i];
+                b->stride = c.tile + 2 * c.radius;
+                for (int ch = 0; ch < 3; ch++) {
+                        b->in[ch]  = malloc(b->stride * b->stride
+                                            * sizeof(float));
+                        b->mid[ch] = malloc(b->stride * c.tile
+                                            * sizeof(float));
+                        assert(b->in[ch] != NULL && b->mid[ch] != NULL);
+                }
+                b->acc = malloc(c.tile * sizeof(float));
+                assert(b->acc != NULL);
+        }
+
+        TRACE_BEGIN(TRACE_DETAIL, "convolve");
+        Parallel_for(c.ntiles, threads, convolve_tile, &c);
+        TRACE_END(TRACE_DETAIL);
+
+        for (int i = 0; i < nworkers; i++) {
+                for (int ch = 0; ch < 3; ch++) {
+                        free(c.buffers[i].in[ch]);
+                        free(c.buffers[i].mid[ch]);
+                }
+                free(c.buffers[i].acc);
+        }
+        free(c.buffers);
+        return c.output;
+}
+
+/* Filters one tile, a Parallel_for task, in the worker's own buffers */
+static void convolve_tile(int tile, int worker, void *convolution)
+{
+        struct convolution *c = convolution;
+        struct buffers *b = &c->buffers[worker];
+        int width = c->pic->width, height = c->pic->height;
+        int x0 = tile % c->tiles_across * c->tile,
+            y0 = tile / c->tiles_across * c->tile;
+        int tw = x0 + c->tile < width  ? c->tile : width - x0,
+            th = y0 + c->tile < height ? c->tile : height - y0;
+
+        load_tile(c, b, x0, y0, tw, th);
+        filter_tile(c, b, x0, y0, tw, th);
+}
+
+/*
+ * load_tile
+ *    Purpose: Copies a tile of the source and its halo into the "in"
+ *             planes, repeating the edge pixels past the edges
+ * Parameters: The convolution, the buffers, and the tile's top left corner
+ *             and size
+ */
+static void load_tile(struct convolution *c, struct buffers *b, int x0,
+                      int y0, int width, int height)
+{
+        int r = c->radius;
+        int last_col = c->pic->width - 1, last_row = c->pic->height - 1;
+
+        for (int y = 0; y < height + 2 * r; y++) {
+                int sy = y0 + y - r;
+                sy = sy < 0 ? 0 : sy > last_row ? last_row : sy;
+                for (int x = 0; x < width + 2 * r; x++) {
+                        int sx = x0 + x - r;
+                        struct Pnm_rgb *pixel;
+                        sx = sx < 0 ? 0 : sx > last_col ? last_col : sx;
+                        pixel = c->methods->at(c->pic->pixels, sx, sy);
+                        b->in[0][y * b->stride + x] = pixel->red;
+                        b->in[1][y * b->stride + x] = pixel->green;
+                        b->in[2][y * b->stride + x] = pixel->blue;
+                }
+        }
+}
+
+/*
+ * filter_tile
+ *    Purpose: Convolves the loaded tile and stores it in the output
+ * Parameters: The convolution, the buffers holding the tile, and the
+ *             tile's top left corner and size
+ */
+static void filter_tile(struct convolution *c, struct buffers *b, int x0,
+                        int y0, int width, int height)
+{
+        const struct Convolve_kernel *k = c->kernel;
+        int size = k->size, stride = b->stride;
+
+        for (int ch = 0; ch < 3; ch++) {
+                const float *in = b->in[ch];
+                float *mid = b->mid[ch], *acc = b->acc;
+
+                if (k->separable) {
+                        /* horizontal pass over every row of the halo */
+                        for (int y = 0; y < height + size - 1; y++) {
+                                float *to = mid + y * c->tile;
+                                const float *from = in + y * stride;
+                                for (int x = 0; x < width; x++) {
+                                        to[x] = 0;
+                                }
+                                for (int t = 0; t < size; t++) {
+                                        float w = k->horizontal[t];
+                                        for (int x = 0; x < width; x++) {
+                                                to[x] += w * from[x + t];
+                                        }
+                                }
+                        }
+                }
+                for (int y = 0; y < height; y++) {
+                        for (int x = 0; x < width; x++) {
+                                acc[x] = 0;
+                        }
+                        for (int ty = 0; ty < size; ty++) {
+                                if (k->separable) {
+                                        const float *from = mid + (y + ty)
+                                                            * c->tile;
+                                        float w = k->vertical[ty];
+                                        for (int x = 0; x < width; x++) {
+                                                acc[x] += w * from[x];
+                                        }
+                                        continue;
+                                }
+                                const float *from = in + (y + ty) * stride;
+                                for (int tx = 0; tx < size; tx++) {
+                                        float w = k->weights[ty * size + tx];
+                                        if (w == 0) {
+                                                continue;
+                                        }
+                                        for (int x = 0; x < width; x++) {
+                                                acc[x] += w * from[x + tx];
+                                        }
+                                }
+                        }
+                        store_row(c, acc, ch, x0, y0 + y, width);
+                }
+        }
+}
+
+/* Rounds and clamps a row of one channel into the output */
+static void store_row(struct convolution *c, const float *acc, int channel,
+                      int x0, int y, int width)
+{
+        float max = c->pic->denominator;
+
+        for (int x = 0; x < width; x++) {
+                struct Pnm_rgb *pixel = c->methods->at(c->output, x0 + x,
+                                                       y);
+                float v = acc[x] + 0.5f;
+                unsigned value = v < 0 ? 0 : v > max ? max : (unsigned)v;
+                if (channel == 0) {
+                        pixel->red = value;
+                } else if (channel == 1) {
+                        pixel->green = value;
+                } else {
+                        pixel->blue = value;
+                }
+        }
+}
@@ -0,0 +1,46 @@
+/***********************************************************************
+ *                              convolve.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Convolution filters (blur, sharpen, edge detection) for
+ *          ppmtrans -convolve. Kernels are square and odd-sized, from 1 by
+ *          1 up to CONVOLVE_MAX_SIZE, and either separable (one horizontal
+ *          pass, then one vertical) or general. Pixels past the edges of
+ *          the image are taken to be copies of the nearest edge pixel, and
+ *          results are clamped to the range of the image.
+ *
+ *          Convolve_image works one square tile at a time, the tiles being
+ *          the blocks of a blocked source. A tile is first copied, with a
+ *          halo as wide as the kernel's radius around it, into small
+ *          buffers of floats, one per channel; all the arithmetic then
+ *          runs over those buffers, in loops along contiguous rows, and
+ *          the tile and its halo stay in the cache instead of the filter
+ *          streaming whole rows of the image. (The Makefile builds
+ *          without -O, so those loops are not vectorized as shipped; an
+ *          optimized build can vectorize them.) Tiles are handed out to
+ *          threads by Parallel_for (parallel.h).
+ ***********************************************************************/
+
+#ifndef CONVOLVE_H
+#define CONVOLVE_H
+
+#include "a2methods.h"
+#include "pnm.h"
+
+#define CONVOLVE_MAX_SIZE 15
+
+struct Convolve_kernel {
+        int size;                       /* odd, 1 to CONVOLVE_MAX_SIZE */
+        int separable;
+        /* separable kernels: weight of column x is horizontal[x] times
+           vertical[y] in row y; others: weights[y * size + x] */
+        float horizontal[CONVOLVE_MAX_SIZE], vertical[CONVOLVE_MAX_SIZE];
+        float weights[CONVOLVE_MAX_SIZE * CONVOLVE_MAX_SIZE];
+};
+
+int Convolve_kernel_named(const char *name, struct Convolve_kernel *kernel);
+A2Methods_UArray2 Convolve_image(Pnm_ppm pic, A2Methods_T methods,
+                                 const struct Convolve_kernel *kernel,
+                                 int threads);
+
+#endif
@@ -0,0 +1,96 @@
+/***********************************************************************
+ *                              crop.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the region-of-interest transform in crop.h.
+ ***********************************************************************/
+
+#include <stdlib.h>
+
+#include "assert.h"
+#include "ppmio.h"
+#include "trace.h"
+#include "transform.h"
+#include "crop.h"
+
+static void skip_rows(FILE *in, const struct Ppmio_header *h, int rows,
+                      unsigned char *row);
+
+/*
+ * Crop_load
+ *    Purpose: Reads a region of a binary PPM and transforms it in the same
+ *             pass
+ * Parameters: The open input, the region in image coordinates, the
+ *             rotation or code (as in transform.h), and the methods for
+ *             the output
+ *    Returns: The transformed region, to be freed with Ppmio_free, or
+ *             NULL if the region does not lie inside the image
+ *    Expects: The input is a P6 image (raises Ppmio_badformat otherwise),
+ *             region and methods are nonnull (checked), and the rotation
+ *             is valid (raises invalid_parameter otherwise)
+ */
+Pnm_ppm Crop_load(FILE *in, const struct A2View_region *region,
+                  int rotation, A2Methods_T methods)
+{
+        struct Ppmio_header h;
+        struct transform_closure cl = {rotation, methods, NULL, NULL};
+        struct Pnm_ppm shape;
+        unsigned char *row;
+        Pnm_ppm pic;
+        long raster;
+
+        assert(region != NULL && methods != NULL);
+        if (!Ppmio_read_header(in, &h)) {
+                RAISE(Ppmio_badformat);
+        }
+        if (!A2View_inside(region, h.width, h.height)) {
+                return NULL;
+        }
+        assign_coords_calc(&cl);
+
+        shape.width       = region->width;
+        shape.height      = region->height;
+        shape.denominator = h.maxval;
+        shape.methods     = methods;
+        pic  = malloc(sizeof(*pic));
+        row  = malloc(Ppmio_row_bytes(&h));
+        assert(pic != NULL && row != NULL);
+        *pic = shape;
+        pic->pixels = make_a2_out(rotation, methods, &shape);
+        pic->width  = methods->width(pic->pixels);
+        pic->height = methods->height(pic->pixels);
+
+        /* jump over the rows above the region if the input allows it */
+        TRACE_BEGIN(TRACE_DETAIL, "skip");
+        raster = ftell(in);
+        if (raster < 0 || fseek(in, raster + (long)region->y
+                                        * Ppmio_row_bytes(&h),
+                                SEEK_SET) != 0) {
+                skip_rows(in, &h, region->y, row);
+        }
+        TRACE_END(TRACE_DETAIL);
+
+        for (int r = 0; r < region->height; r++) {
+                Ppmio_read_rows(in, &h, row, 1);
+                for (int c = 0; c < region->width; c++) {
+                        struct Coordinates to = {c, r};
+                        to = cl.coords_calc(region->height, region->width,
+                                            rotation, to);
+                        Ppmio_to_rgb(&h, row,
+                                     methods->at(pic->pixels, to.col,
+                                                 to.row),
+                                     region->x + c);
+                }
+        }
+        free(row);
+        return pic;
+}
+
+/* Reads and discards rows of the raster, for input that cannot seek */
+static void skip_rows(FILE *in, const struct Ppmio_header *h, int rows,
+                      unsigned char *row)
+{
+        for (int r = 0; r < rows; r++) {
+                Ppmio_read_rows(in, h, row, 1);
+        }
+}
@@ -0,0 +1,27 @@
+/***********************************************************************
+ *                              crop.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Region-of-interest transforms for ppmtrans -crop. Crop_load
+ *          decodes only the rows of a binary PPM that hold the region,
+ *          seeking straight to the first of them when the input is a
+ *          file, and only the columns of those rows inside the region.
+ *          Each decoded pixel goes directly to its transformed place in
+ *          the output, so cropping and transforming take one pass and the
+ *          only array ever allocated is the output, the size of the
+ *          region. In particular no block of a blocked array outside the
+ *          region is ever created, let alone touched.
+ ***********************************************************************/
+
+#ifndef CROP_H
+#define CROP_H
+
+#include <stdio.h>
+#include "a2methods.h"
+#include "pnm.h"
+#include "a2view.h"
+
+Pnm_ppm Crop_load(FILE *in, const struct A2View_region *region,
+                  int rotation, A2Methods_T methods);
+
+#endif
@@ -0,0 +1,206 @@
+/***********************************************************************
+ *                              deep.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the high-depth images in deep.h. A raw row
+ *          of a 16-bit P6 is already an array of struct Deep_rgb but for
+ *          the byte order, so the reader and writer swap the bytes of a
+ *          whole row in place, eight samples at a time with SSE2 where
+ *          it is available, and copy six-byte pixels to and from the
+ *          array. Pixels are moved by transform_sample, so any methods
+ *          suite and map order works.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "assert.h"
+#include "trace.h"
+#include "transform.h"
+#include "deep.h"
+
+#define T Deep_T
+
+typedef A2Methods_UArray2 A2;
+
+struct T {
+        A2Methods_T methods;
+        int width, height;
+        unsigned maxval;
+        A2 pixels;                      /* of struct Deep_rgb */
+};
+
+static T    new_deep(A2Methods_T methods, int width, int height,
+                     unsigned maxval);
+static void swap_bytes(uint16_t *samples, size_t n);
+
+/*
+ * Deep_read
+ *    Purpose: Reads the raster of a high-depth P6
+ * Parameters: An open file at the first raster byte, the header read from
+ *             it with Ppmio_read_header, and the methods for the pixels
+ *    Returns: The image, to be freed with Deep_free
+ *    Expects: The maxval is above 255 (checked); raises Ppmio_badformat
+ *             if the raster is short
+ */
+T Deep_read(FILE *fp, const struct Ppmio_header *h, A2Methods_T methods)
+{
+        struct Deep_rgb *row;
+        T deep;
+
+        assert(fp != NULL && h != NULL && methods != NULL);
+        assert(h->maxval > 255);
+        deep = new_deep(methods, h->width, h->height, h->maxval);
+        row  = malloc(h->width * sizeof(*row));
+        assert(row != NULL);
+        for (int y = 0; y < h->height; y++) {
+                if (fread(row, sizeof(*row), h->width, fp)
+                    != (size_t)h->width) {
+                        free(row);
+                        Deep_free(&deep);
+                        RAISE(Ppmio_badformat);
+                }
+                swap_bytes(&row[0].red, 3 * (size_t)h->width);
+                for (int x = 0; x < h->width; x++) {
+                        *(struct Deep_rgb *)methods->at(deep->pixels, x, y)
+                                = row[x];
+                }
+        }
+        free(row);
+        return deep;
+}
+
+/*
+ * Deep_write
+ *    Purpose: Writes an image as a binary PPM with two-byte samples
+ * Parameters: An open file and the image
+ *    Returns: Nothing
+ *    Expects: fp and deep are nonnull (checked)
+ */
+void Deep_write(FILE *fp, T deep)
+{
+        struct Ppmio_header h;
+        struct Deep_rgb *row;
+
+        assert(fp != NULL && deep != NULL);
+        h.width  = deep->width;
+        h.height = deep->height;
+        h.maxval = deep->maxval;
+        row = malloc(h.width * sizeof(*row));
+        assert(row != NULL);
+        Ppmio_write_header(fp, &h);
+        for (int y = 0; y < h.height; y++) {
+                for (int x = 0; x < h.width; x++) {
+                        row[x] = *(struct Deep_rgb *)deep->methods->at(
+                                deep->pixels, x, y);
+                }
+                swap_bytes(&row[0].red, 3 * (size_t)h.width);
+                fwrite(row, sizeof(*row), h.width, fp);
+        }
+        free(row);
+}
+
+/*
+ * Deep_transform
+ *    Purpose: Applies a transform to an image
+ * Parameters: The image, the rotation or code, and the map function to
+ *             traverse it, which must belong to the image's methods suite
+ *    Returns: A new image, to be freed with Deep_free
+ *    Expects: deep and map are nonnull (checked); the rotation is valid
+ *             (raises invalid_parameter otherwise)
+ */
+T Deep_transform(T deep, int rotation, A2Methods_mapfun *map)
+{
+        struct transform_closure cl;
+        int swap = rotation == 90 || rotation == 270
+                   || rotation == TRANSPOSE_CODE;
+        T out;
+
+        assert(deep != NULL && map != NULL);
+        cl.amount  = rotation;
+        cl.methods = deep->methods;
+        assign_coords_calc(&cl);
+        out = new_deep(deep->methods, swap ? deep->height : deep->width,
+                       swap ? deep->width : deep->height, deep->maxval);
+        cl.output = out->pixels;
+        TRACE_BEGIN(TRACE_DETAIL, "deep");
+        map(deep->pixels, transform_sample, &cl);
+        TRACE_END(TRACE_DETAIL);
+        return out;
+}
+
+/*
+ * Deep_free
+ *    Purpose: Frees an image and sets *deep to NULL
+ */
+void Deep_free(T *deep)
+{
+        assert(deep != NULL && *deep != NULL);
+        (*deep)->methods->free(&(*deep)->pixels);
+        free(*deep);
+        *deep = NULL;
+}
+
+int Deep_width(T deep)
+{
+        assert(deep != NULL);
+        return deep->width;
+}
+
+int Deep_height(T deep)
+{
+        assert(deep != NULL);
+        return deep->height;
+}
+
+unsigned Deep_maxval(T deep)
+{
+        assert(deep != NULL);
+        return deep->maxval;
+}
+
+/* Makes an image with uninitialized pixels */
+static T new_deep(A2Methods_T methods, int width, int height,
+                  unsigned maxval)
+{
+        T deep = malloc(sizeof(*deep));
+
+        assert(deep != NULL);
+        deep->methods = methods;
+        deep->width   = width;
+        deep->height  = height;
+        deep->maxval  = maxval;
+        deep->pixels  = methods->new(width, height,
+                                     sizeof(struct Deep_rgb));
+        return deep;
+}
+
+/*
+ * swap_bytes
+ *    Purpose: Converts n samples in place between the file's big-endian
+ *             order and the host's, which on a little-endian host means
+ *             swapping the two bytes of each
+ */
+static void swap_bytes(uint16_t *samples, size_t n)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        (void)samples;
+        (void)n;
+#else
+        size_t i = 0;
+
+#ifdef __SSE2__
+        for (; i + 8 <= n; i += 8) {
+                __m128i v = _mm_loadu_si128((__m128i *)&samples[i]);
+                v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+                _mm_storeu_si128((__m128i *)&samples[i], v);
+        }
+#endif
+        for (; i < n; i++) {
+                samples[i] = samples[i] << 8 | samples[i] >> 8;
+        }
+#endif
+}
@@ -0,0 +1,42 @@
+/***********************************************************************
+ *                              deep.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: High-depth (maxval above 255) PPM images for ppmtrans. A
+ *          Deep_T holds one A2, made with any methods suite, of packed
+ *          struct Deep_rgb pixels: three uint16_t samples, six bytes a
+ *          pixel instead of the twelve of a struct Pnm_rgb. Rows go to
+ *          and from the file's big-endian samples with a bulk byte swap,
+ *          rather than a pixel at a time.
+ *
+ *          Deep_transform applies one of the ppmtrans transforms with the
+ *          coordinates calculators of transform.h.
+ ***********************************************************************/
+
+#ifndef DEEP_H
+#define DEEP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "a2methods.h"
+#include "ppmio.h"
+
+#define T Deep_T
+typedef struct T *T;
+
+struct Deep_rgb {
+        uint16_t red, green, blue;
+};
+
+extern T        Deep_read     (FILE *fp, const struct Ppmio_header *h,
+                               A2Methods_T methods);
+extern void     Deep_write    (FILE *fp, T deep);
+extern T        Deep_transform(T deep, int rotation, A2Methods_mapfun *map);
+extern void     Deep_free     (T *deep);
+
+extern int      Deep_width (T deep);
+extern int      Deep_height(T deep);
+extern unsigned Deep_maxval(T deep);
+
+#undef T
+#endif
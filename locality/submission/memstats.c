@@ -0,0 +1,122 @@
+/***********************************************************************
+ *                              memstats.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the allocation accounting in memstats.h.
+ *          Counters live in one global record guarded by a mutex. Each
+ *          phase keeps its own allocated, freed and peak counters; the
+ *          totals cover the whole run. Allocations made before the first
+ *          call to Memstats_phase are charged to a phase called "start".
+ ***********************************************************************/
+
+#include <pthread.h>
+
+#include "assert.h"
+#include "memstats.h"
+
+#define MAX_PHASES 32
+
+struct phase {
+        const char *name;
+        long allocated, freed, padding, peak;
+};
+
+static struct phase     phases[MAX_PHASES] = { { "start", 0, 0, 0, 0 } };
+static int              current   = 0;
+static long             live      = 0;
+static long             peak      = 0;
+static long             requested = 0;
+static long             padded    = 0;
+static pthread_mutex_t  lock      = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Memstats_alloc
+ *    Purpose: Records an allocation
+ * Parameters: The total bytes allocated, and how many of those are padding
+ *             that holds no element
+ *    Returns: Nothing
+ *    Expects: 0 <= padding <= bytes (checked)
+ */
+void Memstats_alloc(long bytes, long padding)
+{
+        assert(padding >= 0 && padding <= bytes);
+        pthread_mutex_lock(&lock);
+        live      += bytes;
+        requested += bytes;
+        padded    += padding;
+        phases[current].allocated += bytes;
+        phases[current].padding   += padding;
+        if (live > peak) {
+                peak = live;
+        }
+        if (live > phases[current].peak) {
+                phases[current].peak = live;
+        }
+        pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Memstats_free
+ *    Purpose: Records that an allocation recorded by Memstats_alloc has
+ *             been freed
+ * Parameters: The same number of bytes that was passed when it was
+ *             allocated
+ *    Returns: Nothing
+ */
+void Memstats_free(long bytes)
+{
+        pthread_mutex_lock(&lock);
+        live -= bytes;
+        phases[current].freed += bytes;
+        pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Memstats_phase
+ *    Purpose: Starts a new phase; later allocations and frees are charged
+ *             to it. The peak of a new phase starts at the live bytes
+ *             carried over from the previous one.
+ * Parameters: The phase name, which must outlive the report (a literal)
+ *    Returns: Nothing
+ *    Expects: No more than MAX_PHASES phases (checked)
+ */
+void Memstats_phase(const char *name)
+{
+        pthread_mutex_lock(&lock);
+        assert(current + 1 < MAX_PHASES);
+        current++;
+        phases[current].name      = name;
+        phases[current].allocated = 0;
+        phases[current].freed     = 0;
+        phases[current].padding   = 0;
+        phases[current].peak      = live;
+        pthread_mutex_unlock(&lock);
+}
+
+/*
+ * Memstats_report
+ *    Purpose: Prints a table of every phase that allocated or freed
+ *             anything, followed by the totals for the run
+ * Parameters: An open file
+ *    Returns: Nothing
+ */
+void Memstats_report(FILE *fp)
+{
+        pthread_mutex_lock(&lock);
+        fprintf(fp, "%-12s %14s %14s %14s %14s\n", "phase", "allocated",
+                "freed", "padding", "peak live");
+        for (int i = 0; i <= current; i++) {
+                struct phase *p = &phases[i];
+                if (p->allocated == 0 && p->freed == 0 && i == 0) {
+                        continue;
+                }
+                fprintf(fp, "%-12s %14ld %14ld %14ld %14ld\n", p->name,
+                        p->allocated, p->freed, p->padding, p->peak);
+        }
+        fprintf(fp, "total requested: %ld bytes\n", requested);
+        fprintf(fp, "padding: %ld bytes (%.2f%% of requested)\n",
+                padded, requested > 0 ? 100.0 * padded / requested : 0.0);
+        fprintf(fp, "peak live: %ld bytes\n", peak);
+        fprintf(fp, "still live: %ld bytes\n", live);
+        pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,34 @@
+/***********************************************************************
+ *                              memstats.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Allocation accounting for the 2D arrays. UArray2 and UArray2b
+ *          report every allocation and free here, including how many of
+ *          the bytes are padding that a blocked layout adds to round the
+ *          array up to whole blocks. A client divides its run into named
+ *          phases and can then print how many bytes each phase allocated
+ *          and freed and how high live memory climbed during it.
+ *
+ *          Usage:
+ *
+ *          Memstats_phase("read");
+ *                  ... allocate ...
+ *          Memstats_phase("transform");
+ *                  ...
+ *          Memstats_report(stderr);
+ *
+ *          Accounting is always on; it costs a locked add per array, not
+ *          per element. Safe to call from several threads.
+ ***********************************************************************/
+
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include <stdio.h>
+
+void Memstats_alloc (long bytes, long padding);
+void Memstats_free  (long bytes);
+void Memstats_phase (const char *name);
+void Memstats_report(FILE *fp);
+
+#endif
@@ -15,6 +15,7 @@
  *       * Added load_ppm
  ***********************************************************************/
 #include "openfile.h"
+#include "trace.h"
 #include <stdlib.h>
 
 /* Hanson exception for incorrect input*/
@@ -34,6 +35,7 @@ FILE *open_file(char *filename)
 {
         FILE *file;
 
+        TRACE_SCOPE(TRACE_DETAIL, "open_file");
         if (filename != NULL) {
                 file = fopen(filename, "r");
         }
@@ -49,7 +51,9 @@ FILE *open_file(char *filename)
 
 Pnm_ppm load_ppm(FILE *image_file, A2Methods_T methods)
 {
+        TRACE_BEGIN(TRACE_DETAIL, "Pnm_ppmread");
         Pnm_ppm img = Pnm_ppmread(image_file, methods);
+        TRACE_END(TRACE_DETAIL);
         if (methods->width(img->pixels) < 1 ||
             methods->height(img->pixels) < 1) {
                 RAISE(bad_input);
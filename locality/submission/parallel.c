@@ -0,0 +1,105 @@
+/***********************************************************************
+ *                              parallel.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the parallel for loop in parallel.h. With a
+ *          single worker the tasks run in the calling thread.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "assert.h"
+#include "parallel.h"
+
+struct loop {
+        int ntasks;
+        int next;                       /* next unclaimed task, atomic */
+        Parallel_task *fn;
+        void *cl;
+};
+
+struct worker {
+        struct loop *loop;
+        int number;
+};
+
+static void *run_worker(void *worker);
+
+/*
+ * Parallel_workers
+ *    Purpose: The number of workers Parallel_for uses
+ * Parameters: The number of tasks and the most threads to use
+ *    Returns: The smaller of the two
+ */
+int Parallel_workers(int ntasks, int nthreads)
+{
+        return nthreads < ntasks ? nthreads : ntasks;
+}
+
+/*
+ * Parallel_for
+ *    Purpose: Calls fn(task, worker, cl) once for every task from 0 to
+ *             ntasks - 1, on up to nthreads threads, and returns when all
+ *             the calls have
+ * Parameters: The number of tasks and of threads, the task function and
+ *             its closure
+ *    Returns: Nothing
+ *    Expects: ntasks is at least 0, nthreads at least 1 and fn nonnull
+ *             (checked). The tasks are independent of each other.
+ */
+void Parallel_for(int ntasks, int nthreads, Parallel_task *fn, void *cl)
+{
+        struct loop loop = {ntasks, 0, fn, cl};
+        int nworkers = Parallel_workers(ntasks, nthreads);
+        pthread_t *threads;
+        struct worker *workers;
+
+        assert(ntasks >= 0 && nthreads >= 1 && fn != NULL);
+        if (nworkers <= 1) {
+                for (int task = 0; task < ntasks; task++) {
+                        fn(task, 0, cl);
+                }
+                return;
+        }
+        threads = malloc(nworkers * sizeof(pthread_t));
+        workers = malloc(nworkers * sizeof(struct worker));
+        assert(threads != NULL && workers != NULL);
+        for (int i = 0; i < nworkers; i++) {
+                workers[i].loop   = &loop;
+                workers[i].number = i;
+                pthread_create(&threads[i], NULL, run_worker, &workers[i]);
+        }
+        for (int i = 0; i < nworkers; i++) {
+                pthread_join(threads[i], NULL);
+        }
+        free(threads);
+        free(workers);
+}
+
+/*
+ * Parallel_tile
+ *    Purpose: The side of the tiles to split work over an array into
+ * Parameters: The array and its methods
+ *    Returns: The array's blocksize if it is blocked, else PARALLEL_TILE
+ *    Expects: methods and array are nonnull (checked)
+ */
+int Parallel_tile(A2Methods_T methods, A2Methods_UArray2 array)
+{
+        assert(methods != NULL && array != NULL);
+        return methods->blocksize(array) > 1 ? methods->blocksize(array)
+                                             : PARALLEL_TILE;
+}
+
+/* Claims and runs tasks until none are left */
+static void *run_worker(void *worker)
+{
+        struct worker *w = worker;
+        struct loop *loop = w->loop;
+        int task;
+
+        while ((task = __sync_fetch_and_add(&loop->next, 1)) < loop->ntasks) {
+                loop->fn(task, w->number, loop->cl);
+        }
+        return NULL;
+}
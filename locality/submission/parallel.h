@@ -0,0 +1,34 @@
+/***********************************************************************
+ *                              parallel.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: A parallel for loop over independent tasks, numbered 0 to
+ *          ntasks - 1, for the tiled image operations (convolve.c,
+ *          sat.c, rotate.c) and the batch mode. Up to nthreads threads
+ *          each claim the next task with an atomic counter until none
+ *          are left, so the tasks start in order and need no lock. Each
+ *          call of the task function also gets the number of the worker
+ *          running it, below Parallel_workers, so a caller can give each
+ *          worker its own scratch buffers.
+ *
+ *          Parallel_tile is the side of the square tiles those
+ *          operations work in: the blocksize of a blocked array, whose
+ *          blocks make natural tiles, or PARALLEL_TILE for any other.
+ ***********************************************************************/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "a2methods.h"
+
+/* Side of a tile of an array that has no blocks of its own */
+#define PARALLEL_TILE 64
+
+typedef void Parallel_task(int task, int worker, void *cl);
+
+extern int  Parallel_workers(int ntasks, int nthreads);
+extern void Parallel_for    (int ntasks, int nthreads, Parallel_task *fn,
+                             void *cl);
+extern int  Parallel_tile   (A2Methods_T methods, A2Methods_UArray2 array);
+
+#endif
@@ -0,0 +1,326 @@
+/***********************************************************************
+ *                              pbm.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the packed bitonal images in pbm.h. Rows
+ *          are allocated in groups of eight, and the padding bits and
+ *          rows are kept zero, so a transpose can read whole 8x8 blocks
+ *          at the edges and a flip can shift zeros in.
+ *
+ *          Rotations are built from the three basic transforms:
+ *
+ *              rotate 90  = transpose, then horizontal flip
+ *              rotate 180 = horizontal flip, then vertical flip
+ *              rotate 270 = transpose, then vertical flip
+ *
+ *          The flips work in place on the result of the first step.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "assert.h"
+#include "ppmio.h"
+#include "trace.h"
+#include "transform.h"
+#include "pbm.h"
+
+#define T Pbm_T
+
+struct T {
+        int width, height;
+        int stride;                     /* bytes per row, a multiple of 8 */
+        int rows;                       /* height rounded up to 8 */
+        unsigned char *bits;
+};
+
+static T        new_pbm(int width, int height);
+static T        transpose_bits(T pbm);
+static void     flip_rows(T pbm);
+static void     mirror_rows(T pbm);
+static uint64_t reverse_word(uint64_t x);
+static uint64_t transpose_block(uint64_t x);
+
+static inline unsigned char *row_at(T pbm, int y)
+{
+        return pbm->bits + (size_t)y * pbm->stride;
+}
+
+/* Loads 8 bytes as a big-endian word, so the first pixel is the top bit */
+static inline uint64_t load_word(const unsigned char *p)
+{
+        uint64_t w = 0;
+
+        for (int k = 0; k < 8; k++) {
+                w = w << 8 | p[k];
+        }
+        return w;
+}
+
+static inline void store_word(unsigned char *p, uint64_t w)
+{
+        for (int k = 7; k >= 0; k--) {
+                p[k] = w & 0xff;
+                w >>= 8;
+        }
+}
+
+/*
+ * Pbm_read
+ *    Purpose: Reads a whole binary PBM
+ * Parameters: An open file
+ *    Returns: The image, to be freed with Pbm_free
+ *    Expects: fp holds a P4 image; raises Ppmio_badformat otherwise,
+ *             including for a short raster
+ */
+T Pbm_read(FILE *fp)
+{
+        struct Ppmio_header h;
+        size_t row_bytes;
+        int format;
+        T pbm;
+
+        assert(fp != NULL);
+        if (Ppmio_read_pnm_header(fp, &h, &format) != 1 || format != '4') {
+                RAISE(Ppmio_badformat);
+        }
+        pbm = new_pbm(h.width, h.height);
+        row_bytes = (h.width + 7) / 8;
+        for (int y = 0; y < h.height; y++) {
+                unsigned char *row = row_at(pbm, y);
+                if (fread(row, 1, row_bytes, fp) != row_bytes) {
+                        Pbm_free(&pbm);
+                        RAISE(Ppmio_badformat);
+                }
+                if (h.width % 8 != 0) {
+                        /* the file's padding bits need not be zero */
+                        row[row_bytes - 1] &= 0xff << (8 - h.width % 8);
+                }
+        }
+        return pbm;
+}
+
+/*
+ * Pbm_write
+ *    Purpose: Writes an image as a binary PBM
+ * Parameters: An open file and the image
+ *    Returns: Nothing
+ *    Expects: fp and pbm are nonnull (checked)
+ */
+void Pbm_write(FILE *fp, T pbm)
+{
+        assert(fp != NULL && pbm != NULL);
+        fprintf(fp, "P4\n%d %d\n", pbm->width, pbm->height);
+        for (int y = 0; y < pbm->height; y++) {
+                fwrite(row_at(pbm, y), 1, (pbm->width + 7) / 8, fp);
+        }
+}
+
+/*
+ * Pbm_transform
+ *    Purpose: Applies a transform to an image
+ * Parameters: The image and the rotation or code
+ *    Returns: A new image, to be freed with Pbm_free
+ *    Expects: pbm is nonnull (checked); the rotation is 0, 90, 180, 270
+ *             or a transform code (raises invalid_parameter otherwise)
+ */
+T Pbm_transform(T pbm, int rotation)
+{
+        T out;
+
+        assert(pbm != NULL);
+        if (rotation != 0 && rotation != 90 && rotation != 180
+            && rotation != 270 && rotation != TRANSPOSE_CODE
+            && rotation != FLIP_HOR_CODE && rotation != FLIP_VER_CODE) {
+                RAISE(invalid_parameter);
+        }
+        TRACE_BEGIN(TRACE_DETAIL, "bits");
+        if (rotation == 90 || rotation == 270
+            || rotation == TRANSPOSE_CODE) {
+                out = transpose_bits(pbm);
+        } else {
+                out = new_pbm(pbm->width, pbm->height);
+                memcpy(out->bits, pbm->bits,
+                       (size_t)pbm->rows * pbm->stride);
+        }
+        if (rotation == 90 || rotation == 180
+            || rotation == FLIP_HOR_CODE) {
+                mirror_rows(out);
+        }
+        if (rotation == 180 || rotation == 270
+            || rotation == FLIP_VER_CODE) {
+                flip_rows(out);
+        }
+        TRACE_END(TRACE_DETAIL);
+        return out;
+}
+
+/*
+ * Pbm_free
+ *    Purpose: Frees an image and sets *pbm to NULL
+ */
+void Pbm_free(T *pbm)
+{
+        assert(pbm != NULL && *pbm != NULL);
+        free((*pbm)->bits);
+        free(*pbm);
+        *pbm = NULL;
+}
+
+int Pbm_width(T pbm)
+{
+        assert(pbm != NULL);
+        return pbm->width;
+}
+
+int Pbm_height(T pbm)
+{
+        assert(pbm != NULL);
+        return pbm->height;
+}
+
+/*
+ * Pbm_get
+ *    Purpose: Reads one pixel
+ *    Returns: 1 for black, 0 for white
+ *    Expects: The coordinates are in bounds (checked)
+ */
+int Pbm_get(T pbm, int col, int row)
+{
+        assert(pbm != NULL && col >= 0 && col < pbm->width && row >= 0
+               && row < pbm->height);
+        return row_at(pbm, row)[col / 8] >> (7 - col % 8) & 1;
+}
+
+/* Makes an all-white image */
+static T new_pbm(int width, int height)
+{
+        T pbm = malloc(sizeof(*pbm));
+
+        assert(pbm != NULL);
+        pbm->width  = width;
+        pbm->height = height;
+        pbm->stride = (width + 63) / 64 * 8;
+        pbm->rows   = (height + 7) / 8 * 8;
+        pbm->bits   = calloc(pbm->rows, pbm->stride);
+        assert(pbm->bits != NULL);
+        return pbm;
+}
+
+/*
+ * transpose_bits
+ *    Purpose: Transposes an image an 8x8 block at a time: the eight bytes
+ *             of a block, one from each of eight rows, are loaded into a
+ *             word, transposed there, and stored one byte to each of
+ *             eight rows of the result
+ *    Returns: The transposed image
+ */
+static T transpose_bits(T pbm)
+{
+        T out = new_pbm(pbm->height, pbm->width);
+        int row_bytes = (pbm->width + 7) / 8;
+
+        for (int by = 0; by < pbm->rows / 8; by++) {
+                unsigned char *src = row_at(pbm, 8 * by);
+                for (int bx = 0; bx < row_bytes; bx++) {
+                        unsigned char *dst = row_at(out, 8 * bx) + by;
+                        uint64_t block = 0;
+                        for (int k = 0; k < 8; k++) {
+                                block = block << 8
+                                        | src[(size_t)k * pbm->stride + bx];
+                        }
+                        block = transpose_block(block);
+                        for (int k = 7; k >= 0; k--) {
+                                dst[(size_t)k * out->stride] = block & 0xff;
+                                block >>= 8;
+                        }
+                }
+        }
+        return out;
+}
+
+/* Flips an image top to bottom in place by swapping whole rows */
+static void flip_rows(T pbm)
+{
+        unsigned char *tmp = malloc(pbm->stride);
+
+        assert(tmp != NULL);
+        for (int top = 0, bottom = pbm->height - 1; top < bottom;
+             top++, bottom--) {
+                memcpy(tmp, row_at(pbm, top), pbm->stride);
+                memcpy(row_at(pbm, top), row_at(pbm, bottom), pbm->stride);
+                memcpy(row_at(pbm, bottom), tmp, pbm->stride);
+        }
+        free(tmp);
+}
+
+/*
+ * mirror_rows
+ *    Purpose: Flips an image left to right in place. Reversing the bits
+ *             of each word and the order of the words reverses a whole
+ *             row, padding included, which leaves the padding at the
+ *             front; shifting the row left by its width drops it again.
+ */
+static void mirror_rows(T pbm)
+{
+        int nwords = pbm->stride / 8;
+        int pad = nwords * 64 - pbm->width;
+        uint64_t *words = malloc(nwords * sizeof(*words));
+
+        assert(words != NULL);
+        for (int y = 0; y < pbm->height; y++) {
+                unsigned char *row = row_at(pbm, y);
+                for (int k = 0; k < nwords; k++) {
+                        words[k] = reverse_word(load_word(row + 8 * (nwords
+                                                                - 1 - k)));
+                }
+                for (int k = 0; k < nwords; k++) {
+                        uint64_t w = words[k];
+                        if (pad > 0) {
+                                w <<= pad;
+                                if (k + 1 < nwords) {
+                                        w |= words[k + 1] >> (64 - pad);
+                                }
+                        }
+                        store_word(row + 8 * k, w);
+                }
+        }
+        free(words);
+}
+
+/* Reverses the order of the bits of a word */
+static uint64_t reverse_word(uint64_t x)
+{
+        x = (x >> 1 & 0x5555555555555555ULL)
+            | (x & 0x5555555555555555ULL) << 1;
+        x = (x >> 2 & 0x3333333333333333ULL)
+            | (x & 0x3333333333333333ULL) << 2;
+        x = (x >> 4 & 0x0f0f0f0f0f0f0f0fULL)
+            | (x & 0x0f0f0f0f0f0f0f0fULL) << 4;
+        x = (x >> 8 & 0x00ff00ff00ff00ffULL)
+            | (x & 0x00ff00ff00ff00ffULL) << 8;
+        x = (x >> 16 & 0x0000ffff0000ffffULL)
+            | (x & 0x0000ffff0000ffffULL) << 16;
+        return x >> 32 | x << 32;
+}
+
+/*
+ * transpose_block
+ *    Purpose: Transposes an 8x8 bit matrix held in a word with row 0 in
+ *             the top byte and column 0 in the top bit of each byte, by
+ *             swapping 1x1, then 2x2, then 4x4 sub-blocks across the
+ *             diagonal (Hacker's Delight, section 7-3)
+ */
+static uint64_t transpose_block(uint64_t x)
+{
+        uint64_t t;
+
+        t = (x ^ x >> 7) & 0x00aa00aa00aa00aaULL;
+        x = x ^ t ^ t << 7;
+        t = (x ^ x >> 14) & 0x0000cccc0000ccccULL;
+        x = x ^ t ^ t << 14;
+        t = (x ^ x >> 28) & 0x00000000f0f0f0f0ULL;
+        x = x ^ t ^ t << 28;
+        return x;
+}
@@ -0,0 +1,39 @@
+/***********************************************************************
+ *                              pbm.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Bitonal (binary PBM, P4) images for ppmtrans, kept packed at
+ *          one bit per pixel, as in the file, instead of the twelve
+ *          bytes of a struct Pnm_rgb. Each row is padded to a whole
+ *          number of 64-bit words, most significant bit first, so the
+ *          transforms work a word or a byte at a time:
+ *
+ *            - a vertical flip copies whole rows;
+ *            - a horizontal flip reverses the bits of each word and the
+ *              order of the words, then shifts out the padding;
+ *            - a transpose works in 8x8 blocks, each loaded as one 64-bit
+ *              word and transposed with three rounds of masked swaps.
+ *
+ *          The rotations are compositions of these. Pbm_T is not an A2,
+ *          so the -{row,col,block}-major options do not apply to it.
+ ***********************************************************************/
+
+#ifndef PBM_H
+#define PBM_H
+
+#include <stdio.h>
+
+#define T Pbm_T
+typedef struct T *T;
+
+extern T    Pbm_read     (FILE *fp);
+extern void Pbm_write    (FILE *fp, T pbm);
+extern T    Pbm_transform(T pbm, int rotation);
+extern void Pbm_free     (T *pbm);
+
+extern int  Pbm_width (T pbm);
+extern int  Pbm_height(T pbm);
+extern int  Pbm_get   (T pbm, int col, int row);
+
+#undef T
+#endif
@@ -0,0 +1,185 @@
+/***********************************************************************
+ *                              pgm.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the grayscale images in pgm.h. Two-byte
+ *          samples are big-endian in the file, as in a P6 raster, and
+ *          native in memory.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "assert.h"
+#include "ppmio.h"
+#include "trace.h"
+#include "transform.h"
+#include "pgm.h"
+
+#define T Pgm_T
+
+typedef A2Methods_UArray2 A2;
+
+struct T {
+        A2Methods_T methods;
+        int width, height;
+        unsigned maxval;
+        int size;                       /* bytes per sample, 1 or 2 */
+        A2 pixels;
+};
+
+static T new_pgm(A2Methods_T methods, int width, int height,
+                 unsigned maxval);
+
+/*
+ * Pgm_read
+ *    Purpose: Reads a whole binary PGM
+ * Parameters: An open file and the methods for the pixel array
+ *    Returns: The image, to be freed with Pgm_free
+ *    Expects: fp holds a P5 image; raises Ppmio_badformat otherwise,
+ *             including for a short raster
+ */
+T Pgm_read(FILE *fp, A2Methods_T methods)
+{
+        struct Ppmio_header h;
+        unsigned char *row;
+        size_t row_bytes;
+        int format;
+        T pgm;
+
+        assert(fp != NULL && methods != NULL);
+        if (Ppmio_read_pnm_header(fp, &h, &format) != 1 || format != '5') {
+                RAISE(Ppmio_badformat);
+        }
+        pgm = new_pgm(methods, h.width, h.height, h.maxval);
+        row_bytes = (size_t)h.width * pgm->size;
+        row = malloc(row_bytes);
+        assert(row != NULL);
+        for (int y = 0; y < h.height; y++) {
+                if (fread(row, 1, row_bytes, fp) != row_bytes) {
+                        free(row);
+                        Pgm_free(&pgm);
+                        RAISE(Ppmio_badformat);
+                }
+                for (int x = 0; x < h.width; x++) {
+                        void *sample = methods->at(pgm->pixels, x, y);
+                        if (pgm->size == 1) {
+                                *(unsigned char *)sample = row[x];
+                        } else {
+                                *(uint16_t *)sample = row[2 * x] << 8
+                                                      | row[2 * x + 1];
+                        }
+                }
+        }
+        free(row);
+        return pgm;
+}
+
+/*
+ * Pgm_write
+ *    Purpose: Writes an image as a binary PGM
+ * Parameters: An open file and the image
+ *    Returns: Nothing
+ *    Expects: fp and pgm are nonnull (checked)
+ */
+void Pgm_write(FILE *fp, T pgm)
+{
+        A2Methods_T methods;
+        unsigned char *row;
+
+        assert(fp != NULL && pgm != NULL);
+        methods = pgm->methods;
+        row = malloc((size_t)pgm->width * pgm->size);
+        assert(row != NULL);
+        fprintf(fp, "P5\n%d %d\n%u\n", pgm->width, pgm->height,
+                pgm->maxval);
+        for (int y = 0; y < pgm->height; y++) {
+                for (int x = 0; x < pgm->width; x++) {
+                        void *sample = methods->at(pgm->pixels, x, y);
+                        if (pgm->size == 1) {
+                                row[x] = *(unsigned char *)sample;
+                        } else {
+                                uint16_t value = *(uint16_t *)sample;
+                                row[2 * x]     = value >> 8;
+                                row[2 * x + 1] = value & 0xff;
+                        }
+                }
+                fwrite(row, pgm->size, pgm->width, fp);
+        }
+        free(row);
+}
+
+/*
+ * Pgm_transform
+ *    Purpose: Applies a transform to an image
+ * Parameters: The image, the rotation or code, and the map function to
+ *             traverse it, which must belong to the image's methods suite
+ *    Returns: A new image, to be freed with Pgm_free
+ *    Expects: pgm and map are nonnull (checked); the rotation is valid
+ *             (raises invalid_parameter otherwise)
+ */
+T Pgm_transform(T pgm, int rotation, A2Methods_mapfun *map)
+{
+        struct transform_closure cl;
+        int swap = rotation == 90 || rotation == 270
+                   || rotation == TRANSPOSE_CODE;
+        T out;
+
+        assert(pgm != NULL && map != NULL);
+        cl.amount  = rotation;
+        cl.methods = pgm->methods;
+        assign_coords_calc(&cl);
+        out = new_pgm(pgm->methods, swap ? pgm->height : pgm->width,
+                      swap ? pgm->width : pgm->height, pgm->maxval);
+        cl.output = out->pixels;
+        TRACE_BEGIN(TRACE_DETAIL, "gray");
+        map(pgm->pixels, transform_sample, &cl);
+        TRACE_END(TRACE_DETAIL);
+        return out;
+}
+
+/*
+ * Pgm_free
+ *    Purpose: Frees an image and sets *pgm to NULL
+ */
+void Pgm_free(T *pgm)
+{
+        assert(pgm != NULL && *pgm != NULL);
+        (*pgm)->methods->free(&(*pgm)->pixels);
+        free(*pgm);
+        *pgm = NULL;
+}
+
+int Pgm_width(T pgm)
+{
+        assert(pgm != NULL);
+        return pgm->width;
+}
+
+int Pgm_height(T pgm)
+{
+        assert(pgm != NULL);
+        return pgm->height;
+}
+
+unsigned Pgm_maxval(T pgm)
+{
+        assert(pgm != NULL);
+        return pgm->maxval;
+}
+
+/* Makes an image with uninitialized samples */
+static T new_pgm(A2Methods_T methods, int width, int height,
+                 unsigned maxval)
+{
+        T pgm = malloc(sizeof(*pgm));
+
+        assert(pgm != NULL);
+        pgm->methods = methods;
+        pgm->width   = width;
+        pgm->height  = height;
+        pgm->maxval  = maxval;
+        pgm->size    = maxval < 256 ? 1 : 2;
+        pgm->pixels  = methods->new(width, height, pgm->size);
+        return pgm;
+}
@@ -0,0 +1,34 @@
+/***********************************************************************
+ *                              pgm.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Grayscale (binary PGM, P5) images for ppmtrans. A Pgm_T holds
+ *          one A2, made with any methods suite, of one-byte samples when
+ *          the maxval is below 256 and uint16_t samples otherwise, so a
+ *          gray image costs one or two bytes a pixel instead of the
+ *          twelve of a struct Pnm_rgb.
+ *
+ *          Pgm_transform applies one of the ppmtrans transforms with the
+ *          coordinates calculators of transform.h.
+ ***********************************************************************/
+
+#ifndef PGM_H
+#define PGM_H
+
+#include <stdio.h>
+#include "a2methods.h"
+
+#define T Pgm_T
+typedef struct T *T;
+
+extern T        Pgm_read     (FILE *fp, A2Methods_T methods);
+extern void     Pgm_write    (FILE *fp, T pgm);
+extern T        Pgm_transform(T pgm, int rotation, A2Methods_mapfun *map);
+extern void     Pgm_free     (T *pgm);
+
+extern int      Pgm_width (T pgm);
+extern int      Pgm_height(T pgm);
+extern unsigned Pgm_maxval(T pgm);
+
+#undef T
+#endif
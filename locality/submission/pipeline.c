@@ -0,0 +1,290 @@
+/***********************************************************************
+ *                              pipeline.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the read-transform-write pipeline described
+ *          in pipeline.h.
+ *
+ *          Three channels link the stages:
+ *
+ *              empty --> decoder --> full --> workers --> done --> encoder
+ *                ^                               |                    |
+ *                +-------------------------------+--------------------+
+ *
+ *          "empty" holds recycled band buffers. Workers finish bands out
+ *          of order, so the encoder parks early arrivals in a table
+ *          indexed by band number until their turn comes. Bands are
+ *          decoded strictly in order, which guarantees the band the
+ *          encoder is waiting for is always already on its way.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "assert.h"
+#include "pnm.h"
+#include "chan.h"
+#include "ppmio.h"
+#include "trace.h"
+#include "pipeline.h"
+
+struct band {
+        int seq, first_row, nrows;
+        unsigned char *in;      /* raw input rows                       */
+        unsigned char *out;     /* raw output rows, row-local mode only */
+};
+
+struct pipeline {
+        const struct Pipeline_spec *spec;
+        struct Ppmio_header in_header, out_header;
+        FILE *in, *out;
+        int nbands;
+        A2Methods_UArray2 output;   /* scatter mode only */
+        Chan_T empty, full, done;
+};
+
+static void *decode(void *pipeline);
+static void *work(void *pipeline);
+static void *encode(void *pipeline);
+static void  transform_row_local(struct pipeline *p, struct band *b);
+static void  transform_scatter(struct pipeline *p, struct band *b);
+static void  write_output(struct pipeline *p);
+
+/*
+ * Pipeline_run
+ *    Purpose: Transforms the binary PPM on in and writes the result to out
+ * Parameters: The input and output files, and the transform to apply
+ *    Returns: The number of pixels in the image
+ *    Expects: spec is nonnull with threads and band_rows at least 1
+ *             (checked). The input must be a P6 image; raises
+ *             Ppmio_badformat otherwise.
+ */
+long Pipeline_run(FILE *in, FILE *out, const struct Pipeline_spec *spec)
+{
+        struct pipeline p;
+        pthread_t decoder, encoder, *workers;
+        int nbuffers;
+        struct band *bands;
+
+        assert(spec != NULL && spec->threads >= 1 && spec->band_rows >= 1);
+        if (!Ppmio_read_header(in, &p.in_header)) {
+                RAISE(Ppmio_badformat);
+        }
+        p.spec       = spec;
+        p.in         = in;
+        p.out        = out;
+        p.out_header = p.in_header;
+        if (spec->swap_dims) {
+                p.out_header.width  = p.in_header.height;
+                p.out_header.height = p.in_header.width;
+        }
+        p.nbands = (p.in_header.height + spec->band_rows - 1)
+                   / spec->band_rows;
+        p.output = NULL;
+        if (!spec->row_local) {
+                p.output = spec->methods->new(p.out_header.width,
+                                              p.out_header.height,
+                                              sizeof(struct Pnm_rgb));
+        }
+
+        /* two bands per worker keeps every stage busy */
+        nbuffers = 2 * spec->threads + 2;
+        bands    = malloc(nbuffers * sizeof(struct band));
+        workers  = malloc(spec->threads * sizeof(pthread_t));
+        assert(bands != NULL && workers != NULL);
+        p.empty  = Chan_new(nbuffers);
+        p.full   = Chan_new(nbuffers);
+        p.done   = Chan_new(nbuffers);
+        for (int i = 0; i < nbuffers; i++) {
+                long bytes = Ppmio_row_bytes(&p.in_header) * spec->band_rows;
+                bands[i].in  = malloc(bytes);
+                bands[i].out = spec->row_local ? malloc(bytes) : NULL;
+                assert(bands[i].in != NULL);
+                assert(!spec->row_local || bands[i].out != NULL);
+                Chan_put(p.empty, &bands[i]);
+        }
+
+        Ppmio_write_header(out, &p.out_header);
+        pthread_create(&decoder, NULL, decode, &p);
+        for (int i = 0; i < spec->threads; i++) {
+                pthread_create(&workers[i], NULL, work, &p);
+        }
+        if (spec->row_local) {
+                pthread_create(&encoder, NULL, encode, &p);
+        }
+
+        pthread_join(decoder, NULL);
+        for (int i = 0; i < spec->threads; i++) {
+                pthread_join(workers[i], NULL);
+        }
+        Chan_close(p.done);
+        if (spec->row_local) {
+                pthread_join(encoder, NULL);
+        } else {
+                write_output(&p);
+                spec->methods->free(&p.output);
+        }
+
+        for (int i = 0; i < nbuffers; i++) {
+                free(bands[i].in);
+                free(bands[i].out);
+        }
+        Chan_free(&p.empty);
+        Chan_free(&p.full);
+        Chan_free(&p.done);
+        free(bands);
+        free(workers);
+        return (long)p.in_header.width * p.in_header.height;
+}
+
+/*
+ * decode
+ *    Purpose: Decoder thread. Fills empty bands with consecutive rows of
+ *             the raster and hands them to the workers, then closes the
+ *             "full" channel.
+ */
+static void *decode(void *pipeline)
+{
+        struct pipeline *p = pipeline;
+        int rows = p->spec->band_rows;
+
+        for (int seq = 0; seq < p->nbands; seq++) {
+                struct band *b = Chan_get(p->empty);
+                TRACE_SCOPE(TRACE_DETAIL, "decode band");
+                b->seq       = seq;
+                b->first_row = seq * rows;
+                b->nrows     = p->in_header.height - b->first_row < rows
+                               ? p->in_header.height - b->first_row : rows;
+                Ppmio_read_rows(p->in, &p->in_header, b->in, b->nrows);
+                Chan_put(p->full, b);
+        }
+        Chan_close(p->full);
+        return NULL;
+}
+
+/*
+ * work
+ *    Purpose: Transform worker thread. Transforms bands until the decoder
+ *             has finished, passing row-local results to the encoder and
+ *             recycling bands that were scattered into the output array.
+ */
+static void *work(void *pipeline)
+{
+        struct pipeline *p = pipeline;
+        struct band *b;
+
+        while ((b = Chan_get(p->full)) != NULL) {
+                TRACE_SCOPE(TRACE_DETAIL, "transform band");
+                if (p->spec->row_local) {
+                        transform_row_local(p, b);
+                        Chan_put(p->done, b);
+                } else {
+                        transform_scatter(p, b);
+                        Chan_put(p->empty, b);
+                }
+        }
+        return NULL;
+}
+
+/*
+ * encode
+ *    Purpose: Encoder thread for row-local transforms. Writes finished
+ *             bands in order and recycles them.
+ */
+static void *encode(void *pipeline)
+{
+        struct pipeline *p = pipeline;
+        struct band **parked = calloc(p->nbands, sizeof(struct band *));
+        struct band *b;
+        int next = 0;
+
+        assert(parked != NULL);
+        while (next < p->nbands && (b = Chan_get(p->done)) != NULL) {
+                parked[b->seq] = b;
+                while (next < p->nbands && parked[next] != NULL) {
+                        TRACE_SCOPE(TRACE_DETAIL, "encode band");
+                        b = parked[next++];
+                        Ppmio_write_rows(p->out, &p->out_header, b->out,
+                                         b->nrows);
+                        Chan_put(p->empty, b);
+                }
+        }
+        free(parked);
+        return NULL;
+}
+
+/*
+ * transform_row_local
+ *    Purpose: Builds the raw output rows of a band from its raw input rows
+ *             by moving each pixel to the column coords_calc gives it
+ *    Expects: coords_calc keeps every pixel in its own row (checked)
+ */
+static void transform_row_local(struct pipeline *p, struct band *b)
+{
+        const struct Pipeline_spec *spec = p->spec;
+        int width = p->in_header.width, height = p->in_header.height;
+        int pixel_bytes = Ppmio_row_bytes(&p->in_header) / width;
+        long row_bytes = Ppmio_row_bytes(&p->in_header);
+
+        for (int r = 0; r < b->nrows; r++) {
+                unsigned char *in  = b->in  + r * row_bytes;
+                unsigned char *out = b->out + r * row_bytes;
+                for (int c = 0; c < width; c++) {
+                        struct Coordinates to = { c, b->first_row + r };
+                        to = spec->coords_calc(height, width, spec->amount,
+                                               to);
+                        assert(to.row == b->first_row + r);
+                        memcpy(out + to.col * pixel_bytes,
+                               in + c * pixel_bytes, pixel_bytes);
+                }
+        }
+}
+
+/*
+ * transform_scatter
+ *    Purpose: Decodes each pixel of a band straight into its transformed
+ *             place in the output array. Bands never overlap in the
+ *             output, so workers need no locking.
+ */
+static void transform_scatter(struct pipeline *p, struct band *b)
+{
+        const struct Pipeline_spec *spec = p->spec;
+        int width = p->in_header.width, height = p->in_header.height;
+        long row_bytes = Ppmio_row_bytes(&p->in_header);
+
+        for (int r = 0; r < b->nrows; r++) {
+                unsigned char *in = b->in + r * row_bytes;
+                for (int c = 0; c < width; c++) {
+                        struct Coordinates to = { c, b->first_row + r };
+                        to = spec->coords_calc(height, width, spec->amount,
+                                               to);
+                        Ppmio_to_rgb(&p->in_header, in,
+                                     spec->methods->at(p->output, to.col,
+                                                       to.row), c);
+                }
+        }
+}
+
+/*
+ * write_output
+ *    Purpose: Encodes the finished output array of a scatter-mode run one
+ *             row at a time
+ */
+static void write_output(struct pipeline *p)
+{
+        const struct Pipeline_spec *spec = p->spec;
+        unsigned char *row = malloc(Ppmio_row_bytes(&p->out_header));
+
+        TRACE_SCOPE(TRACE_DETAIL, "encode output");
+        assert(row != NULL);
+        for (int r = 0; r < p->out_header.height; r++) {
+                for (int c = 0; c < p->out_header.width; c++) {
+                        Ppmio_from_rgb(&p->out_header,
+                                       spec->methods->at(p->output, c, r),
+                                       row, c);
+                }
+                Ppmio_write_rows(p->out, &p->out_header, row, 1);
+        }
+        free(row);
+}
@@ -0,0 +1,45 @@
+/***********************************************************************
+ *                              pipeline.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Interface to the pipelined form of ppmtrans, which overlaps
+ *          reading, transforming and writing a binary PPM instead of
+ *          running them one after the other.
+ *
+ *          A decoder thread reads the raster in bands of rows and passes
+ *          them through a bounded channel (chan.h) to a pool of
+ *          transform workers. For row-local transforms (where output row
+ *          r is built from input row r alone, as for a 0 degree rotation
+ *          or a horizontal flip) the workers pass finished bands on to an
+ *          encoder thread that writes them in order, so all three stages
+ *          run at once. Every other transform needs the last input row
+ *          before it can write the first output row; the workers then
+ *          scatter each band into an output A2 as it arrives, so decoding
+ *          and transforming still overlap, and the output is written
+ *          once the last band is in.
+ *
+ *          Band buffers are allocated once and recycled, so the number of
+ *          bands in flight, and the memory they use, is fixed.
+ ***********************************************************************/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+#include "a2methods.h"
+#include "coordinates.h"
+
+struct Pipeline_spec {
+        A2Methods_T methods;    /* layout of the output in scatter mode */
+        int amount;             /* passed through to coords_calc        */
+        struct Coordinates (*coords_calc)(int img_height, int img_width,
+                                          int amount, struct Coordinates c);
+        int row_local;          /* output row r depends on input row r  */
+        int swap_dims;          /* output is height wide, width high    */
+        int threads;            /* transform workers, at least 1        */
+        int band_rows;          /* rows per band, at least 1            */
+};
+
+long Pipeline_run(FILE *in, FILE *out, const struct Pipeline_spec *spec);
+
+#endif
@@ -0,0 +1,226 @@
+/***********************************************************************
+ *                              planar.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the planar images in planar.h. The
+ *          conversions visit the pixels in the order the methods suite
+ *          stores them (map_default), and Planar_transform moves samples
+ *          with transform_sample from transform.c, one plane at a time,
+ *          so each pass touches a single dense array.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "assert.h"
+#include "trace.h"
+#include "transform.h"
+#include "planar.h"
+
+#define T Planar_T
+
+typedef A2Methods_UArray2 A2;
+
+struct T {
+        A2Methods_T methods;
+        int width, height;
+        unsigned maxval;
+        int size;                       /* bytes per sample, 1 or 2 */
+        A2 planes[3];
+};
+
+static T    new_planar(A2Methods_T methods, int width, int height,
+                       unsigned maxval);
+static void split(int i, int j, A2 array, void *elem, void *cl);
+static void join(int i, int j, A2 array, void *elem, void *cl);
+
+/*
+ * Planar_from_ppm
+ *    Purpose: Splits an image into planes
+ * Parameters: The image and the methods it was read with (also used for
+ *             the planes)
+ *    Returns: The planar image, to be freed with Planar_free
+ *    Expects: pic and methods are nonnull (checked)
+ */
+T Planar_from_ppm(Pnm_ppm pic, A2Methods_T methods)
+{
+        T planar;
+
+        assert(pic != NULL && methods != NULL);
+        planar = new_planar(methods, pic->width, pic->height,
+                            pic->denominator);
+        TRACE_BEGIN(TRACE_DETAIL, "split");
+        methods->map_default(pic->pixels, split, planar);
+        TRACE_END(TRACE_DETAIL);
+        return planar;
+}
+
+/*
+ * Planar_to_ppm
+ *    Purpose: Interleaves the planes of an image back into one array of
+ *             struct Pnm_rgb
+ * Parameters: The planar image and the methods for the result
+ *    Returns: The image, to be freed with Ppmio_free
+ *    Expects: planar and methods are nonnull (checked)
+ */
+Pnm_ppm Planar_to_ppm(T planar, A2Methods_T methods)
+{
+        Pnm_ppm pic;
+
+        assert(planar != NULL && methods != NULL);
+        pic = malloc(sizeof(*pic));
+        assert(pic != NULL);
+        pic->width       = planar->width;
+        pic->height      = planar->height;
+        pic->denominator = planar->maxval;
+        pic->methods     = methods;
+        pic->pixels      = methods->new(planar->width, planar->height,
+                                        sizeof(struct Pnm_rgb));
+        TRACE_BEGIN(TRACE_DETAIL, "join");
+        methods->map_default(pic->pixels, join, planar);
+        TRACE_END(TRACE_DETAIL);
+        return pic;
+}
+
+/*
+ * Planar_transform
+ *    Purpose: Applies a transform to every plane of an image
+ * Parameters: The planar image, the rotation or code, and the map function
+ *             to traverse each plane, which must belong to the image's
+ *             methods suite
+ *    Returns: A new planar image, to be freed with Planar_free
+ *    Expects: planar and map are nonnull (checked); the rotation is valid
+ *             (raises invalid_parameter otherwise)
+ */
+T Planar_transform(T planar, int rotation, A2Methods_mapfun *map)
+{
+        struct transform_closure cl;
+        int swap = rotation == 90 || rotation == 270
+                   || rotation == TRANSPOSE_CODE;
+        T out;
+
+        assert(planar != NULL && map != NULL);
+        cl.amount  = rotation;
+        cl.methods = planar->methods;
+        assign_coords_calc(&cl);
+        out = new_planar(planar->methods,
+                         swap ? planar->height : planar->width,
+                         swap ? planar->width : planar->height,
+                         planar->maxval);
+        for (int k = 0; k < 3; k++) {
+                TRACE_BEGIN(TRACE_DETAIL, "plane");
+                cl.output = out->planes[k];
+                map(planar->planes[k], transform_sample, &cl);
+                TRACE_END(TRACE_DETAIL);
+        }
+        return out;
+}
+
+/*
+ * Planar_free
+ *    Purpose: Frees a planar image and sets *planar to NULL
+ */
+void Planar_free(T *planar)
+{
+        assert(planar != NULL && *planar != NULL);
+        for (int k = 0; k < 3; k++) {
+                (*planar)->methods->free(&(*planar)->planes[k]);
+        }
+        free(*planar);
+        *planar = NULL;
+}
+
+int Planar_width(T planar)
+{
+        assert(planar != NULL);
+        return planar->width;
+}
+
+int Planar_height(T planar)
+{
+        assert(planar != NULL);
+        return planar->height;
+}
+
+unsigned Planar_maxval(T planar)
+{
+        assert(planar != NULL);
+        return planar->maxval;
+}
+
+/*
+ * Planar_plane
+ *    Purpose: Gives access to one channel of an image
+ * Parameters: The planar image and the channel
+ *    Returns: The channel's plane, owned by the image: an A2 of the
+ *             image's methods suite whose elements are unsigned char if
+ *             the maxval is below 256 and uint16_t otherwise
+ */
+A2 Planar_plane(T planar, enum Planar_channel channel)
+{
+        assert(planar != NULL && channel >= PLANAR_RED
+               && channel <= PLANAR_BLUE);
+        return planar->planes[channel];
+}
+
+/* Makes a planar image with uninitialized planes */
+static T new_planar(A2Methods_T methods, int width, int height,
+                    unsigned maxval)
+{
+        T planar = malloc(sizeof(*planar));
+
+        assert(planar != NULL);
+        planar->methods = methods;
+        planar->width   = width;
+        planar->height  = height;
+        planar->maxval  = maxval;
+        planar->size    = maxval < 256 ? 1 : 2;
+        for (int k = 0; k < 3; k++) {
+                planar->planes[k] = methods->new(width, height,
+                                                 planar->size);
+        }
+        return planar;
+}
+
+/* Stores a sample of a plane */
+static inline void put(T planar, int k, int i, int j, unsigned value)
+{
+        void *sample = planar->methods->at(planar->planes[k], i, j);
+
+        if (planar->size == 1) {
+                *(unsigned char *)sample = value;
+        } else {
+                *(uint16_t *)sample = value;
+        }
+}
+
+/* Fetches a sample of a plane */
+static inline unsigned get(T planar, int k, int i, int j)
+{
+        void *sample = planar->methods->at(planar->planes[k], i, j);
+
+        return planar->size == 1 ? *(unsigned char *)sample
+                                 : *(uint16_t *)sample;
+}
+
+/* Apply function for Planar_from_ppm; cl is the planar image */
+static void split(int i, int j, A2 array, void *elem, void *cl)
+{
+        struct Pnm_rgb *pixel = elem;
+
+        (void) array;
+        put(cl, PLANAR_RED, i, j, pixel->red);
+        put(cl, PLANAR_GREEN, i, j, pixel->green);
+        put(cl, PLANAR_BLUE, i, j, pixel->blue);
+}
+
+/* Apply function for Planar_to_ppm; cl is the planar image */
+static void join(int i, int j, A2 array, void *elem, void *cl)
+{
+        struct Pnm_rgb *pixel = elem;
+
+        (void) array;
+        pixel->red   = get(cl, PLANAR_RED, i, j);
+        pixel->green = get(cl, PLANAR_GREEN, i, j);
+        pixel->blue  = get(cl, PLANAR_BLUE, i, j);
+}
@@ -0,0 +1,43 @@
+/***********************************************************************
+ *                              planar.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: A planar (structure of arrays) form of a PPM image. Instead of
+ *          one A2 of struct Pnm_rgb, which interleaves three unsigned ints
+ *          per pixel, a Planar_T holds three A2s, one per channel, made
+ *          with any methods suite, plain or blocked. Each sample is one
+ *          byte when the maxval is below 256 and a uint16_t otherwise, so
+ *          a channel is a dense array that per-channel code can stream
+ *          through, at a sixth or a twelfth of the interleaved size.
+ *
+ *          Planar_from_ppm and Planar_to_ppm convert to and from the
+ *          interleaved form. Planar_transform applies one of the ppmtrans
+ *          transforms to each plane in turn.
+ ***********************************************************************/
+
+#ifndef PLANAR_H
+#define PLANAR_H
+
+#include "a2methods.h"
+#include "pnm.h"
+
+#define T Planar_T
+typedef struct T *T;
+
+/* Channels, in the order of struct Pnm_rgb */
+enum Planar_channel { PLANAR_RED, PLANAR_GREEN, PLANAR_BLUE };
+
+extern T        Planar_from_ppm (Pnm_ppm pic, A2Methods_T methods);
+extern Pnm_ppm  Planar_to_ppm   (T planar, A2Methods_T methods);
+extern T        Planar_transform(T planar, int rotation,
+                                 A2Methods_mapfun *map);
+extern void     Planar_free     (T *planar);
+
+extern int      Planar_width (T planar);
+extern int      Planar_height(T planar);
+extern unsigned Planar_maxval(T planar);
+extern A2Methods_UArray2 Planar_plane(T planar,
+                                      enum Planar_channel channel);
+
+#undef T
+#endif
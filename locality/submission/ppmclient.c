@@ -0,0 +1,165 @@
+/***********************************************************************
+ *                              ppmclient.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Client for "ppmtrans -serve". Sends one request to the server
+ *          on a Unix domain socket and copies the reply to stdout: the
+ *          transformed image, or the stats for -stats. The transform
+ *          options are the same as ppmtrans's. The image is sent inline
+ *          from the named file or stdin, or with -path the server opens
+ *          the file itself. See server.h for the protocol.
+ ***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "server.h"
+
+static void usage(const char *progname);
+static int  connect_to(const char *socket_path);
+static void copy(FILE *from, FILE *to, long bytes);
+
+int main(int argc, char *argv[])
+{
+        const char *what = "rotate0", *layout = "row", *path = NULL;
+        char request[SERVER_MAX_LINE];
+        FILE *image = NULL, *server_in, *server_out;
+        int i, fd, inline_image = 0;
+        long bytes;
+
+        if (argc < 2) {
+                usage(argv[0]);
+        }
+        snprintf(request, sizeof(request), "TRANSFORM");
+        for (i = 2; i < argc; i++) {
+                if (strcmp(argv[i], "-rotate") == 0 && i + 1 < argc) {
+                        static char rotate[16];
+                        snprintf(rotate, sizeof(rotate), "rotate%s",
+                                 argv[++i]);
+                        what = rotate;
+                } else if (strcmp(argv[i], "-transpose") == 0) {
+                        what = "transpose";
+                } else if (strcmp(argv[i], "-flip") == 0 && i + 1 < argc) {
+                        i++;
+                        if (strcmp(argv[i], "horizontal") == 0) {
+                                what = "fliph";
+                        } else if (strcmp(argv[i], "vertical") == 0) {
+                                what = "flipv";
+                        } else {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-row-major") == 0) {
+                        layout = "row";
+                } else if (strcmp(argv[i], "-col-major") == 0) {
+                        layout = "col";
+                } else if (strcmp(argv[i], "-block-major") == 0) {
+                        layout = "block";
+                } else if (strcmp(argv[i], "-path") == 0 && i + 1 < argc) {
+                        path = argv[++i];
+                } else if (strcmp(argv[i], "-stats") == 0) {
+                        snprintf(request, sizeof(request), "STATS");
+                } else if (strcmp(argv[i], "-quit") == 0) {
+                        snprintf(request, sizeof(request), "QUIT");
+                } else if (*argv[i] == '-' || i != argc - 1) {
+                        usage(argv[0]);
+                } else {
+                        image = fopen(argv[i], "rb");
+                        if (image == NULL) {
+                                perror(argv[i]);
+                                exit(EXIT_FAILURE);
+                        }
+                }
+        }
+        if (strcmp(request, "TRANSFORM") == 0) {
+                inline_image = path == NULL;
+                snprintf(request, sizeof(request), "TRANSFORM %s %s %s",
+                         what, layout, inline_image ? "-" : path);
+        }
+
+        /* the server may reject a request before reading its image */
+        signal(SIGPIPE, SIG_IGN);
+        fd         = connect_to(argv[1]);
+        server_in  = fdopen(fd, "r");
+        server_out = fdopen(dup(fd), "w");
+        if (server_in == NULL || server_out == NULL) {
+                perror("fdopen");
+                exit(EXIT_FAILURE);
+        }
+        fprintf(server_out, "%s\n", request);
+        if (inline_image) {
+                copy(image != NULL ? image : stdin, server_out, -1);
+        }
+        fflush(server_out);
+        /* the one request is all there is: a short image then reaches
+         * end of file on the server instead of leaving it waiting */
+        shutdown(fd, SHUT_WR);
+
+        if (fgets(request, sizeof(request), server_in) == NULL) {
+                fprintf(stderr, "%s: no reply from server\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+        if (sscanf(request, "OK %ld", &bytes) != 1) {
+                fprintf(stderr, "%s: %s", argv[0], request);
+                exit(EXIT_FAILURE);
+        }
+        copy(server_in, stdout, bytes);
+
+        if (image != NULL) {
+                fclose(image);
+        }
+        fclose(server_out);
+        fclose(server_in);
+        return EXIT_SUCCESS;
+}
+
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s <socket> [-rotate <angle>] [-transpose] "
+                        "[-flip {horizontal,vertical}] "
+                        "[-{row,col,block}-major] "
+                        "[-path <server-side file> | filename]\n"
+                        "       %s <socket> {-stats,-quit}\n",
+                        progname, progname);
+        exit(1);
+}
+
+/* Connects to the server, exiting if it is not there */
+static int connect_to(const char *socket_path)
+{
+        struct sockaddr_un addr;
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+        if (fd < 0
+            || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+                perror(socket_path);
+                exit(EXIT_FAILURE);
+        }
+        return fd;
+}
+
+/* Copies bytes bytes, or everything up to end of file if bytes < 0 */
+static void copy(FILE *from, FILE *to, long bytes)
+{
+        char buffer[65536];
+
+        while (bytes != 0) {
+                size_t want = bytes < 0 || bytes > (long)sizeof(buffer)
+                              ? sizeof(buffer) : (size_t)bytes;
+                size_t got  = fread(buffer, 1, want, from);
+                if (got == 0) {
+                        break;
+                }
+                fwrite(buffer, 1, got, to);
+                if (bytes > 0) {
+                        bytes -= got;
+                }
+        }
+}
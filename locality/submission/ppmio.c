@@ -0,0 +1,388 @@
+/***********************************************************************
+ *                              ppmio.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the incremental P6 reader and writer in
+ *          ppmio.h. The header follows the Netpbm rules: the magic
+ *          number, width, height and maxval separated by whitespace, with
+ *          '#' comments allowed anywhere before the maxval, and then
+ *          exactly one whitespace character before the raster.
+ ***********************************************************************/
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdlib.h>
+
+#include "assert.h"
+#include "ppmio.h"
+
+Except_T Ppmio_badformat = { "Badly formatted PPM" };
+
+static int  scan_header(FILE *fp, struct Ppmio_header *h, int *format);
+static long read_number(FILE *fp);
+
+/*
+ * Ppmio_read_header
+ *    Purpose: Reads a P6 header, leaving fp at the first raster byte
+ * Parameters: An open file and the header to fill in
+ *    Returns: 1 if a header was read, 0 if fp was already at end of file
+ *             (possibly after trailing whitespace), which is how the end
+ *             of a stream of concatenated images shows up
+ *    Expects: The header is a valid P6 header with nonzero dimensions and
+ *             a maxval from 1 to 65535; raises Ppmio_badformat otherwise
+ */
+int Ppmio_read_header(FILE *fp, struct Ppmio_header *h)
+{
+        int format;
+        int status = scan_header(fp, h, &format);
+
+        if (status < 0 || (status == 1 && format != '6')) {
+                RAISE(Ppmio_badformat);
+        }
+        return status;
+}
+
+/*
+ * Ppmio_read_pnm_header
+ *    Purpose: Reads the header of any binary Netpbm image, leaving fp at
+ *             the first raster byte
+ * Parameters: An open file, the header to fill in, and where to put the
+ *             format: the digit of the magic number, '4' for PBM, '5' for
+ *             PGM or '6' for PPM
+ *    Returns: As for Ppmio_read_header. A PBM has no maxval in its header
+ *             and gets 1.
+ *    Expects: As for Ppmio_read_header
+ */
+int Ppmio_read_pnm_header(FILE *fp, struct Ppmio_header *h, int *format)
+{
+        int status = scan_header(fp, h, format);
+
+        if (status < 0) {
+                RAISE(Ppmio_badformat);
+        }
+        return status;
+}
+
+/*
+ * Ppmio_peek_format
+ *    Purpose: Looks at the magic number of the image fp is at without
+ *             consuming it, so that the caller can pick a reader
+ * Parameters: An open file, at the start of an image
+ *    Returns: The digit of the magic number ('4', '5', '6', ...), or 0 if
+ *             fp is not at a Netpbm magic number
+ *    Expects: fp can push back two characters, which C promises only for
+ *             one but glibc allows for any stream
+ */
+int Ppmio_peek_format(FILE *fp)
+{
+        int p = getc(fp), digit;
+
+        if (p == EOF) {
+                return 0;
+        }
+        digit = getc(fp);
+        if (digit != EOF) {
+                ungetc(digit, fp);
+        }
+        ungetc(p, fp);
+        return p == 'P' && isdigit(digit) ? digit : 0;
+}
+
+/*
+ * Ppmio_write_header
+ *    Purpose: Writes a P6 header in the same layout as Pnm_ppmwrite
+ */
+void Ppmio_write_header(FILE *fp, const struct Ppmio_header *h)
+{
+        fprintf(fp, "P6\n%d %d\n%u\n", h->width, h->height, h->maxval);
+}
+
+/*
+ * Ppmio_row_bytes
+ *    Purpose: The size of one raw row
+ */
+long Ppmio_row_bytes(const struct Ppmio_header *h)
+{
+        return (long)h->width * 3 * (h->maxval < 256 ? 1 : 2);
+}
+
+/*
+ * Ppmio_read_rows
+ *    Purpose: Reads the next nrows raw rows of the raster
+ * Parameters: An open file positioned inside the raster, its header, a
+ *             buffer of at least nrows * Ppmio_row_bytes bytes, and nrows
+ *    Returns: Nothing
+ *    Expects: The file holds that many more rows; raises Ppmio_badformat
+ *             if it ends early
+ */
+void Ppmio_read_rows(FILE *fp, const struct Ppmio_header *h,
+                     unsigned char *rows, int nrows)
+{
+        size_t bytes = Ppmio_row_bytes(h) * nrows;
+
+        if (fread(rows, 1, bytes, fp) != bytes) {
+                RAISE(Ppmio_badformat);
+        }
+}
+
+/*
+ * Ppmio_write_rows
+ *    Purpose: Writes nrows raw rows
+ */
+void Ppmio_write_rows(FILE *fp, const struct Ppmio_header *h,
+                      const unsigned char *rows, int nrows)
+{
+        fwrite(rows, 1, Ppmio_row_bytes(h) * nrows, fp);
+}
+
+/*
+ * Ppmio_to_rgb
+ *    Purpose: Decodes the pixel in column col of a raw row
+ * Parameters: The header, the raw row, the pixel to fill in, and col
+ *    Returns: Nothing
+ *    Expects: 0 <= col < width (unchecked)
+ */
+void Ppmio_to_rgb(const struct Ppmio_header *h, const unsigned char *raw,
+                  struct Pnm_rgb *pixel, int col)
+{
+        if (h->maxval < 256) {
+                raw += 3 * col;
+                pixel->red   = raw[0];
+                pixel->green = raw[1];
+                pixel->blue  = raw[2];
+        } else {
+                raw += 6 * col;
+                pixel->red   = (raw[0] << 8) | raw[1];
+                pixel->green = (raw[2] << 8) | raw[3];
+                pixel->blue  = (raw[4] << 8) | raw[5];
+        }
+}
+
+/*
+ * Ppmio_from_rgb
+ *    Purpose: Encodes a pixel into column col of a raw row
+ * Parameters: The header, the pixel, the raw row, and col
+ *    Returns: Nothing
+ *    Expects: 0 <= col < width and samples no larger than maxval
+ *             (unchecked)
+ */
+void Ppmio_from_rgb(const struct Ppmio_header *h, const struct Pnm_rgb *pixel,
+                    unsigned char *raw, int col)
+{
+        if (h->maxval < 256) {
+                raw += 3 * col;
+                raw[0] = pixel->red;
+                raw[1] = pixel->green;
+                raw[2] = pixel->blue;
+        } else {
+                raw += 6 * col;
+                raw[0] = pixel->red   >> 8;
+                raw[1] = pixel->red   & 0xff;
+                raw[2] = pixel->green >> 8;
+                raw[3] = pixel->green & 0xff;
+                raw[4] = pixel->blue  >> 8;
+                raw[5] = pixel->blue  & 0xff;
+        }
+}
+
+/*
+ * Ppmio_load
+ *    Purpose: Reads a whole P6 image into a new A2
+ * Parameters: An open file and the methods for the pixel array
+ *    Returns: The image, with pixels->methods set to methods; free it with
+ *             Ppmio_free
+ *    Expects: fp holds a P6 image; raises Ppmio_badformat otherwise
+ */
+Pnm_ppm Ppmio_load(FILE *fp, A2Methods_T methods)
+{
+        Pnm_ppm pic = Ppmio_try_load(fp, methods);
+
+        if (pic == NULL) {
+                RAISE(Ppmio_badformat);
+        }
+        return pic;
+}
+
+/*
+ * Ppmio_try_load
+ *    Purpose: Ppmio_load for callers that cannot catch an exception, such
+ *             as a server thread that must answer a bad request rather
+ *             than exit
+ *    Returns: The image, or NULL if fp is at end of file or does not hold
+ *             a complete P6 image
+ */
+Pnm_ppm Ppmio_try_load(FILE *fp, A2Methods_T methods)
+{
+        struct Ppmio_header h;
+
+        if (!Ppmio_try_read_header(fp, &h)) {
+                return NULL;
+        }
+        return Ppmio_try_load_raster(fp, &h, methods);
+}
+
+/*
+ * Ppmio_try_read_header
+ *    Purpose: The first half of Ppmio_try_load: Ppmio_read_header for
+ *             callers that cannot catch an exception, and that want to
+ *             look at the dimensions before anything is allocated
+ *    Returns: 1 if a P6 header was read, 0 at end of file or if the input
+ *             does not start with a valid P6 header
+ */
+int Ppmio_try_read_header(FILE *fp, struct Ppmio_header *h)
+{
+        int format;
+
+        return scan_header(fp, h, &format) == 1 && format == '6';
+}
+
+/*
+ * Ppmio_try_load_raster
+ *    Purpose: The second half of Ppmio_try_load, for a caller that has
+ *             read the header itself, with Ppmio_read_header, to look at
+ *             the maxval before picking a reader
+ * Parameters: An open file at the first raster byte, its header, and the
+ *             methods for the pixel array
+ *    Returns: The image, or NULL if the raster is short
+ */
+Pnm_ppm Ppmio_try_load_raster(FILE *fp, const struct Ppmio_header *h,
+                              A2Methods_T methods)
+{
+        Pnm_ppm pic;
+        unsigned char *row;
+        size_t row_bytes;
+
+        row_bytes = Ppmio_row_bytes(h);
+        pic = malloc(sizeof(*pic));
+        row = malloc(row_bytes);
+        assert(pic != NULL && row != NULL);
+        pic->width       = h->width;
+        pic->height      = h->height;
+        pic->denominator = h->maxval;
+        pic->methods     = methods;
+        pic->pixels      = methods->new(h->width, h->height,
+                                        sizeof(struct Pnm_rgb));
+        for (int r = 0; r < h->height; r++) {
+                if (fread(row, 1, row_bytes, fp) != row_bytes) {
+                        free(row);
+                        Ppmio_free(&pic);
+                        return NULL;
+                }
+                for (int c = 0; c < h->width; c++) {
+                        Ppmio_to_rgb(h, row, methods->at(pic->pixels, c, r),
+                                     c);
+                }
+        }
+        free(row);
+        return pic;
+}
+
+/*
+ * Ppmio_store
+ *    Purpose: Writes a whole image as P6
+ * Parameters: An open file and the image
+ *    Returns: Nothing
+ *    Expects: pixmap is nonnull with a valid pixel array (unchecked)
+ */
+void Ppmio_store(FILE *fp, Pnm_ppm pixmap)
+{
+        struct Ppmio_header h = { pixmap->width, pixmap->height,
+                                  pixmap->denominator };
+        unsigned char *row = malloc(Ppmio_row_bytes(&h));
+
+        assert(row != NULL);
+        Ppmio_write_header(fp, &h);
+        for (int r = 0; r < h.height; r++) {
+                for (int c = 0; c < h.width; c++) {
+                        Ppmio_from_rgb(&h, pixmap->methods->at(pixmap->pixels,
+                                                               c, r),
+                                       row, c);
+                }
+                Ppmio_write_rows(fp, &h, row, 1);
+        }
+        free(row);
+}
+
+/*
+ * Ppmio_free
+ *    Purpose: Frees an image from Ppmio_load and sets *pixmap to NULL
+ */
+void Ppmio_free(Pnm_ppm *pixmap)
+{
+        if (pixmap == NULL || *pixmap == NULL) {
+                return;
+        }
+        (*pixmap)->methods->free(&(*pixmap)->pixels);
+        free(*pixmap);
+        *pixmap = NULL;
+}
+
+/*
+ * scan_header
+ *    Purpose: The body of Ppmio_read_header and Ppmio_read_pnm_header
+ *    Returns: 1 if a header was read, 0 at end of file, -1 if the header
+ *             is malformed
+ */
+static int scan_header(FILE *fp, struct Ppmio_header *h, int *format)
+{
+        long width, height, maxval;
+        int c;
+
+        do {
+                c = getc(fp);
+        } while (c != EOF && isspace(c));
+        if (c == EOF) {
+                return 0;
+        }
+        if (c != 'P') {
+                return -1;
+        }
+        *format = getc(fp);
+        if (*format != '4' && *format != '5' && *format != '6') {
+                return -1;
+        }
+        width  = read_number(fp);
+        height = read_number(fp);
+        maxval = *format == '4' ? 1 : read_number(fp);
+        c = getc(fp);
+        if (!isspace(c) || width < 1 || height < 1 || width > INT_MAX
+            || height > INT_MAX || maxval < 1 || maxval > 65535) {
+                return -1;
+        }
+        h->width  = width;
+        h->height = height;
+        h->maxval = maxval;
+        return 1;
+}
+
+/*
+ * read_number
+ *    Purpose: Reads one decimal header field, skipping whitespace and
+ *             comments in front of it
+ *    Returns: The number, or -1 if there is none
+ */
+static long read_number(FILE *fp)
+{
+        long n = 0;
+        int c;
+
+        do {
+                c = getc(fp);
+                if (c == '#') {
+                        while (c != '\n' && c != EOF) {
+                                c = getc(fp);
+                        }
+                }
+        } while (c != EOF && isspace(c));
+        if (!isdigit(c)) {
+                return -1;
+        }
+        while (isdigit(c)) {
+                if (n <= INT_MAX) {
+                        n = n * 10 + (c - '0');
+                }
+                c = getc(fp);
+        }
+        ungetc(c, fp);
+        return n;
+}
@@ -0,0 +1,64 @@
+/***********************************************************************
+ *                              ppmio.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Incremental reading and writing of binary (P6) PPM images,
+ *          a few rows at a time, for the code paths that cannot wait for
+ *          Pnm_ppmread to load a whole image. Rows are kept in their raw
+ *          file form: three samples per pixel, one byte each when the
+ *          maxval is below 256 and two big-endian bytes otherwise.
+ *
+ *          Ppmio_to_rgb and Ppmio_from_rgb convert a raw row to and from
+ *          the struct Pnm_rgb pixels that the rest of ppmtrans uses.
+ *
+ *          Ppmio_load, Ppmio_store and Ppmio_free are whole-image
+ *          counterparts of Pnm_ppmread, Pnm_ppmwrite and Pnm_ppmfree built
+ *          on the row functions. Unlike the course library they keep no
+ *          state between calls, so several threads can load and store
+ *          different images at once.
+ *
+ *          Ppmio_read_pnm_header also reads PGM (P5) and PBM (P4)
+ *          headers, for the readers in pgm.h and pbm.h, and
+ *          Ppmio_peek_format tells which of those an input holds.
+ ***********************************************************************/
+
+#ifndef PPMIO_H
+#define PPMIO_H
+
+#include <stdio.h>
+#include "except.h"
+#include "pnm.h"
+#include "a2methods.h"
+
+extern Except_T Ppmio_badformat;
+
+struct Ppmio_header {
+        int width, height;
+        unsigned maxval;
+};
+
+int   Ppmio_read_header (FILE *fp, struct Ppmio_header *h);
+int   Ppmio_read_pnm_header(FILE *fp, struct Ppmio_header *h, int *format);
+int   Ppmio_peek_format (FILE *fp);
+void  Ppmio_write_header(FILE *fp, const struct Ppmio_header *h);
+long  Ppmio_row_bytes   (const struct Ppmio_header *h);
+void  Ppmio_read_rows   (FILE *fp, const struct Ppmio_header *h,
+                         unsigned char *rows, int nrows);
+void  Ppmio_write_rows  (FILE *fp, const struct Ppmio_header *h,
+                         const unsigned char *rows, int nrows);
+void  Ppmio_to_rgb      (const struct Ppmio_header *h,
+                         const unsigned char *raw, struct Pnm_rgb *pixel,
+                         int col);
+void  Ppmio_from_rgb    (const struct Ppmio_header *h,
+                         const struct Pnm_rgb *pixel, unsigned char *raw,
+                         int col);
+
+Pnm_ppm Ppmio_load    (FILE *fp, A2Methods_T methods);
+Pnm_ppm Ppmio_try_load(FILE *fp, A2Methods_T methods);
+int     Ppmio_try_read_header(FILE *fp, struct Ppmio_header *h);
+Pnm_ppm Ppmio_try_load_raster(FILE *fp, const struct Ppmio_header *h,
+                              A2Methods_T methods);
+void    Ppmio_store   (FILE *fp, Pnm_ppm pixmap);
+void    Ppmio_free    (Pnm_ppm *pixmap);
+
+#endif
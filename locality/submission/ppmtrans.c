@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 
 #include "except.h"
 #include "assert.h"
@@ -9,10 +10,34 @@
 #include "a2blocked.h"
 #include "pnm.h"
 #include "cputiming.h"
+#include "roofline.h"
+#include "trace.h"
+#include "memstats.h"
+#include "storage.h"
+#include "pipeline.h"
+#include "batch.h"
+#include "stream.h"
+#include "server.h"
+#include "a2view.h"
+#include "uarray2.h"
+#include "ppmio.h"
+#include "crop.h"
+#include "rotate.h"
+#include "scale.h"
+#include "pyramid.h"
+#include "convolve.h"
+#include "sat.h"
+#include "color.h"
+#include "planar.h"
+#include "pgm.h"
+#include "pbm.h"
+#include "deep.h"
+#include "qoi.h"
+#include "tiled.h"
+#include "a2file.h"
 
 #include "openfile.h"
-#include "coords_calcs.h"
-#include "coordinates.h"
+#include "transform.h"
 
 #define SET_METHODS(METHODS, MAP, WHAT) do {                    \
         methods = (METHODS);                                    \
@@ -28,30 +53,102 @@
 
 typedef A2Methods_UArray2 A2;
 
-static const int TRANSPOSE_CODE = 1;
-static const int FLIP_HOR_CODE = 2;
-static const int FLIP_VER_CODE = 3;
+/* Most -out options in one run */
+#define MAX_OUTPUTS 16
 
-struct transform_closure {
-        int amount;
-        A2Methods_T methods;
-        A2 output;
-        struct Coordinates (*coords_calc)(int img_height, int img_width,
-                                          int amount, struct Coordinates c);
+/* Most -box-stats options in one run */
+#define MAX_BOXES 16
+
+/* One -out option: a transform and the file its result goes to */
+struct output_spec {
+        int rotation;
+        char *path;
+};
+
+/* What a mode measured for -time: the time of its timed phase, in
+ * nanoseconds, and that time per pixel (per frame for -stream) */
+struct run_times {
+        double t[2];
+        int n;                  /* entries of t set, 0 if none */
+        double units;           /* pixels or frames t[1] is per */
+};
+
+/* What main learns of the input of the default mode, and its output */
+struct transform_io {
+        int format;                     /* from Ppmio_peek_format */
+        struct Ppmio_header header;     /* already read if format is '6' */
+        int qoi_in, tiled_in;
+        int qoi_out, tiled_out;
 };
 
-Except_T invalid_parameter = {"Invalid Parameter"};
 Except_T broken_interface  = {"Broken Interface"};
 
-void transform(int i, int j, A2 array, void *elemm, void *cl);
-A2 make_a2_out(int rotation, A2Methods_T methods, Pnm_ppm pic);
-void assign_coords_calc(struct transform_closure *cl);
+static CPUTime_T start_timer(struct run_times *times);
+static void stop_timer(CPUTime_T *timer, struct run_times *times,
+                       double units);
+int  report_times(const char *file, const double *t, int n);
+void report_bandwidth(const char *file, const char *calibration_name,
+                      double pixels, double total_time);
+int  run_transform(FILE *image, struct transform_io *io, int rotation,
+                   A2Methods_T methods, A2Methods_mapfun *map,
+                   struct run_times *times);
+void run_pipeline(FILE *image, int rotation, A2Methods_T methods,
+                  int threads, struct run_times *times);
+int  run_batch(char *list_name, char *indir, char *outdir,
+               struct Batch_spec *spec, char *time_file_name);
+void run_stream(FILE *image, struct Stream_spec *spec, struct run_times *times);
+int  run_lazy(FILE *image, int rotation, struct A2View_region *region,
+              A2Methods_T methods, struct run_times *times);
+A2   strided_view(A2 pixels, int rotation, struct A2View_region *region);
+void run_any_angle(FILE *image, double degrees, enum Rotate_filter filter,
+                   A2Methods_T methods, int threads, struct run_times *times);
+void run_scale(FILE *image, int rotation, double factor,
+               A2Methods_T methods, A2Methods_mapfun *map,
+               struct run_times *times);
+void run_planar(FILE *image, int rotation, A2Methods_T methods,
+                A2Methods_mapfun *map, struct run_times *times);
+void run_gray(FILE *image, int rotation, A2Methods_T methods,
+              A2Methods_mapfun *map, struct run_times *times);
+void run_bitonal(FILE *image, int rotation, struct run_times *times);
+void run_deep(FILE *image, const struct Ppmio_header *header, int rotation,
+              A2Methods_T methods, A2Methods_mapfun *map,
+              struct run_times *times);
+void run_color(FILE *image, int rotation, enum Color_space space,
+               A2Methods_T methods, A2Methods_mapfun *map,
+               struct run_times *times);
+int  run_box_stats(FILE *image, struct A2View_region *boxes, int nboxes,
+                   A2Methods_T methods, int threads, struct run_times *times);
+void run_convolve(FILE *image, struct Convolve_kernel *kernel,
+                  int rotation, A2Methods_T methods, A2Methods_mapfun *map,
+                  int threads, struct run_times *times);
+int  run_pyramid(FILE *image, int rotation, A2Methods_T methods,
+                 char *prefix, struct run_times *times);
+int  run_crop(FILE *image, struct A2View_region *region, int rotation,
+              A2Methods_T methods, struct run_times *times);
+int  run_fanout(FILE *image, A2Methods_T methods, A2Methods_mapfun *map,
+                struct output_spec *outputs, int noutputs,
+                struct run_times *times);
 
 static void
 usage(const char *progname)
 {
         fprintf(stderr, "Usage: %s [-rotate <angle>] "
-                        "[-{row,col,block}-major] [filename]\n",
+                        "[-filter {nearest,bilinear}] [-scale <factor>] "
+                        "[-{row,col,block}-major] "
+                        "[-out-of-core [-cache <MB>]] [-time <timing file>] "
+                        "[-bandwidth <calibration file>] "
+                        "[-trace <trace file>] [-memstats] "
+                        "[-hugepages {off,thp,hugetlb}] "
+                        "[-prefault {none,populate,touch}] "
+                        "[-pipeline] [-stream] [-lazy] [-threads <n>] "
+                        "[-batch <list file> | -batch-dir <in> <out> | "
+                        "-serve <socket>] "
+                        "[-out <transform>=<file> ...] "
+                        "[-crop <x>,<y>,<w>,<h>] [-pyramid <prefix>] "
+                        "[-convolve <kernel>] "
+                        "[-box-stats <x>,<y>,<w>,<h> ...] "
+                        "[-color {gray,ycbcr}] [-planar] [-qoi] [-tiled] "
+                        "[filename]\n",
                         progname);
         exit(1);
 }
@@ -59,10 +156,42 @@ usage(const char *progname)
 int main(int argc, char *argv[])
 {
         char *time_file_name = NULL, *img_file_name = NULL;
-        FILE *image = NULL, *timer_out = NULL;
+        char *bandwidth_file_name = NULL;
+        int   memstats       = 0;
+        int   pipelined      = 0;
+        int   streamed       = 0;
+        int   lazy           = 0;
+        int   threads        = 2;
+        char *batch_list     = NULL;
+        char *batch_in = NULL, *batch_out = NULL;
+        char *socket_path    = NULL;
+        struct output_spec outputs[MAX_OUTPUTS];
+        int   noutputs       = 0;
+        int   cropped        = 0;
+        struct A2View_region region;
+        FILE *image = NULL;
         int   rotation       = 0;
+        double degrees       = 0;
+        int   any_angle      = 0;
+        enum Rotate_filter filter = ROTATE_BILINEAR;
+        double scale         = 1;
+        char *pyramid_prefix = NULL;
+        int   convolved      = 0;
+        struct Convolve_kernel kernel;
+        struct A2View_region boxes[MAX_BOXES];
+        int   nboxes         = 0;
+        int   colored        = 0;
+        int   planar         = 0;
+        int   qoi_out        = 0;
+        int   tiled_out      = 0;
+        int   out_of_core    = 0;
+        const char *plain_order = NULL; /* -row-major or -col-major */
+        const char *transform_option = NULL;    /* -rotate, -transpose or
+                                                 * -flip */
+        enum Color_space space = COLOR_GRAY;
+        const char *modes[2];           /* the first two mode options */
+        int   nmodes         = 0;
         int   i;
-        CPUTime_T timer = NULL;
 
         /* default to UArray2 methods */
         A2Methods_T methods = uarray2_methods_plain;
@@ -80,34 +209,56 @@ int main(int argc, char *argv[])
                 if (strcmp(argv[i], "-row-major") == 0) {
                         SET_METHODS(uarray2_methods_plain, map_row_major,
                                     "row-major");
+                        plain_order = argv[i];
                 } else if (strcmp(argv[i], "-col-major") == 0) {
                         SET_METHODS(uarray2_methods_plain, map_col_major,
                                     "column-major");
+                        plain_order = argv[i];
                 } else if (strcmp(argv[i], "-block-major") == 0) {
                         SET_METHODS(uarray2_methods_blocked, map_block_major,
                                     "block-major");
+                } else if (strcmp(argv[i], "-out-of-core") == 0) {
+                        SET_METHODS(a2file_methods, map_block_major,
+                                    "block-major");
+                        out_of_core = 1;
+                } else if (strcmp(argv[i], "-cache") == 0) {
+                        if (!(i + 1 < argc)) {      /* no cache size */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        long megabytes = strtol(argv[++i], &endptr, 10);
+                        if (*endptr != '\0' || megabytes < 1) {
+                                usage(argv[0]);
+                        }
+                        A2File_set_cache(megabytes * 1024 * 1024);
                 } else if (strcmp(argv[i], "-rotate") == 0) {
                         if (!(i + 1 < argc)) {      /* no rotate value */
                                 usage(argv[0]);
                         }
+                        transform_option = argv[i];
                         char *endptr;
-                        rotation = strtol(argv[++i], &endptr, 10);
-                        if (!(rotation == 0 || rotation == 90 ||
-                            rotation == 180 || rotation == 270)) {
-                                fprintf(stderr,
-                                    "Rotation must be 0, 90, 180, or 270\n");
+                        degrees = strtod(argv[++i], &endptr);
+                        if (*endptr != '\0' || endptr == argv[i]
+                            || !isfinite(degrees)) {   /* Not a number */
                                 usage(argv[0]);
                         }
-                        if (!(*endptr == '\0')) {    /* Not a number */
-                                usage(argv[0]);
+                        /* multiples of 90 move whole pixels */
+                        any_angle = fmod(degrees, 90) != 0;
+                        if (!any_angle) {
+                                rotation = ((int)fmod(degrees, 360) + 360)
+                                           % 360;
                         }
                 } else if (strcmp(argv[i], "-transpose") == 0) {
-                        rotation = TRANSPOSE_CODE;
+                        rotation  = TRANSPOSE_CODE;
+                        any_angle = 0;
+                        transform_option = argv[i];
                 } else if (strcmp(argv[i], "-flip") == 0) {
                         if (!(i + 1 < argc)) {      /* no flip spec */
                                 usage(argv[0]);
                         }
+                        transform_option = argv[i];
                         char *flip_spec = argv[++i];
+                        any_angle = 0;
                         if (strcmp(flip_spec, "horizontal") == 0) {
                                 rotation = FLIP_HOR_CODE;
                         }
@@ -117,8 +268,179 @@ int main(int argc, char *argv[])
                         else {
                                 usage(argv[0]);
                         }
+                } else if (strcmp(argv[i], "-filter") == 0) {
+                        if (!(i + 1 < argc)) {      /* no filter name */
+                                usage(argv[0]);
+                        }
+                        char *name = argv[++i];
+                        if (strcmp(name, "nearest") == 0) {
+                                filter = ROTATE_NEAREST;
+                        } else if (strcmp(name, "bilinear") == 0) {
+                                filter = ROTATE_BILINEAR;
+                        } else {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-scale") == 0) {
+                        if (!(i + 1 < argc)) {      /* no factor */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        scale = strtod(argv[++i], &endptr);
+                        if (*endptr != '\0' || !(scale > 0 && scale <= 1)) {
+                                fprintf(stderr, "Scale factor must be more "
+                                        "than 0 and at most 1\n");
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-pyramid") == 0) {
+                        if (!(i + 1 < argc)) {      /* no prefix */
+                                usage(argv[0]);
+                        }
+                        pyramid_prefix = argv[++i];
+                } else if (strcmp(argv[i], "-convolve") == 0) {
+                        if (!(i + 1 < argc)) {      /* no kernel */
+                                usage(argv[0]);
+                        }
+                        if (!Convolve_kernel_named(argv[++i], &kernel)) {
+                                fprintf(stderr, "Unknown kernel '%s': use "
+                                        "blur, box<n>, gauss<n> (n odd, at "
+                                        "most %d), sharpen or edge\n",
+                                        argv[i], CONVOLVE_MAX_SIZE);
+                                usage(argv[0]);
+                        }
+                        convolved = 1;
+                } else if (strcmp(argv[i], "-box-stats") == 0) {
+                        struct A2View_region *box = &boxes[nboxes];
+                        char extra;
+                        if (!(i + 1 < argc) || nboxes == MAX_BOXES
+                            || sscanf(argv[++i], "%d,%d,%d,%d%c", &box->x,
+                                      &box->y, &box->width, &box->height,
+                                      &extra) != 4) {
+                                usage(argv[0]);
+                        }
+                        nboxes++;
+                } else if (strcmp(argv[i], "-color") == 0) {
+                        if (!(i + 1 < argc)) {      /* no color space */
+                                usage(argv[0]);
+                        }
+                        char *name = argv[++i];
+                        if (strcmp(name, "gray") == 0) {
+                                space = COLOR_GRAY;
+                        } else if (strcmp(name, "ycbcr") == 0) {
+                                space = COLOR_YCBCR;
+                        } else {
+                                usage(argv[0]);
+                        }
+                        colored = 1;
                 } else if (strcmp(argv[i], "-time") == 0) {
+                        if (!(i + 1 < argc)) {      /* no timing file */
+                                usage(argv[0]);
+                        }
                         time_file_name = argv[++i];
+                } else if (strcmp(argv[i], "-bandwidth") == 0) {
+                        if (!(i + 1 < argc)) {      /* no calibration file */
+                                usage(argv[0]);
+                        }
+                        bandwidth_file_name = argv[++i];
+                } else if (strcmp(argv[i], "-trace") == 0) {
+                        if (!(i + 1 < argc)) {      /* no trace file */
+                                usage(argv[0]);
+                        }
+                        Trace_open(argv[++i]);
+                } else if (strcmp(argv[i], "-memstats") == 0) {
+                        memstats = 1;
+                } else if (strcmp(argv[i], "-hugepages") == 0) {
+                        if (!(i + 1 < argc)) {      /* no policy */
+                                usage(argv[0]);
+                        }
+                        char *policy = argv[++i];
+                        if (strcmp(policy, "off") == 0) {
+                                Storage_set_policy(STORAGE_SMALL_PAGES);
+                        } else if (strcmp(policy, "thp") == 0) {
+                                Storage_set_policy(STORAGE_THP);
+                        } else if (strcmp(policy, "hugetlb") == 0) {
+                                Storage_set_policy(STORAGE_HUGETLB);
+                        } else {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-pipeline") == 0) {
+                        pipelined = 1;
+                } else if (strcmp(argv[i], "-planar") == 0) {
+                        planar = 1;
+                } else if (strcmp(argv[i], "-qoi") == 0) {
+                        qoi_out = 1;
+                } else if (strcmp(argv[i], "-tiled") == 0) {
+                        tiled_out = 1;
+                } else if (strcmp(argv[i], "-lazy") == 0) {
+                        lazy = 1;
+                } else if (strcmp(argv[i], "-stream") == 0) {
+                        streamed = 1;
+                } else if (strcmp(argv[i], "-threads") == 0) {
+                        if (!(i + 1 < argc)) {      /* no thread count */
+                                usage(argv[0]);
+                        }
+                        char *endptr;
+                        threads = strtol(argv[++i], &endptr, 10);
+                        if (*endptr != '\0' || threads < 1) {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-prefault") == 0) {
+                        if (!(i + 1 < argc)) {      /* no prefault mode */
+                                usage(argv[0]);
+                        }
+                        char *mode = argv[++i];
+                        if (strcmp(mode, "none") == 0) {
+                                Storage_set_prefault(STORAGE_NO_PREFAULT);
+                        } else if (strcmp(mode, "populate") == 0) {
+                                Storage_set_prefault(STORAGE_POPULATE);
+                        } else if (strcmp(mode, "touch") == 0) {
+                                Storage_set_prefault(STORAGE_TOUCH);
+                        } else {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "-batch") == 0) {
+                        if (!(i + 1 < argc)) {
+                                usage(argv[0]);
+                        }
+                        batch_list = argv[++i];
+                } else if (strcmp(argv[i], "-batch-dir") == 0) {
+                        if (!(i + 2 < argc)) {
+                                usage(argv[0]);
+                        }
+                        batch_in  = argv[++i];
+                        batch_out = argv[++i];
+                } else if (strcmp(argv[i], "-serve") == 0) {
+                        if (!(i + 1 < argc)) {
+                                usage(argv[0]);
+                        }
+                        socket_path = argv[++i];
+                } else if (strcmp(argv[i], "-crop") == 0) {
+                        char extra;
+                        if (!(i + 1 < argc)
+                            || sscanf(argv[++i], "%d,%d,%d,%d%c", &region.x,
+                                      &region.y, &region.width,
+                                      &region.height, &extra) != 4) {
+                                usage(argv[0]);
+                        }
+                        cropped = 1;
+                } else if (strcmp(argv[i], "-out") == 0) {
+                        char *equals;
+                        if (!(i + 1 < argc) || noutputs == MAX_OUTPUTS) {
+                                usage(argv[0]);
+                        }
+                        equals = strchr(argv[++i], '=');
+                        if (equals == NULL || equals[1] == '\0') {
+                                usage(argv[0]);
+                        }
+                        *equals = '\0';
+                        if (!transform_from_name(argv[i],
+                                                 &outputs[noutputs].rotation)) {
+                                fprintf(stderr, "Unknown transform '%s': use "
+                                        "rot0, rot90, rot180, rot270, "
+                                        "transpose, fliph or flipv\n",
+                                        argv[i]);
+                                usage(argv[0]);
+                        }
+                        outputs[noutputs++].path = equals + 1;
                 } else if (*argv[i] == '-') {
                         fprintf(stderr, "%s: unknown option '%s'\n", argv[0],
                                 argv[i]);
@@ -132,138 +454,1209 @@ int main(int argc, char *argv[])
         if (argc - i == 1) { /* if file name is on command line, get it */
                 img_file_name = argv[argc - 1];
         }
-        image = open_file(img_file_name);
-        Pnm_ppm pnm = load_ppm(image, methods);
+
+        /* each mode runs on its own; -crop is part of -lazy's view */
+        struct { int given; const char *name; } mode_options[] = {
+                {socket_path != NULL, "-serve"},
+                {batch_list != NULL, "-batch"},
+                {batch_in != NULL, "-batch-dir"},
+                {any_angle, "-rotate <angle>"},
+                {planar, "-planar"},
+                {colored, "-color"},
+                {nboxes > 0, "-box-stats"},
+                {convolved, "-convolve"},
+                {pyramid_prefix != NULL, "-pyramid"},
+                {scale < 1, "-scale"},
+                {cropped && !lazy, "-crop"},
+                {noutputs > 0, "-out"},
+                {streamed, "-stream"},
+                {lazy, "-lazy"},
+                {pipelined, "-pipeline"}
+        };
+        for (i = 0; i < (int)(sizeof(mode_options)
+                              / sizeof(mode_options[0])); i++) {
+                if (mode_options[i].given) {
+                        if (nmodes < 2) {
+                                modes[nmodes] = mode_options[i].name;
+                        }
+                        nmodes++;
+                }
+        }
+        if (nmodes > 1) {
+                fprintf(stderr, "%s: %s and %s cannot be used together\n",
+                        argv[0], modes[0], modes[1]);
+                usage(argv[0]);
+        }
+        if (noutputs > 0 && transform_option != NULL) {
+                /* each -out names its own transform */
+                fprintf(stderr, "%s: %s and -out cannot be used together\n",
+                        argv[0], transform_option);
+                usage(argv[0]);
+        }
+        if (nmodes > 0 && (qoi_out || tiled_out)) {
+                fprintf(stderr, "%s: -qoi and -tiled cannot be used with "
+                        "%s\n", argv[0], modes[0]);
+                usage(argv[0]);
+        }
+        if (out_of_core) {
+                /* a2file arrays are not safe to share between threads */
+                if (socket_path != NULL || batch_list != NULL
+                    || batch_in != NULL || pipelined || streamed) {
+                        fprintf(stderr, "%s: -out-of-core cannot be used "
+                                "with -serve, -batch, -pipeline or "
+                                "-stream\n", argv[0]);
+                        exit(1);
+                }
+                /* a2file_methods is a blocked suite */
+                if (plain_order != NULL) {
+                        fprintf(stderr, "%s: -out-of-core cannot be used "
+                                "with %s\n", argv[0], plain_order);
+                        exit(1);
+                }
+                threads = 1;
+        }
+        if (bandwidth_file_name != NULL) {
+                /* report_bandwidth models the plain map over Pnm_rgb */
+                if (time_file_name == NULL) {
+                        fprintf(stderr, "%s: -bandwidth needs -time\n",
+                                argv[0]);
+                        exit(1);
+                }
+                if (nmodes > 0) {
+                        fprintf(stderr, "%s: -bandwidth only applies to "
+                                "the plain transform\n", argv[0]);
+                        exit(1);
+                }
+        }
+        if (socket_path != NULL) {
+                /* each request names its own transform and layout */
+                return Server_run(socket_path, threads);
+        }
+
+        struct run_times times = {{0, 0}, 0, 0};
+        struct run_times *timing = time_file_name != NULL ? &times : NULL;
+        int status = EXIT_SUCCESS;
+
+        if (batch_list == NULL && batch_in == NULL) {
+                /* only the plain transform reads QOI and tiled images */
+                image = open_file(img_file_name);
+                if (nmodes > 0 && (Qoi_peek(image) || Tiled_peek(image))) {
+                        fprintf(stderr, "%s: %s needs a PPM image\n",
+                                argv[0], modes[0]);
+                        exit(1);
+                }
+        }
+        if (batch_list != NULL || batch_in != NULL) {
+                /* batch mode writes its own per-image report */
+                struct Batch_spec spec = {methods, map, rotation, threads};
+                status = run_batch(batch_list, batch_in, batch_out, &spec,
+                                   time_file_name);
+        } else if (any_angle) {
+                run_any_angle(image, degrees, filter, methods, threads,
+                              timing);
+        } else if (planar) {
+                run_planar(image, rotation, methods, map, timing);
+        } else if (colored) {
+                run_color(image, rotation, space, methods, map, timing);
+        } else if (nboxes > 0) {
+                status = run_box_stats(image, boxes, nboxes, methods,
+                                       threads, timing);
+        } else if (convolved) {
+                run_convolve(image, &kernel, rotation, methods, map,
+                             threads, timing);
+        } else if (pyramid_prefix != NULL) {
+                status = run_pyramid(image, rotation, methods,
+                                     pyramid_prefix, timing);
+        } else if (scale < 1) {
+                run_scale(image, rotation, scale, methods, map, timing);
+        } else if (cropped && !lazy) {
+                status = run_crop(image, &region, rotation, methods,
+                                  timing);
+        } else if (noutputs > 0) {
+                status = run_fanout(image, methods, map, outputs,
+                                    noutputs, timing);
+        } else if (streamed) {
+                struct Stream_spec spec = {methods, map, rotation, threads};
+                run_stream(image, &spec, timing);
+                if (image != stdin) {
+                        fclose(image);
+                }
+        } else if (lazy) {
+                status = run_lazy(image, rotation, cropped ? &region : NULL,
+                                  methods, timing);
+        } else if (pipelined) {
+                run_pipeline(image, rotation, methods, threads, timing);
+                if (image != stdin) {
+                        fclose(image);
+                }
+        } else {
+                struct transform_io io = {0, {0, 0, 0}, 0, 0,
+                                          qoi_out, tiled_out};
+                io.format   = Ppmio_peek_format(image);
+                io.qoi_in   = io.format == 0 && Qoi_peek(image);
+                io.tiled_in = io.format == 0 && Tiled_peek(image);
+                if ((qoi_out || tiled_out)
+                    && (io.format == '5' || io.format == '4')) {
+                        fprintf(stderr, "%s: -qoi and -tiled need a color "
+                                "image\n", argv[0]);
+                        exit(1);
+                }
+                if (bandwidth_file_name != NULL
+                    && (io.format == '5' || io.format == '4')) {
+                        fprintf(stderr, "%s: -bandwidth needs a color "
+                                "image\n", argv[0]);
+                        exit(1);
+                }
+                if (io.tiled_in && methods != a2file_methods) {
+                        /* the file holds a UArray2b, which only maps
+                         * block-major */
+                        SET_METHODS(uarray2_methods_blocked,
+                                    map_block_major, "block-major");
+                }
+                /* a P6 header is read here to send deep images their own
+                 * way */
+                if (io.format == '6') {
+                        Ppmio_read_header(image, &io.header);
+                        if (qoi_out && io.header.maxval != 255) {
+                                fprintf(stderr, "%s: -qoi needs a maxval of "
+                                        "255\n", argv[0]);
+                                exit(1);
+                        }
+                        if (io.header.maxval > 255 && !tiled_out
+                            && bandwidth_file_name != NULL) {
+                                fprintf(stderr, "%s: -bandwidth needs a "
+                                        "maxval of at most 255\n", argv[0]);
+                                exit(1);
+                        }
+                }
+                if (io.format == '5') {
+                        run_gray(image, rotation, methods, map, timing);
+                } else if (io.format == '4') {
+                        run_bitonal(image, rotation, timing);
+                } else if (io.format == '6' && io.header.maxval > 255
+                           && !tiled_out) {
+                        run_deep(image, &io.header, rotation, methods, map,
+                                 timing);
+                } else {
+                        status = run_transform(image, &io, rotation, methods,
+                                               map, timing);
+                }
+        }
+
+        if (times.n > 0) {
+                if (!report_times(time_file_name, times.t, times.n)) {
+                        status = EXIT_FAILURE;
+                } else if (bandwidth_file_name != NULL) {
+                        report_bandwidth(time_file_name, bandwidth_file_name,
+                                         times.units, times.t[0]);
+                }
+        }
+        if (memstats) {
+                Memstats_report(stderr);
+        }
+        return status;
+}
+
+/*
+ * run_transform
+ *    Purpose: The default mode: reads the image, maps the transform over
+ *             it into a new array, and writes the result as a PPM, or as a
+ *             QOI or tiled image if asked. With a timing file, the time of
+ *             the map is reported per pixel.
+ * Parameters: The open input (closed here), what main has learned of it
+ *             and the output format, the rotation or code, the methods and
+ *             map function, and where to put the times or NULL
+ *    Returns: EXIT_SUCCESS, or EXIT_FAILURE if -qoi was given for an image
+ *             whose maxval is not 255
+ *    Expects: A P6 input's header has been read into io->header
+ *             (unchecked); the input is an image in a format the readers
+ *             know (they raise otherwise)
+ */
+int run_transform(FILE *image, struct transform_io *io, int rotation,
+                  A2Methods_T methods, A2Methods_mapfun *map,
+                  struct run_times *times)
+{
+        CPUTime_T timer;
+        Pnm_ppm pnm;
+
+        TRACE_BEGIN(TRACE_PHASE, "read");
+        Memstats_phase("read");
+        if (io->format == '6') {
+                pnm = Ppmio_try_load_raster(image, &io->header, methods);
+                if (pnm == NULL) {
+                        RAISE(Ppmio_badformat);
+                }
+                if (image != stdin) {
+                        fclose(image);
+                }
+        } else if (io->tiled_in) {
+                pnm = methods == a2file_methods ? A2File_load_tiled(image)
+                                                : Tiled_load(image);
+                if (image != stdin) {
+                        fclose(image);
+                }
+        } else if (io->qoi_in) {
+                pnm = Qoi_read(image, methods);
+                if (image != stdin) {
+                        fclose(image);
+                }
+        } else {
+                pnm = load_ppm(image, methods);
+        }
+        TRACE_END(TRACE_PHASE);
+
+        int loaded_by_ppmio = io->format == '6' || io->qoi_in || io->tiled_in;
+        if (io->qoi_out && pnm->denominator != 255) {
+                fprintf(stderr, "-qoi needs a maxval of 255\n");
+                if (loaded_by_ppmio) {
+                        Ppmio_free(&pnm);
+                } else {
+                        Pnm_ppmfree(&pnm);
+                }
+                return EXIT_FAILURE;
+        }
+
+        TRACE_BEGIN(TRACE_PHASE, "allocate");
+        Memstats_phase("allocate");
         A2 out = make_a2_out(rotation, methods, pnm);
+        TRACE_END(TRACE_PHASE);
 
         struct transform_closure cl = {rotation, methods, out, NULL};
         assign_coords_calc(&cl);
 
-        if (time_file_name != NULL) {
-                timer = CPUTime_New();
-                timer_out = fopen(time_file_name, "w");
-                CPUTime_Start(timer);
-        }
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "transform");
+        Memstats_phase("transform");
         map(pnm->pixels, transform, &cl);
-
-        if (timer != NULL) {
-                double total_time = CPUTime_Stop(timer),
-                       time_per_p = total_time / (pnm->width * pnm->height);
-                fprintf(timer_out, "%0f\n%0f\n", total_time, time_per_p);
-                fclose(timer_out);
-                CPUTime_Free(&timer);
-        }
+        TRACE_END(TRACE_PHASE);
+        stop_timer(&timer, times, (double)pnm->width * pnm->height);
 
         struct Pnm_ppm pnmout = {methods->width(cl.output),
                                  methods->height(cl.output),
                                  pnm->denominator, cl.output, methods};
+        TRACE_BEGIN(TRACE_PHASE, "write");
+        Memstats_phase("write");
+        if (io->tiled_out) {
+                Tiled_write(stdout, &pnmout);
+        } else if (io->qoi_out) {
+                Qoi_write(stdout, &pnmout);
+        } else {
+                Pnm_ppmwrite(stdout, &pnmout);
+        }
+        TRACE_END(TRACE_PHASE);
+
+        TRACE_BEGIN(TRACE_PHASE, "free");
+        Memstats_phase("free");
+        if (loaded_by_ppmio) {
+                Ppmio_free(&pnm);
+        } else {
+                Pnm_ppmfree(&pnm);
+        }
+        methods->free(&out);
+        TRACE_END(TRACE_PHASE);
+        return EXIT_SUCCESS;
+}
+
+/*
+ * start_timer
+ *    Purpose: Starts timing a mode's timed phase, if there is a timing file
+ * Parameters: Where the mode's times go, or NULL for no timing
+ *    Returns: A running timer for stop_timer, or NULL if times is NULL
+ */
+static CPUTime_T start_timer(struct run_times *times)
+{
+        CPUTime_T timer;
+
+        if (times == NULL) {
+                return NULL;
+        }
+        timer = CPUTime_New();
+        CPUTime_Start(timer);
+        return timer;
+}
+
+/*
+ * stop_timer
+ *    Purpose: Stops and frees a timer from start_timer, if any, and records
+ *             the time and the time per unit
+ * Parameters: The timer, the times it goes in, and the number of units
+ *             (pixels, or frames) the time is divided by; with no units the
+ *             time per unit is 0
+ *    Returns: Nothing
+ */
+static void stop_timer(CPUTime_T *timer, struct run_times *times,
+                       double units)
+{
+        if (*timer == NULL) {
+                return;
+        }
+        times->t[0]  = CPUTime_Stop(*timer);
+        times->t[1]  = units > 0 ? times->t[0] / units : 0.0;
+        times->n     = 2;
+        times->units = units;
+        CPUTime_Free(timer);
+}
+
+/*
+ * report_times
+ *    Purpose: Writes the -time output: one time in nanoseconds per line
+ * Parameters: The timing file name, the times, and how many there are
+ *    Returns: 1 if the file was written, 0 (after a message on stderr) if
+ *             it could not be opened
+ */
+int report_times(const char *file, const double *t, int n)
+{
+        FILE *out = fopen(file, "w");
+
+        if (out == NULL) {
+                perror(file);
+                return 0;
+        }
+        for (int k = 0; k < n; k++) {
+                fprintf(out, "%0f\n", t[k]);
+        }
+        fclose(out);
+        return 1;
+}
+
+/*
+ * report_bandwidth
+ *    Purpose: Appends to the timing output the memory bandwidth the
+ *             transform achieved and how close that came to the ceilings
+ *             measured by timing_test -o. Every pixel is read once from the
+ *             source and written once to the destination.
+ * Parameters: The timing file name (written by report_times), the
+ *             calibration file name, the number of pixels, and the time
+ *             the map took in nanoseconds
+ *    Returns: Nothing
+ *    Expects: file and calibration_name are nonnull (unchecked). A
+ *             calibration file that cannot be read is reported on stderr
+ *             and otherwise ignored.
+ */
+void report_bandwidth(const char *file, const char *calibration_name,
+                      double pixels, double total_time)
+{
+        struct Roofline roofline;
+        double bytes = 2.0 * pixels * sizeof(struct Pnm_rgb);
+        FILE *out;
+
+        if (Roofline_load(calibration_name, &roofline) <= 0) {
+                fprintf(stderr, "Could not read calibration file %s\n",
+                        calibration_name);
+                return;
+        }
+        out = fopen(file, "a");
+        if (out == NULL) {
+                perror(file);
+                return;
+        }
+        Roofline_report(out, &roofline, bytes, total_time);
+        fclose(out);
+}
+
+/*
+ * run_pipeline
+ *    Purpose: Transforms the image with the overlapping decode, transform
+ *             and encode threads of pipeline.h instead of the phases in
+ *             main. With a timing file, the CPU time of the whole pipeline
+ *             (all threads, including the I/O) is written in place of the
+ *             map time, with that time per pixel.
+ * Parameters: The open input, the rotation or code, the methods for the output
+ *             array, the number of transform threads, and where to put the
+ *             times or NULL
+ *    Returns: Nothing
+ *    Expects: The input is a binary PPM (raises Ppmio_badformat otherwise)
+ */
+void run_pipeline(FILE *image, int rotation, A2Methods_T methods,
+                  int threads, struct run_times *times)
+{
+        struct transform_closure cl = {rotation, methods, NULL, NULL};
+        struct Pipeline_spec spec;
+        CPUTime_T timer = NULL;
+        long pixels;
+
+        assign_coords_calc(&cl);
+        spec.methods     = methods;
+        spec.amount      = rotation;
+        spec.coords_calc = cl.coords_calc;
+        spec.row_local   = rotation == 0 || rotation == FLIP_HOR_CODE;
+        spec.swap_dims   = rotation == 90 || rotation == 270
+                           || rotation == TRANSPOSE_CODE;
+        spec.threads     = threads;
+        spec.band_rows   = 16;
+
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "pipeline");
+        Memstats_phase("pipeline");
+        pixels = Pipeline_run(image, stdout, &spec);
+        TRACE_END(TRACE_PHASE);
+
+        stop_timer(&timer, times, pixels);
+}
+
+/*
+ * run_lazy
+ *    Purpose: Handles -lazy: writes the transformed image straight from
+ *             the source array through a view, so no output array is ever
+ *             allocated. A plain source gets a strided UArray2 view, whose
+ *             at is plain pointer arithmetic; a blocked one gets an
+ *             a2view.h view. With -crop the view covers only the region,
+ *             so the crop costs nothing either. The transform happens
+ *             inside the write, so with a timing file the time of the
+ *             write is reported in place of the map time.
+ * Parameters: The open input (closed here), the rotation or code, the
+ *             crop region or NULL for the whole image, the methods to
+ *             read with, and where to put the times or NULL
+ *    Returns: EXIT_SUCCESS, or EXIT_FAILURE if the region does not lie
+ *             inside the image
+ */
+int run_lazy(FILE *image, int rotation, struct A2View_region *region,
+             A2Methods_T methods, struct run_times *times)
+{
+        CPUTime_T timer = NULL;
+
+        TRACE_BEGIN(TRACE_PHASE, "read");
+        Memstats_phase("read");
+        Pnm_ppm pnm = load_ppm(image, methods);
+        TRACE_END(TRACE_PHASE);
+
+        if (region != NULL
+            && !A2View_inside(region, pnm->width, pnm->height)) {
+                fprintf(stderr, "Crop region %d,%d,%d,%d is not inside the "
+                        "image\n", region->x, region->y, region->width,
+                        region->height);
+                Pnm_ppmfree(&pnm);
+                return EXIT_FAILURE;
+        }
+
+        A2Methods_T view_methods = a2view_methods;
+        A2 view;
+        if (methods == uarray2_methods_plain) {
+                view_methods = uarray2_methods_plain;
+                view = strided_view(pnm->pixels, rotation, region);
+        } else {
+                view = A2View_new(methods, pnm->pixels, rotation, region);
+        }
+        struct Pnm_ppm pnmout = {view_methods->width(view),
+                                 view_methods->height(view),
+                                 pnm->denominator, view, view_methods};
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "write");
+        Memstats_phase("write");
         Pnm_ppmwrite(stdout, &pnmout);
+        TRACE_END(TRACE_PHASE);
+        stop_timer(&timer, times, (double)pnmout.width * pnmout.height);
 
+        TRACE_BEGIN(TRACE_PHASE, "free");
+        Memstats_phase("free");
+        view_methods->free(&view);
+        Pnm_ppmfree(&pnm);
+        TRACE_END(TRACE_PHASE);
+        return EXIT_SUCCESS;
+}
+
+/*
+ * strided_view
+ *    Purpose: Makes the transformed view of a plain array that run_lazy
+ *             writes from, with the UArray2 view functions: the crop
+ *             first, in the array's own coordinates, then the transform
+ * Parameters: The array, the rotation or code, and the crop region or
+ *             NULL for the whole array
+ *    Returns: A UArray2_T sharing the array's elements
+ *    Expects: The rotation or code is valid and the region lies inside
+ *             the array (both checked)
+ */
+A2 strided_view(A2 pixels, int rotation, struct A2View_region *region)
+{
+        UArray2_T crop = NULL;
+        A2 view;
+
+        if (region != NULL) {
+                crop = UArray2_crop(pixels, region->x, region->y,
+                                    region->width, region->height);
+                pixels = crop;
+        }
+        switch (rotation) {
+        case TRANSPOSE_CODE:
+                view = UArray2_transpose(pixels);
+                break;
+        case FLIP_HOR_CODE:
+                view = UArray2_flip_horizontal(pixels);
+                break;
+        case FLIP_VER_CODE:
+                view = UArray2_flip_vertical(pixels);
+                break;
+        default:
+                view = UArray2_rotate(pixels, rotation);
+                break;
+        }
+        UArray2_free(&crop);
+        return view;
+}
+
+/*
+ * run_any_angle
+ *    Purpose: Handles -rotate by an angle that is not a multiple of 90,
+ *             with Rotate_image. With a timing file, the time of the
+ *             rotation is reported per output pixel.
+ * Parameters: The open input (closed here), the angle, the filter, the methods
+ *             for both arrays, the number of threads, and where to put the
+ *             times or NULL
+ *    Returns: Nothing
+ *    Expects: The input is a PPM (load_ppm raises otherwise)
+ */
+void run_any_angle(FILE *image, double degrees, enum Rotate_filter filter,
+                   A2Methods_T methods, int threads, struct run_times *times)
+{
+        struct Rotate_spec spec = {degrees, filter, threads, 0};
+        CPUTime_T timer = NULL;
+
+        TRACE_BEGIN(TRACE_PHASE, "read");
+        Memstats_phase("read");
+        Pnm_ppm pnm = load_ppm(image, methods);
+        TRACE_END(TRACE_PHASE);
+
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "transform");
+        Memstats_phase("transform");
+        A2 out = Rotate_image(pnm, methods, &spec);
+        TRACE_END(TRACE_PHASE);
+
+        struct Pnm_ppm pnmout = {methods->width(out), methods->height(out),
+                                 pnm->denominator, out, methods};
+        stop_timer(&timer, times, (double)pnmout.width * pnmout.height);
+
+        TRACE_BEGIN(TRACE_PHASE, "write");
+        Memstats_phase("write");
+        Pnm_ppmwrite(stdout, &pnmout);
+        TRACE_END(TRACE_PHASE);
         Pnm_ppmfree(&pnm);
         methods->free(&out);
+}
 
-        return EXIT_SUCCESS;
+/*
+ * run_scale
+ *    Purpose: Handles -scale: transforms the image and scales it down in
+ *             one traversal with Scale_transform. With a timing file, the
+ *             time of that traversal is reported per source pixel, as for
+ *             the plain transform.
+ * Parameters: The open input (closed here), the rotation or code, the
+ *             factor, the methods and map function, and where to put the
+ *             times or NULL
+ *    Returns: Nothing
+ *    Expects: The input is a PPM (load_ppm raises otherwise)
+ */
+void run_scale(FILE *image, int rotation, double factor,
+               A2Methods_T methods, A2Methods_mapfun *map,
+               struct run_times *times)
+{
+        CPUTime_T timer = NULL;
+
+        TRACE_BEGIN(TRACE_PHASE, "read");
+        Memstats_phase("read");
+        Pnm_ppm pnm = load_ppm(image, methods);
+        TRACE_END(TRACE_PHASE);
+
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "transform");
+        Memstats_phase("transform");
+        A2 out = Scale_transform(pnm, rotation, factor, methods, map);
+        TRACE_END(TRACE_PHASE);
+        stop_timer(&timer, times, (double)pnm->width * pnm->height);
+
+        struct Pnm_ppm pnmout = {methods->width(out), methods->height(out),
+                                 pnm->denominator, out, methods};
+        TRACE_BEGIN(TRACE_PHASE, "write");
+        Memstats_phase("write");
+        Pnm_ppmwrite(stdout, &pnmout);
+        TRACE_END(TRACE_PHASE);
+        Pnm_ppmfree(&pnm);
+        methods->free(&out);
+}
+
+/*
+ * run_planar
+ *    Purpose: Handles -planar: splits the image into one plane per
+ *             channel, transforms each plane, and interleaves the result
+ *             again to write it. With a timing file, the time of the
+ *             transform alone is reported per pixel.
+ * Parameters: The open input (closed here), the rotation or code, the
+ *             methods and map function, and where to put the times or NULL
+ *    Returns: Nothing
+ *    Expects: The input is a PPM (load_ppm raises otherwise)
+ */
+void run_planar(FILE *image, int rotation, A2Methods_T methods,
+                A2Methods_mapfun *map, struct run_times *times)
+{
+        CPUTime_T timer = NULL;
+
+        TRACE_BEGIN(TRACE_PHASE, "read");
+        Memstats_phase("read");
+        Pnm_ppm pnm = load_ppm(image, methods);
+        Planar_T planes = Planar_from_ppm(pnm, methods);
+        Pnm_ppmfree(&pnm);
+        TRACE_END(TRACE_PHASE);
+
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "transform");
+        Memstats_phase("transform");
+        Planar_T out = Planar_transform(planes, rotation, map);
+        TRACE_END(TRACE_PHASE);
+        stop_timer(&timer, times,
+                   (double)Planar_width(out) * Planar_height(out));
+        Planar_free(&planes);
+
+        TRACE_BEGIN(TRACE_PHASE, "write");
+        Memstats_phase("write");
+        pnm = Planar_to_ppm(out, methods);
+        Pnm_ppmwrite(stdout, pnm);
+        TRACE_END(TRACE_PHASE);
+        Ppmio_free(&pnm);
+        Planar_free(&out);
 }
 
 /*
- * transform
- *    Purpose: Meant to be passed into a map function. Copies the given
- *             pixel into the appropriate place in the output array
- * Parameters: int i and j for the col and row coordinates; an A2 object; a
- *             void pointer to a pixel in the existing photo; and a void
- *             pointer to the closure argument
+ * run_gray
+ *    Purpose: Transforms a PGM input, which main hands here instead of
+ *             reading it as a PPM, at one or two bytes a pixel, and writes
+ *             the result as a PGM. With a timing file, the time of the
+ *             transform is reported per pixel, as for a PPM.
+ * Parameters: The open input (closed here), the rotation or code, the
+ *             methods and map function, and where to put the times or NULL
  *    Returns: Nothing
- *    Expects: That the A2 is valid and the coordinates are in bounds
- *             (checked), that the void *elem points to a valid Pnm_rgb struct
- *             (unchecked), that the void *elem is nonnull (checked), that
- *             the void *cl is nonnull (checked), and that the void *cl
- *             points to a valid transform_closure struct (unchecked)
+ *    Expects: The input is a binary PGM (raises Ppmio_badformat otherwise)
  */
-void transform(int i, int j, A2 array, void *elem, void *cl) {
-        struct transform_closure *closure = cl;
-        struct Coordinates new_coords = {i, j};
-        struct Pnm_rgb *pixel = elem, *at_p;
-        if (array == NULL || closure == NULL) {
-                RAISE(invalid_parameter);
+void run_gray(FILE *image, int rotation, A2Methods_T methods,
+              A2Methods_mapfun *map, struct run_times *times)
+{
+        CPUTime_T timer = NULL;
+
+        TRACE_BEGIN(TRACE_PHASE, "read");
+        Memstats_phase("read");
+        Pgm_T pgm = Pgm_read(image, methods);
+        if (image != stdin) {
+                fclose(image);
         }
-        if (i < 0 || i >= closure->methods->width(array) ||
-            j < 0 || j >= closure->methods->height(array)) {
-                    RAISE(invalid_parameter);
+        TRACE_END(TRACE_PHASE);
+
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "transform");
+        Memstats_phase("transform");
+        Pgm_T out = Pgm_transform(pgm, rotation, map);
+        TRACE_END(TRACE_PHASE);
+        stop_timer(&timer, times, (double)Pgm_width(pgm) * Pgm_height(pgm));
+        Pgm_free(&pgm);
+
+        TRACE_BEGIN(TRACE_PHASE, "write");
+        Memstats_phase("write");
+        Pgm_write(stdout, out);
+        TRACE_END(TRACE_PHASE);
+        Pgm_free(&out);
+}
+
+/*
+ * run_bitonal
+ *    Purpose: Transforms a PBM input, which main hands here instead of
+ *             reading it as a PPM, packed at one bit a pixel, and writes
+ *             the result as a PBM. The map order options do not apply.
+ *             With a timing file, the time of the transform is reported
+ *             per pixel, as for a PPM.
+ * Parameters: The open input (closed here), the rotation or code, and where
+ *             to put the times or NULL
+ *    Returns: Nothing
+ *    Expects: The input is a binary PBM (raises Ppmio_badformat otherwise)
+ */
+void run_bitonal(FILE *image, int rotation, struct run_times *times)
+{
+        CPUTime_T timer = NULL;
+
+        TRACE_BEGIN(TRACE_PHASE, "read");
+        Memstats_phase("read");
+        Pbm_T pbm = Pbm_read(image);
+        if (image != stdin) {
+                fclose(image);
         }
+        TRACE_END(TRACE_PHASE);
 
-        new_coords = closure->coords_calc(closure->methods->height(array),
-                             closure->methods->width(array), closure->amount,
-                             new_coords);
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "transform");
+        Memstats_phase("transform");
+        Pbm_T out = Pbm_transform(pbm, rotation);
+        TRACE_END(TRACE_PHASE);
+        stop_timer(&timer, times, (double)Pbm_width(pbm) * Pbm_height(pbm));
+        Pbm_free(&pbm);
 
-        at_p = closure->methods->at(closure->output, new_coords.col,
-                                    new_coords.row);
-        if (pixel == NULL || at_p == NULL) {
-                RAISE(invalid_parameter);
+        TRACE_BEGIN(TRACE_PHASE, "write");
+        Memstats_phase("write");
+        Pbm_write(stdout, out);
+        TRACE_END(TRACE_PHASE);
+        Pbm_free(&out);
+}
+
+/*
+ * run_deep
+ *    Purpose: Transforms a P6 input with a maxval above 255, which main
+ *             hands here once it has read the header, in packed six-byte
+ *             pixels, and writes the result with the same maxval. With a
+ *             timing file, the time of the transform is reported per
+ *             pixel, as for any other PPM.
+ * Parameters: The open input (closed here) at its first raster byte, its
+ *             header, the rotation or code, the methods and map function,
+ *             and where to put the times or NULL
+ *    Returns: Nothing
+ *    Expects: The raster is complete (raises Ppmio_badformat otherwise)
+ */
+void run_deep(FILE *image, const struct Ppmio_header *header, int rotation,
+              A2Methods_T methods, A2Methods_mapfun *map,
+              struct run_times *times)
+{
+        CPUTime_T timer = NULL;
+
+        TRACE_BEGIN(TRACE_PHASE, "read");
+        Memstats_phase("read");
+        Deep_T deep = Deep_read(image, header, methods);
+        if (image != stdin) {
+                fclose(image);
         }
-        *at_p = *pixel;
-        return;
+        TRACE_END(TRACE_PHASE);
+
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "transform");
+        Memstats_phase("transform");
+        Deep_T out = Deep_transform(deep, rotation, map);
+        TRACE_END(TRACE_PHASE);
+        stop_timer(&timer, times,
+                   (double)Deep_width(deep) * Deep_height(deep));
+        Deep_free(&deep);
+
+        TRACE_BEGIN(TRACE_PHASE, "write");
+        Memstats_phase("write");
+        Deep_write(stdout, out);
+        TRACE_END(TRACE_PHASE);
+        Deep_free(&out);
 }
 
 /*
- * make_a2_out
- *    Purpose: Creates a new A2 object based on the type of transformation it
- *             is given. For rotations in the first if statement, these
- *             transformations are marked by keeping the width and height the
- *             same in the new A2 object. For the rest of the rotations, the
- *             width and height parameters must be switched.
- * Parameters: int rotation, A2Methods_T object, Pnm_ppm object
- *    Returns: A new A2 object with the new dimensions after the image has
- *             been transformed.
- *    Expects: int rotation must be a valid degree or code (checked),
- *             A2Methods_T object cannot be NULL (checked),
- *             and Pnm_ppm object also cannot be NULL (checked)
+ * run_color
+ *    Purpose: Handles -color: transforms the image and converts it to
+ *             gray or YCbCr in one traversal with Color_transform, then
+ *             writes each plane to stdout as a binary PGM (Y, then Cb and
+ *             Cr for YCbCr). With a timing file, the time of that
+ *             traversal is reported per pixel.
+ * Parameters: The open input (closed here), the rotation or code, the color
+ *             space, the methods and map function, and where to put the
+ *             times or NULL
+ *    Returns: Nothing
+ *    Expects: The input is a PPM (load_ppm raises otherwise)
  */
-A2 make_a2_out(int rotation, A2Methods_T methods, Pnm_ppm pic)
+void run_color(FILE *image, int rotation, enum Color_space space,
+               A2Methods_T methods, A2Methods_mapfun *map,
+               struct run_times *times)
 {
-        if (methods == NULL || pic == NULL) {
-                RAISE(invalid_parameter);
-        }
-        A2 result;
-        if (rotation % 180 == 0 || rotation == 0 ||
-            rotation == FLIP_HOR_CODE || rotation == FLIP_VER_CODE ) {
-                result = methods->new(pic->width, pic->height, sizeof(struct
-                                      Pnm_rgb));
-        }
-        else if (rotation % 90 == 0 || rotation == TRANSPOSE_CODE) {
-                result = methods->new(pic->height, pic->width,
-                                      sizeof(struct Pnm_rgb));
-        } else {
-                RAISE(invalid_parameter);
+        CPUTime_T timer = NULL;
+        A2 planes[COLOR_MAX_PLANES];
+
+        TRACE_BEGIN(TRACE_PHASE, "read");
+        Memstats_phase("read");
+        Pnm_ppm pnm = load_ppm(image, methods);
+        TRACE_END(TRACE_PHASE);
+
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "transform");
+        Memstats_phase("transform");
+        int nplanes = Color_transform(pnm, rotation, space, methods, map,
+                                      planes);
+        TRACE_END(TRACE_PHASE);
+        stop_timer(&timer, times, (double)pnm->width * pnm->height);
+
+        TRACE_BEGIN(TRACE_PHASE, "write");
+        Memstats_phase("write");
+        for (int k = 0; k < nplanes; k++) {
+                Color_write_plane(stdout, methods, planes[k]);
+                methods->free(&planes[k]);
         }
-        return result;
+        TRACE_END(TRACE_PHASE);
+        Pnm_ppmfree(&pnm);
 }
 
 /*
- * assign_coords_calc
- *    Purpose: Handles the rotation. Calls the appropriate rotation method
- *             based on the degrees it gets passed in or the code passed in
- * Parameters: Closure argument; in this case, a pointer to a struct
+ * run_box_stats
+ *    Purpose: Handles -box-stats: prints, instead of an image, the sums and
+ *             means of each channel over each rectangle, one line per
+ *             rectangle, from a summed-area table of the image. With a
+ *             timing file, the time to build the table is reported per
+ *             pixel.
+ * Parameters: The open input (closed here), the rectangles and their number,
+ *             the methods for the table, the number of threads, and where to
+ *             put the times or NULL
+ *    Returns: EXIT_SUCCESS, or EXIT_FAILURE if a rectangle does not lie
+ *             inside the image (the others are still printed)
+ *    Expects: The input is a PPM (load_ppm raises otherwise)
+ */
+int run_box_stats(FILE *image, struct A2View_region *boxes, int nboxes,
+                  A2Methods_T methods, int threads, struct run_times *times)
+{
+        CPUTime_T timer = NULL;
+        int status = EXIT_SUCCESS;
+
+        TRACE_BEGIN(TRACE_PHASE, "read");
+        Memstats_phase("read");
+        Pnm_ppm pnm = load_ppm(image, methods);
+        TRACE_END(TRACE_PHASE);
+
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "sat");
+        Memstats_phase("sat");
+        Sat_T sat = Sat_new(pnm, methods, threads);
+        TRACE_END(TRACE_PHASE);
+        stop_timer(&timer, times, (double)pnm->width * pnm->height);
+
+        for (int k = 0; k < nboxes; k++) {
+                struct A2View_region *b = &boxes[k];
+                if (!A2View_inside(b, pnm->width, pnm->height)) {
+                        fprintf(stderr, "Box %d,%d,%d,%d is not inside the "
+                                "image\n", b->x, b->y, b->width, b->height);
+                        status = EXIT_FAILURE;
+                        continue;
+                }
+                struct Sat_sums sum = Sat_sum(sat, b->x, b->y, b->width,
+                                              b->height);
+                struct Pnm_rgb mean = Sat_mean(sat, b->x, b->y, b->width,
+                                               b->height);
+                printf("%d,%d,%d,%d sum %llu %llu %llu mean %u %u %u\n",
+                       b->x, b->y, b->width, b->height,
+                       (unsigned long long)sum.red,
+                       (unsigned long long)sum.green,
+                       (unsigned long long)sum.blue, mean.red, mean.green,
+                       mean.blue);
+        }
+
+        Sat_free(&sat);
+        Pnm_ppmfree(&pnm);
+        return status;
+}
+
+/*
+ * run_convolve
+ *    Purpose: Handles -convolve: filters the image with Convolve_image and
+ *             then applies the transform, if any, to the result. With a
+ *             timing file, the time of the filter alone is reported per
+ *             pixel.
+ * Parameters: The open input (closed here), the kernel, the rotation or
+ *             code, the methods and map function, the number of threads, and
+ *             where to put the times or NULL
  *    Returns: Nothing
- *    Expects: The closure argument/struct is valid (unchecked), not NULL
- *             (checked), and the amount element of the struct must be a valid
- *             degree or flip code (checked).
+ *    Expects: The input is a PPM (load_ppm raises otherwise)
+ */
+void run_convolve(FILE *image, struct Convolve_kernel *kernel,
+                  int rotation, A2Methods_T methods, A2Methods_mapfun *map,
+                  int threads, struct run_times *times)
+{
+        CPUTime_T timer = NULL;
+
+        TRACE_BEGIN(TRACE_PHASE, "read");
+        Memstats_phase("read");
+        Pnm_ppm pnm = load_ppm(image, methods);
+        TRACE_END(TRACE_PHASE);
+
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "convolve");
+        Memstats_phase("convolve");
+        A2 filtered = Convolve_image(pnm, methods, kernel, threads);
+        TRACE_END(TRACE_PHASE);
+        stop_timer(&timer, times, (double)pnm->width * pnm->height);
+
+        /* the filtered image replaces the source */
+        methods->free(&pnm->pixels);
+        pnm->pixels = filtered;
+        if (rotation != 0) {
+                TRACE_BEGIN(TRACE_PHASE, "transform");
+                Memstats_phase("transform");
+                A2 out = transform_image(pnm, rotation, methods, map);
+                TRACE_END(TRACE_PHASE);
+                methods->free(&pnm->pixels);
+                pnm->pixels = out;
+                pnm->width  = methods->width(out);
+                pnm->height = methods->height(out);
+        }
+
+        TRACE_BEGIN(TRACE_PHASE, "write");
+        Memstats_phase("write");
+        Pnm_ppmwrite(stdout, pnm);
+        TRACE_END(TRACE_PHASE);
+        Pnm_ppmfree(&pnm);
+}
+
+/*
+ * run_pyramid
+ *    Purpose: Handles -pyramid: writes every level of the pyramid of the
+ *             transformed image, level k to <prefix>-<k>.ppm, or all of
+ *             them to stdout, one after the other as a multi-image PPM,
+ *             if the prefix is "-". Level 0 is written straight from a
+ *             view of the source. With a timing file, the time to build
+ *             the other levels is reported per source pixel.
+ * Parameters: The open input (closed here), the rotation or code, the
+ *             methods for the levels, the prefix, and where to put the times
+ *             or NULL
+ *    Returns: EXIT_SUCCESS, or EXIT_FAILURE if a level's file cannot be
+ *             created
+ *    Expects: The input is a PPM (load_ppm raises otherwise)
  */
-void assign_coords_calc(struct transform_closure *cl)
+int run_pyramid(FILE *image, int rotation, A2Methods_T methods,
+                char *prefix, struct run_times *times)
 {
-        if (cl == NULL) {
-                RAISE(invalid_parameter);
-        }
-        // need a case to handle null/exception
-        if (cl->amount == 0 || cl->amount % 90 == 0) {
-                cl->coords_calc = rotate_calc;
-        } else if (cl->amount == TRANSPOSE_CODE) {
-                cl->coords_calc = transpose_calc;
-        } else if (cl->amount == FLIP_HOR_CODE) {
-                cl->coords_calc = flip_hor_calc;
-        } else if (cl->amount == FLIP_VER_CODE) {
-                cl->coords_calc = flip_ver_calc;
+        CPUTime_T timer = NULL;
+        int nlevels, status = EXIT_SUCCESS;
+
+        TRACE_BEGIN(TRACE_PHASE, "read");
+        Memstats_phase("read");
+        Pnm_ppm pnm = load_ppm(image, methods);
+        TRACE_END(TRACE_PHASE);
+
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "transform");
+        Memstats_phase("transform");
+        A2 *levels = Pyramid_build(pnm, rotation, methods, &nlevels);
+        TRACE_END(TRACE_PHASE);
+        stop_timer(&timer, times, (double)pnm->width * pnm->height);
+
+        TRACE_BEGIN(TRACE_PHASE, "write");
+        Memstats_phase("write");
+        A2 view = A2View_new(methods, pnm->pixels, rotation, NULL);
+        for (int k = 0; k < nlevels; k++) {
+                A2Methods_T level_methods = k == 0 ? a2view_methods
+                                                   : methods;
+                A2 level = k == 0 ? view : levels[k];
+                struct Pnm_ppm pnmout = {level_methods->width(level),
+                                         level_methods->height(level),
+                                         pnm->denominator, level,
+                                         level_methods};
+                FILE *out = stdout;
+                if (strcmp(prefix, "-") != 0) {
+                        char path[4096];
+                        snprintf(path, sizeof(path), "%s-%d.ppm", prefix, k);
+                        out = fopen(path, "wb");
+                        if (out == NULL) {
+                                perror(path);
+                                status = EXIT_FAILURE;
+                                break;
+                        }
+                }
+                Pnm_ppmwrite(out, &pnmout);
+                if (out != stdout) {
+                        fclose(out);
+                }
+        }
+        TRACE_END(TRACE_PHASE);
+
+        a2view_methods->free(&view);
+        Pyramid_free(&levels, nlevels, methods);
+        Pnm_ppmfree(&pnm);
+        return status;
+}
+
+/*
+ * run_crop
+ *    Purpose: Handles -crop: transforms only a region of the image, in the
+ *             one pass of Crop_load that decodes the region's pixels
+ *             straight into their transformed places. With a timing file,
+ *             the time of that pass is reported in place of the map time.
+ * Parameters: The open input (closed here), the region, the rotation or
+ *             code, the methods for the output, and where to put the times
+ *             or NULL
+ *    Returns: EXIT_SUCCESS, or EXIT_FAILURE if the region does not lie
+ *             inside the image
+ *    Expects: The input is a binary PPM (raises Ppmio_badformat otherwise)
+ */
+int run_crop(FILE *image, struct A2View_region *region, int rotation,
+             A2Methods_T methods, struct run_times *times)
+{
+        CPUTime_T timer = NULL;
+        Pnm_ppm pic;
+
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "crop");
+        Memstats_phase("crop");
+        pic = Crop_load(image, region, rotation, methods);
+        TRACE_END(TRACE_PHASE);
+        if (image != stdin) {
+                fclose(image);
+        }
+        if (pic == NULL) {
+                fprintf(stderr, "Crop region %d,%d,%d,%d is not inside the "
+                        "image\n", region->x, region->y, region->width,
+                        region->height);
+                return EXIT_FAILURE;
+        }
+        stop_timer(&timer, times, (double)pic->width * pic->height);
+
+        TRACE_BEGIN(TRACE_PHASE, "write");
+        Memstats_phase("write");
+        Pnm_ppmwrite(stdout, pic);
+        TRACE_END(TRACE_PHASE);
+        Ppmio_free(&pic);
+        return EXIT_SUCCESS;
+}
+
+/*
+ * run_fanout
+ *    Purpose: Handles -out: reads the image once and produces every
+ *             requested transform of it in a single traversal of the
+ *             source (transform_fanout), then writes each result to its
+ *             file. With a timing file, writes the time of that one map
+ *             and the time per source pixel.
+ * Parameters: The open input (closed here), the methods and map, the output
+ *             specs and how many there are, and where to put the times or
+ *             NULL
+ *    Returns: EXIT_SUCCESS, or EXIT_FAILURE if an output file could not be
+ *             opened, in which case nothing is transformed
+ *    Expects: 1 <= noutputs <= MAX_OUTPUTS (unchecked)
+ */
+int run_fanout(FILE *image, A2Methods_T methods, A2Methods_mapfun *map,
+               struct output_spec *outputs, int noutputs,
+               struct run_times *times)
+{
+        struct transform_closure targets[MAX_OUTPUTS];
+        struct fanout_closure fanout = {noutputs, targets};
+        FILE *files[MAX_OUTPUTS];
+        CPUTime_T timer = NULL;
+
+        for (int k = 0; k < noutputs; k++) {
+                files[k] = fopen(outputs[k].path, "wb");
+                if (files[k] == NULL) {
+                        perror(outputs[k].path);
+                        while (k-- > 0) {
+                                fclose(files[k]);
+                        }
+                        return EXIT_FAILURE;
+                }
+        }
+
+        TRACE_BEGIN(TRACE_PHASE, "read");
+        Memstats_phase("read");
+        Pnm_ppm pnm = load_ppm(image, methods);
+        TRACE_END(TRACE_PHASE);
+
+        TRACE_BEGIN(TRACE_PHASE, "allocate");
+        Memstats_phase("allocate");
+        for (int k = 0; k < noutputs; k++) {
+                targets[k].amount  = outputs[k].rotation;
+                targets[k].methods = methods;
+                targets[k].output  = make_a2_out(outputs[k].rotation,
+                                                 methods, pnm);
+                assign_coords_calc(&targets[k]);
+        }
+        TRACE_END(TRACE_PHASE);
+
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "transform");
+        Memstats_phase("transform");
+        map(pnm->pixels, transform_fanout, &fanout);
+        TRACE_END(TRACE_PHASE);
+        stop_timer(&timer, times, (double)pnm->width * pnm->height);
+
+        TRACE_BEGIN(TRACE_PHASE, "write");
+        Memstats_phase("write");
+        for (int k = 0; k < noutputs; k++) {
+                struct Pnm_ppm pnmout = {methods->width(targets[k].output),
+                                         methods->height(targets[k].output),
+                                         pnm->denominator, targets[k].output,
+                                         methods};
+                Pnm_ppmwrite(files[k], &pnmout);
+                fclose(files[k]);
+        }
+        TRACE_END(TRACE_PHASE);
+
+        TRACE_BEGIN(TRACE_PHASE, "free");
+        Memstats_phase("free");
+        for (int k = 0; k < noutputs; k++) {
+                methods->free(&targets[k].output);
+        }
+        Pnm_ppmfree(&pnm);
+        TRACE_END(TRACE_PHASE);
+        return EXIT_SUCCESS;
+}
+
+/*
+ * run_stream
+ *    Purpose: Transforms every frame of a multi-image PPM stream with the
+ *             frame pipeline of stream.h. With a timing file, writes the CPU
+ *             time of the whole run (all threads) and the time per frame.
+ * Parameters: The open input, the transform, and where to put the times or
+ *             NULL
+ *    Returns: Nothing
+ *    Expects: Every frame is a binary PPM (raises Ppmio_badformat
+ *             otherwise)
+ */
+void run_stream(FILE *image, struct Stream_spec *spec, struct run_times *times)
+{
+        CPUTime_T timer = NULL;
+        int frames;
+
+        timer = start_timer(times);
+        TRACE_BEGIN(TRACE_PHASE, "stream");
+        Memstats_phase("stream");
+        frames = Stream_run(image, stdout, spec);
+        TRACE_END(TRACE_PHASE);
+
+        stop_timer(&timer, times, frames);
+}
+
+/*
+ * run_batch
+ *    Purpose: Runs batch mode (batch.h) over the jobs of a list file or a
+ *             directory and reports the per-image times, on the timing
+ *             file if there is one and on stderr otherwise. Freed arrays
+ *             are pooled so that each worker can reuse the storage of its
+ *             last input and output.
+ * Parameters: The list file name, or NULL to use the input and output
+ *             directories; the transform; and the timing file name or NULL
+ *    Returns: EXIT_SUCCESS if every image was transformed, EXIT_FAILURE
+ *             otherwise
+ *    Expects: Exactly one of list_name and indir is nonnull (unchecked)
+ */
+int run_batch(char *list_name, char *indir, char *outdir,
+              struct Batch_spec *spec, char *time_file_name)
+{
+        struct Batch_job *jobs;
+        FILE *report = stderr;
+        int njobs, failed = 0;
+        double wall;
+
+        if (list_name != NULL) {
+                FILE *list = open_file(list_name);
+                njobs = Batch_read_list(list, &jobs);
+                fclose(list);
         } else {
-                RAISE(invalid_parameter);
+                njobs = Batch_read_dir(indir, outdir, &jobs);
+                if (njobs < 0) {
+                        fprintf(stderr, "Could not read directory %s\n",
+                                indir);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        Storage_set_pool(2 * spec->threads);
+        TRACE_BEGIN(TRACE_PHASE, "batch");
+        Memstats_phase("batch");
+        wall = Batch_run(jobs, njobs, spec);
+        TRACE_END(TRACE_PHASE);
+        Storage_set_pool(0);
+
+        if (time_file_name != NULL) {
+                report = fopen(time_file_name, "w");
+                if (report == NULL) {
+                        perror(time_file_name);
+                        report = stderr;
+                }
+        }
+        Batch_report(report, jobs, njobs, wall);
+        if (report != stderr) {
+                fclose(report);
+        }
+        for (int i = 0; i < njobs; i++) {
+                failed |= jobs[i].error != NULL;
         }
-        return;
+        Batch_free(&jobs, njobs);
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
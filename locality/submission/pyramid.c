@@ -0,0 +1,162 @@
+/***********************************************************************
+ *                              pyramid.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the pyramids in pyramid.h. The recursion
+ *          returns the exact sums of the level 0 pixels under each pixel
+ *          along with their count, so every level is rounded only once,
+ *          from level 0, and a pixel on a ragged edge with fewer than
+ *          four children is still the true average of what it covers.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "assert.h"
+#include "trace.h"
+#include "a2view.h"
+#include "pyramid.h"
+
+typedef A2Methods_UArray2 A2;
+
+struct total {
+        uint64_t red, green, blue;
+        uint64_t count;                 /* level 0 pixels summed */
+};
+
+struct pyramid {
+        A2 view;                        /* level 0 */
+        A2Methods_T methods;            /* of levels 1 and up */
+        A2 *levels;                     /* levels[0] is the view */
+        int *widths, *heights;
+};
+
+static struct total reduce(struct pyramid *p, int level, int x, int y);
+
+/*
+ * Pyramid_levels
+ *    Purpose: Counts the levels of the pyramid of an image
+ * Parameters: The width and height of level 0
+ *    Returns: The number of levels, level 0 and the final 1 by 1 included
+ */
+int Pyramid_levels(int width, int height)
+{
+        int n = 1;
+
+        while (width > 1 || height > 1) {
+                width  = (width + 1) / 2;
+                height = (height + 1) / 2;
+                n++;
+        }
+        return n;
+}
+
+/*
+ * Pyramid_build
+ *    Purpose: Computes every level of the pyramid of an image but level 0
+ * Parameters: The image, the rotation or code to apply to it first, the
+ *             methods the image was read with (also used for the levels),
+ *             and where to put the number of levels
+ *    Returns: An array of *nlevels arrays of Pnm_rgb. Element 0 is NULL,
+ *             since level 0 is the transformed image itself; element k is
+ *             level k. Free it with Pyramid_free.
+ *    Expects: pic, methods and nlevels are nonnull (checked), and the
+ *             rotation is valid (raises invalid_parameter otherwise)
+ */
+A2 *Pyramid_build(Pnm_ppm pic, int rotation, A2Methods_T methods,
+                  int *nlevels)
+{
+        struct pyramid p;
+        int n;
+
+        assert(pic != NULL && methods != NULL && nlevels != NULL);
+        p.view    = A2View_new(methods, pic->pixels, rotation, NULL);
+        p.methods = methods;
+        n         = Pyramid_levels(a2view_methods->width(p.view),
+                                   a2view_methods->height(p.view));
+        p.levels  = malloc(n * sizeof(A2));
+        p.widths  = malloc(n * sizeof(int));
+        p.heights = malloc(n * sizeof(int));
+        assert(p.levels != NULL && p.widths != NULL && p.heights != NULL);
+
+        p.levels[0]  = NULL;
+        p.widths[0]  = a2view_methods->width(p.view);
+        p.heights[0] = a2view_methods->height(p.view);
+        for (int k = 1; k < n; k++) {
+                p.widths[k]  = (p.widths[k - 1] + 1) / 2;
+                p.heights[k] = (p.heights[k - 1] + 1) / 2;
+                p.levels[k]  = methods->new(p.widths[k], p.heights[k],
+                                            sizeof(struct Pnm_rgb));
+        }
+
+        TRACE_BEGIN(TRACE_DETAIL, "reduce");
+        if (n > 1) {
+                reduce(&p, n - 1, 0, 0);
+        }
+        TRACE_END(TRACE_DETAIL);
+
+        a2view_methods->free(&p.view);
+        free(p.widths);
+        free(p.heights);
+        *nlevels = n;
+        return p.levels;
+}
+
+/*
+ * reduce
+ *    Purpose: Computes a pixel of a level from its children, after
+ *             computing them, and stores it
+ * Parameters: The pyramid, the level (0 only reads the source), and the
+ *             coordinates of the pixel in that level
+ *    Returns: The sums of the level 0 pixels under the pixel
+ */
+static struct total reduce(struct pyramid *p, int level, int x, int y)
+{
+        struct total t = {0, 0, 0, 0};
+        struct Pnm_rgb *pixel;
+
+        if (level == 0) {
+                pixel   = a2view_methods->at(p->view, x, y);
+                t.red   = pixel->red;
+                t.green = pixel->green;
+                t.blue  = pixel->blue;
+                t.count = 1;
+                return t;
+        }
+        for (int dy = 0; dy < 2; dy++) {
+                for (int dx = 0; dx < 2; dx++) {
+                        int cx = 2 * x + dx, cy = 2 * y + dy;
+                        struct total child;
+                        if (cx >= p->widths[level - 1]
+                            || cy >= p->heights[level - 1]) {
+                                continue;
+                        }
+                        child    = reduce(p, level - 1, cx, cy);
+                        t.red   += child.red;
+                        t.green += child.green;
+                        t.blue  += child.blue;
+                        t.count += child.count;
+                }
+        }
+        pixel = p->methods->at(p->levels[level], x, y);
+        pixel->red   = (t.red + t.count / 2) / t.count;
+        pixel->green = (t.green + t.count / 2) / t.count;
+        pixel->blue  = (t.blue + t.count / 2) / t.count;
+        return t;
+}
+
+/*
+ * Pyramid_free
+ *    Purpose: Frees the levels Pyramid_build made and sets *levels to NULL
+ * Parameters: The levels, their number, and the methods they were made
+ *             with
+ */
+void Pyramid_free(A2 **levels, int nlevels, A2Methods_T methods)
+{
+        assert(levels != NULL && *levels != NULL && methods != NULL);
+        for (int k = 1; k < nlevels; k++) {
+                methods->free(&(*levels)[k]);
+        }
+        free(*levels);
+        *levels = NULL;
+}
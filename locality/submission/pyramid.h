@@ -0,0 +1,34 @@
+/***********************************************************************
+ *                              pyramid.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Image pyramids (mipmaps) for zoomable viewers. Level 0 is the
+ *          image, optionally transformed, and each further level halves
+ *          the one below it, rounding up, until the last is 1 by 1. A
+ *          pixel of a level is the average of all the level 0 pixels it
+ *          covers.
+ *
+ *          Pyramid_build makes every level in a single traversal of the
+ *          source. It computes the pyramid depth first, as a quadtree: a
+ *          pixel is computed right after its four children, while they
+ *          are still in the cache, so level 0 is read in Z order, which
+ *          stays within one block of a blocked array at a time, and every
+ *          level above is built from values just computed rather than
+ *          from another pass over the one below. The source is read
+ *          through an A2View, so the transform costs no extra pass
+ *          either.
+ ***********************************************************************/
+
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include "a2methods.h"
+#include "pnm.h"
+
+int Pyramid_levels(int width, int height);
+A2Methods_UArray2 *Pyramid_build(Pnm_ppm pic, int rotation,
+                                 A2Methods_T methods, int *nlevels);
+void Pyramid_free(A2Methods_UArray2 **levels, int nlevels,
+                  A2Methods_T methods);
+
+#endif
@@ -0,0 +1,296 @@
+/***********************************************************************
+ *                              qoi.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the QOI codec in qoi.h, following the QOI
+ *          specification (version 1.0): a 14-byte header with the magic
+ *          "qoif", big-endian width and height, the number of channels
+ *          and the color space; then the chunks; then seven zero bytes
+ *          and a one. Files are written with three channels. Bytes go
+ *          through a buffer of BUFFER_SIZE so that the inner loops do no
+ *          stdio calls.
+ ***********************************************************************/
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "trace.h"
+#include "qoi.h"
+
+Except_T Qoi_badformat = { "Badly formatted QOI image" };
+
+#define BUFFER_SIZE 65536
+
+#define OP_INDEX 0x00
+#define OP_DIFF  0x40
+#define OP_LUMA  0x80
+#define OP_RUN   0xc0
+#define OP_RGB   0xfe
+#define OP_RGBA  0xff
+#define OP_MASK  0xc0
+#define MAX_RUN  62
+
+static const unsigned char END_MARKER[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+struct color {
+        unsigned char r, g, b, a;
+};
+
+/* A file and its buffer */
+struct buffer {
+        FILE *fp;
+        unsigned char bytes[BUFFER_SIZE];
+        size_t pos, len;
+};
+
+static inline int hash(struct color c)
+{
+        return (c.r * 3 + c.g * 5 + c.b * 7 + c.a * 11) % 64;
+}
+
+static inline int same(struct color a, struct color b)
+{
+        return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+/* Next byte of the input; raises Qoi_badformat at end of file */
+static inline unsigned char get_byte(struct buffer *in)
+{
+        if (in->pos == in->len) {
+                in->len = fread(in->bytes, 1, BUFFER_SIZE, in->fp);
+                in->pos = 0;
+                if (in->len == 0) {
+                        RAISE(Qoi_badformat);
+                }
+        }
+        return in->bytes[in->pos++];
+}
+
+static inline void put_byte(struct buffer *out, unsigned char byte)
+{
+        if (out->len == BUFFER_SIZE) {
+                fwrite(out->bytes, 1, out->len, out->fp);
+                out->len = 0;
+        }
+        out->bytes[out->len++] = byte;
+}
+
+static uint32_t get_u32(struct buffer *in)
+{
+        uint32_t n = 0;
+
+        for (int k = 0; k < 4; k++) {
+                n = n << 8 | get_byte(in);
+        }
+        return n;
+}
+
+static void put_u32(struct buffer *out, uint32_t n)
+{
+        for (int shift = 24; shift >= 0; shift -= 8) {
+                put_byte(out, n >> shift & 0xff);
+        }
+}
+
+/*
+ * Qoi_peek
+ *    Purpose: Tells whether fp is at a QOI image, without consuming
+ *             anything, as Ppmio_peek_format does
+ *    Returns: 1 if the input starts with "qo", 0 otherwise
+ *    Expects: As for Ppmio_peek_format
+ */
+int Qoi_peek(FILE *fp)
+{
+        int q = getc(fp), o;
+
+        if (q == EOF) {
+                return 0;
+        }
+        o = getc(fp);
+        if (o != EOF) {
+                ungetc(o, fp);
+        }
+        ungetc(q, fp);
+        return q == 'q' && o == 'o';
+}
+
+/*
+ * Qoi_read
+ *    Purpose: Decodes a QOI image into a new A2
+ * Parameters: An open file and the methods for the pixel array
+ *    Returns: The image, with a maxval of 255, to be freed with Ppmio_free
+ *    Expects: fp holds a QOI image; raises Qoi_badformat otherwise. The
+ *             input may be read past the end of the image.
+ */
+Pnm_ppm Qoi_read(FILE *fp, A2Methods_T methods)
+{
+        struct buffer *in = malloc(sizeof(*in));
+        struct color index[64], px = { 0, 0, 0, 255 };
+        uint32_t width, height;
+        int channels, colorspace, run = 0;
+        Pnm_ppm pic;
+
+        assert(fp != NULL && methods != NULL && in != NULL);
+        in->fp  = fp;
+        in->pos = in->len = 0;
+        if (get_byte(in) != 'q' || get_byte(in) != 'o'
+            || get_byte(in) != 'i' || get_byte(in) != 'f') {
+                RAISE(Qoi_badformat);
+        }
+        width      = get_u32(in);
+        height     = get_u32(in);
+        channels   = get_byte(in);
+        colorspace = get_byte(in);
+        if (width < 1 || height < 1 || width > INT_MAX || height > INT_MAX
+            || (channels != 3 && channels != 4) || colorspace > 1) {
+                RAISE(Qoi_badformat);
+        }
+        memset(index, 0, sizeof(index));
+        pic = malloc(sizeof(*pic));
+        assert(pic != NULL);
+        pic->width       = width;
+        pic->height      = height;
+        pic->denominator = 255;
+        pic->methods     = methods;
+        pic->pixels      = methods->new(width, height,
+                                        sizeof(struct Pnm_rgb));
+
+        TRACE_BEGIN(TRACE_DETAIL, "qoi decode");
+        for (int y = 0; y < (int)height; y++) {
+                for (int x = 0; x < (int)width; x++) {
+                        struct Pnm_rgb *pixel;
+                        if (run > 0) {
+                                run--;
+                        } else {
+                                int b1 = get_byte(in);
+                                if (b1 == OP_RGB) {
+                                        px.r = get_byte(in);
+                                        px.g = get_byte(in);
+                                        px.b = get_byte(in);
+                                } else if (b1 == OP_RGBA) {
+                                        px.r = get_byte(in);
+                                        px.g = get_byte(in);
+                                        px.b = get_byte(in);
+                                        px.a = get_byte(in);
+                                } else if ((b1 & OP_MASK) == OP_INDEX) {
+                                        px = index[b1];
+                                } else if ((b1 & OP_MASK) == OP_DIFF) {
+                                        px.r += (b1 >> 4 & 0x03) - 2;
+                                        px.g += (b1 >> 2 & 0x03) - 2;
+                                        px.b += (b1      & 0x03) - 2;
+                                } else if ((b1 & OP_MASK) == OP_LUMA) {
+                                        int b2 = get_byte(in);
+                                        int vg = (b1 & 0x3f) - 32;
+                                        px.r += vg - 8 + (b2 >> 4 & 0x0f);
+                                        px.g += vg;
+                                        px.b += vg - 8 + (b2 & 0x0f);
+                                } else {
+                                        run = b1 & 0x3f;
+                                }
+                                index[hash(px)] = px;
+                        }
+                        pixel = methods->at(pic->pixels, x, y);
+                        pixel->red   = px.r;
+                        pixel->green = px.g;
+                        pixel->blue  = px.b;
+                }
+        }
+        TRACE_END(TRACE_DETAIL);
+        free(in);
+        return pic;
+}
+
+/*
+ * Qoi_write
+ *    Purpose: Encodes an image as QOI, visiting its pixels in row-major
+ *             order through its own methods
+ * Parameters: An open file and the image
+ *    Returns: Nothing
+ *    Expects: fp and pic are nonnull (checked); the maxval is 255 (raises
+ *             Qoi_badformat otherwise)
+ */
+void Qoi_write(FILE *fp, Pnm_ppm pic)
+{
+        struct buffer *out = malloc(sizeof(*out));
+        struct color index[64], prev = { 0, 0, 0, 255 };
+        int run = 0;
+
+        assert(fp != NULL && pic != NULL && out != NULL);
+        if (pic->denominator != 255) {
+                free(out);
+                RAISE(Qoi_badformat);
+        }
+        out->fp  = fp;
+        out->len = 0;
+        memset(index, 0, sizeof(index));
+        put_byte(out, 'q');
+        put_byte(out, 'o');
+        put_byte(out, 'i');
+        put_byte(out, 'f');
+        put_u32(out, pic->width);
+        put_u32(out, pic->height);
+        put_byte(out, 3);               /* RGB */
+        put_byte(out, 0);               /* sRGB with linear alpha */
+
+        TRACE_BEGIN(TRACE_DETAIL, "qoi encode");
+        for (int y = 0; y < (int)pic->height; y++) {
+                for (int x = 0; x < (int)pic->width; x++) {
+                        struct Pnm_rgb *pixel = pic->methods->at(
+                                pic->pixels, x, y);
+                        struct color px = { pixel->red, pixel->green,
+                                            pixel->blue, 255 };
+                        int h;
+                        if (same(px, prev)) {
+                                if (++run == MAX_RUN) {
+                                        put_byte(out, OP_RUN | (run - 1));
+                                        run = 0;
+                                }
+                                continue;
+                        }
+                        if (run > 0) {
+                                put_byte(out, OP_RUN | (run - 1));
+                                run = 0;
+                        }
+                        h = hash(px);
+                        if (same(index[h], px)) {
+                                put_byte(out, OP_INDEX | h);
+                        } else {
+                                signed char vr = px.r - prev.r;
+                                signed char vg = px.g - prev.g;
+                                signed char vb = px.b - prev.b;
+                                signed char vg_r = vr - vg, vg_b = vb - vg;
+                                index[h] = px;
+                                if (vr >= -2 && vr <= 1 && vg >= -2
+                                    && vg <= 1 && vb >= -2 && vb <= 1) {
+                                        put_byte(out, OP_DIFF | (vr + 2) << 4
+                                                      | (vg + 2) << 2
+                                                      | (vb + 2));
+                                } else if (vg_r >= -8 && vg_r <= 7
+                                           && vg >= -32 && vg <= 31
+                                           && vg_b >= -8 && vg_b <= 7) {
+                                        put_byte(out, OP_LUMA | (vg + 32));
+                                        put_byte(out, (vg_r + 8) << 4
+                                                      | (vg_b + 8));
+                                } else {
+                                        put_byte(out, OP_RGB);
+                                        put_byte(out, px.r);
+                                        put_byte(out, px.g);
+                                        put_byte(out, px.b);
+                                }
+                        }
+                        prev = px;
+                }
+        }
+        if (run > 0) {
+                put_byte(out, OP_RUN | (run - 1));
+        }
+        TRACE_END(TRACE_DETAIL);
+        for (size_t k = 0; k < sizeof(END_MARKER); k++) {
+                put_byte(out, END_MARKER[k]);
+        }
+        fwrite(out->bytes, 1, out->len, fp);
+        free(out);
+}
@@ -0,0 +1,34 @@
+/***********************************************************************
+ *                              qoi.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Reading and writing of QOI ("Quite OK Image") files, a simple
+ *          lossless format that codes each pixel in a single pass as a
+ *          run, a reference to one of 64 recently seen colors, a small
+ *          difference from the previous pixel, or the pixel itself.
+ *          Photographs typically shrink to a third or less of their raw
+ *          P6 size, which relieves the disk or pipe between two stages
+ *          of a pipeline for little CPU.
+ *
+ *          Qoi_read decodes straight into an A2 of any methods suite, in
+ *          row-major order; Qoi_write encodes from any image, such as the
+ *          output of a transform, through a small buffer. Only images
+ *          with a maxval of 255 can be written, since QOI has 8-bit
+ *          samples. An alpha channel in the input is dropped.
+ ***********************************************************************/
+
+#ifndef QOI_H
+#define QOI_H
+
+#include <stdio.h>
+#include "except.h"
+#include "a2methods.h"
+#include "pnm.h"
+
+extern Except_T Qoi_badformat;
+
+extern int     Qoi_peek (FILE *fp);
+extern Pnm_ppm Qoi_read (FILE *fp, A2Methods_T methods);
+extern void    Qoi_write(FILE *fp, Pnm_ppm pic);
+
+#endif
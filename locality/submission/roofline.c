@@ -0,0 +1,112 @@
+/***********************************************************************
+ *                              roofline.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Reading, writing and reporting of the memory bandwidth
+ *          calibration produced by timing_test. See roofline.h for the
+ *          file format.
+ ***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "roofline.h"
+
+/*
+ * Roofline_write
+ *    Purpose: Writes a calibration in the "key value" text format
+ * Parameters: An open file and the calibration to write
+ *    Returns: Nothing
+ *    Expects: Both pointers are nonnull (unchecked)
+ */
+void Roofline_write(FILE *fp, const struct Roofline *r)
+{
+        fprintf(fp, "copy %f\n",    r->copy);
+        fprintf(fp, "read %f\n",    r->read);
+        fprintf(fp, "write %f\n",   r->write);
+        fprintf(fp, "strided %f\n", r->strided);
+        fprintf(fp, "latency %f\n", r->latency);
+}
+
+/*
+ * Roofline_read
+ *    Purpose: Parses a calibration written by Roofline_write. Keys that are
+ *             missing from the file are left at zero.
+ * Parameters: An open file and the calibration to fill in
+ *    Returns: The number of known keys that were read
+ *    Expects: Both pointers are nonnull (unchecked)
+ */
+int Roofline_read(FILE *fp, struct Roofline *r)
+{
+        char key[32];
+        double value;
+        int found = 0;
+
+        memset(r, 0, sizeof(*r));
+        while (fscanf(fp, "%31s %lf", key, &value) == 2) {
+                if (strcmp(key, "copy") == 0) {
+                        r->copy = value;
+                } else if (strcmp(key, "read") == 0) {
+                        r->read = value;
+                } else if (strcmp(key, "write") == 0) {
+                        r->write = value;
+                } else if (strcmp(key, "strided") == 0) {
+                        r->strided = value;
+                } else if (strcmp(key, "latency") == 0) {
+                        r->latency = value;
+                } else {
+                        continue;
+                }
+                found++;
+        }
+        return found;
+}
+
+/*
+ * Roofline_load
+ *    Purpose: Opens and parses a calibration file
+ * Parameters: The file name and the calibration to fill in
+ *    Returns: The number of known keys read, or -1 if the file could not
+ *             be opened
+ *    Expects: Both pointers are nonnull (unchecked)
+ */
+int Roofline_load(const char *filename, struct Roofline *r)
+{
+        FILE *fp = fopen(filename, "r");
+        int found;
+
+        if (fp == NULL) {
+                return -1;
+        }
+        found = Roofline_read(fp, r);
+        fclose(fp);
+        return found;
+}
+
+/*
+ * Roofline_report
+ *    Purpose: Prints the bandwidth a piece of work achieved, and that
+ *             bandwidth as a fraction of each calibrated ceiling, so we can
+ *             see how much headroom is left.
+ * Parameters: An open file, the calibration, the number of bytes the work
+ *             read plus wrote, and how long it took in nanoseconds
+ *    Returns: Nothing
+ *    Expects: fp and r are nonnull (unchecked). Ceilings that are zero are
+ *             skipped.
+ */
+void Roofline_report(FILE *fp, const struct Roofline *r, double bytes,
+                     double nanoseconds)
+{
+        double achieved = nanoseconds > 0 ? bytes / nanoseconds : 0;
+
+        fprintf(fp, "bytes moved: %.0f\n", bytes);
+        fprintf(fp, "achieved GB/s: %f\n", achieved);
+        if (r->copy > 0) {
+                fprintf(fp, "fraction of copy bandwidth: %f\n",
+                        achieved / r->copy);
+        }
+        if (r->strided > 0) {
+                fprintf(fp, "fraction of strided bandwidth: %f\n",
+                        achieved / r->strided);
+        }
+}
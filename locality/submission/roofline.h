@@ -0,0 +1,41 @@
+/***********************************************************************
+ *                              roofline.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Interface for the memory bandwidth calibration shared by
+ *          timing_test (which measures it) and ppmtrans (which reports
+ *          each transform as a fraction of it). All bandwidths are in
+ *          bytes per nanosecond, which is the same thing as GB/s.
+ *
+ *          A calibration file is plain text, one "key value" pair per
+ *          line, for example:
+ *
+ *                copy 11.52
+ *                read 14.07
+ *                write 9.81
+ *                strided 1.93
+ *                latency 84.2
+ *
+ *          Unknown keys are ignored so that the file can grow later.
+ ***********************************************************************/
+
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+
+#include <stdio.h>
+
+struct Roofline {
+        double copy;        /* read + write bytes per ns, STREAM copy   */
+        double read;        /* bytes read per ns, sequential            */
+        double write;       /* bytes written per ns, sequential         */
+        double strided;     /* bytes read per ns, one element per stride */
+        double latency;     /* ns per dependent random load             */
+};
+
+void Roofline_write(FILE *fp, const struct Roofline *r);
+int  Roofline_read (FILE *fp, struct Roofline *r);
+int  Roofline_load (const char *filename, struct Roofline *r);
+void Roofline_report(FILE *fp, const struct Roofline *r, double bytes,
+                     double nanoseconds);
+
+#endif
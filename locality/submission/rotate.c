@@ -0,0 +1,315 @@
+/***********************************************************************
+ *                              rotate.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the any-angle rotation in rotate.h.
+ *
+ *          Coordinates are those of pixel centers, with the rotation
+ *          taken about the center of the image. An output pixel at (x, y)
+ *          samples the source at
+ *
+ *              sx =  cos a (x - ocx) + sin a (y - ocy) + icx
+ *              sy = -sin a (x - ocx) + cos a (y - ocy) + icy
+ *
+ *          where (icx, icy) and (ocx, ocy) are the centers of the source
+ *          and the output. Along a row of a tile sx and sy change by a
+ *          constant step, so each row first fills arrays of source
+ *          coordinates with one add per pixel, then samples them.
+ *
+ *          The samples are where the time goes, up to four source pixels
+ *          per output pixel, so they do not go through methods->at when
+ *          the source layout is known. A plain source is read at its base
+ *          plus column and row steps, a blocked one through the block
+ *          storage of uarray2b_storage.h; any other (such as an
+ *          out-of-core array) still uses its at.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "assert.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "uarray2b_storage.h"
+#include "trace.h"
+#include "parallel.h"
+#include "rotate.h"
+
+#define PI           3.14159265358979323846
+
+/* Slack for the rounding in sin and cos, so 90 degrees does not add a row */
+#define SIZE_EPSILON 1e-6
+
+/* How the samples read the source */
+enum source_layout { SOURCE_AT, SOURCE_PLAIN, SOURCE_BLOCKED };
+
+struct source {
+        enum source_layout layout;
+        char *base;                     /* pixel (0, 0), or first block  */
+        long col_bytes, row_bytes;      /* plain: steps, may be < 0      */
+        long block_bytes;               /* blocked: distance of blocks   */
+        int blocksize, blocks_down;     /* blocked: blocks per column    */
+};
+
+struct rotation {
+        Pnm_ppm pic;
+        struct source source;
+        A2Methods_T methods;            /* of the output */
+        A2Methods_UArray2 output;
+        enum Rotate_filter filter;
+        double cos, sin;
+        double icx, icy, ocx, ocy;      /* centers of source and output */
+        int tile, tiles_across, ntiles;
+        double *sx, *sy;                /* a tile row per worker */
+};
+
+static void  find_source(struct rotation *r);
+static void  fill_tile(int tile, int worker, void *rotation);
+static void  nearest(const struct rotation *r, double x, double y,
+                     struct Pnm_rgb *to);
+static void  bilinear(const struct rotation *r, double x, double y,
+                      struct Pnm_rgb *to);
+
+/*
+ * Rotate_size
+ *    Purpose: Computes the size of an image rotated by any angle
+ * Parameters: The width and height of the image, the angle in degrees,
+ *             and where to put the width and height of the result
+ *    Returns: Nothing
+ *    Expects: The pointers are nonnull (checked)
+ */
+void Rotate_size(int width, int height, double degrees, int *out_width,
+                 int *out_height)
+{
+        double c = fabs(cos(degrees * PI / 180)),
+               s = fabs(sin(degrees * PI / 180));
+
+        assert(out_width != NULL && out_height != NULL);
+        *out_width  = (int)ceil(width * c + height * s - SIZE_EPSILON);
+        *out_height = (int)ceil(width * s + height * c - SIZE_EPSILON);
+        if (*out_width < 1) {
+                *out_width = 1;
+        }
+        if (*out_height < 1) {
+                *out_height = 1;
+        }
+}
+
+/*
+ * Rotate_image
+ *    Purpose: Rotates an image clockwise by any angle
+ * Parameters: The image, the methods for the output, and the angle,
+ *             filter, number of threads and tile size
+ *    Returns: A new array of Pnm_rgb the size Rotate_size gives, to be
+ *             freed with methods->free
+ *    Expects: pic, methods and spec are nonnull, and spec asks for at
+ *             least one thread and a tile size of at least 0 (checked)
+ */
+A2Methods_UArray2 Rotate_image(Pnm_ppm pic, A2Methods_T methods,
+                               const struct Rotate_spec *spec)
+{
+        struct rotation r;
+        int width, height, nworkers;
+        double radians;
+
+        assert(pic != NULL && methods != NULL && spec != NULL);
+        assert(spec->threads >= 1 && spec->tile >= 0);
+        Rotate_size(pic->width, pic->height, spec->degrees, &width,
+                    &height);
+        radians    = spec->degrees * PI / 180;
+        r.pic      = pic;
+        r.methods  = methods;
+        r.output   = methods->new(width, height, sizeof(struct Pnm_rgb));
+        r.filter   = spec->filter;
+        r.cos      = cos(radians);
+        r.sin      = sin(radians);
+        r.icx      = (pic->width - 1) / 2.0;
+        r.icy      = (pic->height - 1) / 2.0;
+        r.ocx      = (width - 1) / 2.0;
+        r.ocy      = (height - 1) / 2.0;
+        r.tile     = spec->tile;
+        if (r.tile == 0) {
+                /* a blocked output is filled a block at a time */
+                r.tile = Parallel_tile(methods, r.output);
+        }
+        find_source(&r);
+        r.tiles_across = (width + r.tile - 1) / r.tile;
+        r.ntiles       = r.tiles_across * ((height + r.tile - 1) / r.tile);
+
+        nworkers = Parallel_workers(r.ntiles, spec->threads);
+        r.sx     = malloc((long)nworkers * r.tile * sizeof(double));
+        r.sy     = malloc((long)nworkers * r.tile * sizeof(double));
+        assert(r.sx != NULL && r.sy != NULL);
+        TRACE_BEGIN(TRACE_DETAIL, "rotate");
+        Parallel_for(r.ntiles, spec->threads, fill_tile, &r);
+        TRACE_END(TRACE_DETAIL);
+        free(r.sx);
+        free(r.sy);
+        return r.output;
+}
+
+/*
+ * find_source
+ *    Purpose: Works out how the samples can read r->pic: its base and
+ *             steps if it is a UArray2 (whose addresses are affine in the
+ *             column and row), its block storage if it is a UArray2b, or
+ *             else through methods->at
+ */
+static void find_source(struct rotation *r)
+{
+        struct source *s = &r->source;
+        const struct A2Methods_T *methods = r->pic->methods;
+        A2Methods_UArray2 pixels = r->pic->pixels;
+        long nblocks;
+
+        s->layout = SOURCE_AT;
+        if (methods == uarray2_methods_plain) {
+                s->layout    = SOURCE_PLAIN;
+                s->base      = methods->at(pixels, 0, 0);
+                s->col_bytes = r->pic->width > 1
+                               ? (char *)methods->at(pixels, 1, 0) - s->base
+                               : 0;
+                s->row_bytes = r->pic->height > 1
+                               ? (char *)methods->at(pixels, 0, 1) - s->base
+                               : 0;
+        } else if (methods == uarray2_methods_blocked) {
+                s->layout      = SOURCE_BLOCKED;
+                s->base        = UArray2b_blocks(pixels, &s->block_bytes,
+                                                 &nblocks);
+                s->blocksize   = methods->blocksize(pixels);
+                s->blocks_down = (r->pic->height + s->blocksize - 1)
+                                 / s->blocksize;
+        }
+}
+
+/* The source pixel at column x and row y, which must lie in the source */
+static inline const struct Pnm_rgb *source_at(const struct rotation *r,
+                                              int x, int y)
+{
+        const struct source *s = &r->source;
+        int bs = s->blocksize;
+
+        switch (s->layout) {
+        case SOURCE_PLAIN:
+                return (struct Pnm_rgb *)(s->base + x * s->col_bytes
+                                          + y * s->row_bytes);
+        case SOURCE_BLOCKED:
+                return (struct Pnm_rgb *)(s->base
+                                          + ((long)(x / bs) * s->blocks_down
+                                             + y / bs) * s->block_bytes)
+                       + (y % bs) * bs + x % bs;
+        default:
+                return r->pic->methods->at(r->pic->pixels, x, y);
+        }
+}
+
+/*
+ * fill_tile
+ *    Purpose: Computes every output pixel of one tile, a Parallel_for task
+ * Parameters: The tile number (row-major among the tiles), the worker,
+ *             whose row of the scratch arrays sx and sy it uses, and the
+ *             rotation
+ */
+static void fill_tile(int tile, int worker, void *rotation)
+{
+        struct rotation *r = rotation;
+        double *sx = r->sx + (long)worker * r->tile,
+               *sy = r->sy + (long)worker * r->tile;
+        int x0 = tile % r->tiles_across * r->tile,
+            y0 = tile / r->tiles_across * r->tile;
+        int x1 = x0 + r->tile, y1 = y0 + r->tile;
+        double dx = x0 - r->ocx;
+
+        if (x1 > r->methods->width(r->output)) {
+                x1 = r->methods->width(r->output);
+        }
+        if (y1 > r->methods->height(r->output)) {
+                y1 = r->methods->height(r->output);
+        }
+        for (int y = y0; y < y1; y++) {
+                double dy = y - r->ocy;
+                double bx =  r->cos * dx + r->sin * dy + r->icx,
+                       by = -r->sin * dx + r->cos * dy + r->icy;
+                int n = x1 - x0;
+
+                for (int k = 0; k < n; k++) {
+                        sx[k] = bx + k * r->cos;
+                        sy[k] = by - k * r->sin;
+                }
+                if (r->filter == ROTATE_NEAREST) {
+                        for (int k = 0; k < n; k++) {
+                                nearest(r, sx[k], sy[k],
+                                        r->methods->at(r->output, x0 + k,
+                                                       y));
+                        }
+                } else {
+                        for (int k = 0; k < n; k++) {
+                                bilinear(r, sx[k], sy[k],
+                                         r->methods->at(r->output, x0 + k,
+                                                        y));
+                        }
+                }
+        }
+}
+
+/* Whether a point of the source lies on one of its pixels */
+static inline int inside(const struct rotation *r, double x, double y)
+{
+        return x >= -0.5 && y >= -0.5 && x < r->pic->width - 0.5
+               && y < r->pic->height - 0.5;
+}
+
+/* Samples the source pixel nearest a point, or black outside the source */
+static void nearest(const struct rotation *r, double x, double y,
+                    struct Pnm_rgb *to)
+{
+        static const struct Pnm_rgb black = {0, 0, 0};
+
+        if (!inside(r, x, y)) {
+                *to = black;
+                return;
+        }
+        *to = *source_at(r, (int)floor(x + 0.5), (int)floor(y + 0.5));
+}
+
+/*
+ * bilinear
+ *    Purpose: Interpolates the source at a point between the four pixels
+ *             around it, or gives black outside the source. Within half a
+ *             pixel of the edge the missing neighbors are taken to be the
+ *             edge pixels.
+ */
+static void bilinear(const struct rotation *r, double x, double y,
+                     struct Pnm_rgb *to)
+{
+        static const struct Pnm_rgb black = {0, 0, 0};
+        int x0, y0, x1, y1;
+        double fx, fy;
+        const struct Pnm_rgb *p00, *p10, *p01, *p11;
+
+        if (!inside(r, x, y)) {
+                *to = black;
+                return;
+        }
+        x0 = (int)floor(x);
+        y0 = (int)floor(y);
+        fx = x - x0;
+        fy = y - y0;
+        x1 = x0 + 1 < (int)r->pic->width  ? x0 + 1 : x0;
+        y1 = y0 + 1 < (int)r->pic->height ? y0 + 1 : y0;
+        x0 = x0 < 0 ? 0 : x0;
+        y0 = y0 < 0 ? 0 : y0;
+        p00 = source_at(r, x0, y0);
+        p10 = source_at(r, x1, y0);
+        p01 = source_at(r, x0, y1);
+        p11 = source_at(r, x1, y1);
+
+#define LERP2(FIELD) (unsigned)((1 - fy) * ((1 - fx) * p00->FIELD        \
+                                            + fx * p10->FIELD)            \
+                                + fy * ((1 - fx) * p01->FIELD             \
+                                        + fx * p11->FIELD) + 0.5)
+        to->red   = LERP2(red);
+        to->green = LERP2(green);
+        to->blue  = LERP2(blue);
+#undef LERP2
+}
@@ -0,0 +1,42 @@
+/***********************************************************************
+ *                              rotate.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Rotation by any angle, for deskewing scans. coords_calcs.h
+ *          moves whole pixels and so only knows multiples of 90 degrees;
+ *          here every output pixel is instead mapped back into the
+ *          source, and its value is sampled there, either from the
+ *          nearest source pixel or by bilinear interpolation between the
+ *          four around it. The output is the bounding box of the rotated
+ *          image, and its pixels that come from outside the source are
+ *          black.
+ *
+ *          The output is filled one square tile at a time, so the source
+ *          pixels a tile reads (a rotated square of about the same size)
+ *          stay in the cache while it is being filled. When the output is
+ *          blocked, the tiles are its blocks, and a blocked source keeps
+ *          each tile's footprint to a few blocks as well. Tiles are
+ *          handed out to threads by Parallel_for (parallel.h).
+ ***********************************************************************/
+
+#ifndef ROTATE_H
+#define ROTATE_H
+
+#include "a2methods.h"
+#include "pnm.h"
+
+enum Rotate_filter { ROTATE_NEAREST, ROTATE_BILINEAR };
+
+struct Rotate_spec {
+        double degrees;                 /* clockwise, any angle          */
+        enum Rotate_filter filter;
+        int threads;                    /* at least 1                    */
+        int tile;                       /* tile side, 0 for the default  */
+};
+
+void Rotate_size(int width, int height, double degrees, int *out_width,
+                 int *out_height);
+A2Methods_UArray2 Rotate_image(Pnm_ppm pic, A2Methods_T methods,
+                               const struct Rotate_spec *spec);
+
+#endif
@@ -0,0 +1,228 @@
+/***********************************************************************
+ *                              sat.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the summed-area tables in sat.h. The first
+ *          pass leaves each entry holding the sum of its row up to it;
+ *          the second adds those down each column. Every band of the
+ *          first pass and every strip of the second is independent of the
+ *          others, so each is a task of a Parallel_for.
+ ***********************************************************************/
+
+#include <stdlib.h>
+
+#include "assert.h"
+#include "trace.h"
+#include "parallel.h"
+#include "sat.h"
+
+#define T Sat_T
+
+typedef A2Methods_UArray2 A2;
+
+struct T {
+        A2Methods_T methods;
+        A2 sums;                        /* of struct Sat_sums */
+        int width, height;
+};
+
+struct scan {
+        Pnm_ppm pic;
+        T sat;
+        int tile;
+        struct Sat_sums *carry;         /* tile entries per worker */
+};
+
+static void run_pass(struct scan *s, int nbands, int threads,
+                     Parallel_task *pass);
+static void sum_rows(int band, int worker, void *scan);
+static void sum_columns(int strip, int worker, void *scan);
+static struct Sat_sums entry(T sat, int x, int y);
+
+/*
+ * Sat_new
+ *    Purpose: Builds the summed-area table of an image
+ * Parameters: The image, the methods it was read with (also used for the
+ *             table), and the number of threads
+ *    Returns: The table, to be freed with Sat_free
+ *    Expects: pic and methods are nonnull and threads is at least 1
+ *             (checked)
+ */
+T Sat_new(Pnm_ppm pic, A2Methods_T methods, int threads)
+{
+        struct scan s;
+        T sat;
+
+        assert(pic != NULL && methods != NULL && threads >= 1);
+        sat = malloc(sizeof(*sat));
+        assert(sat != NULL);
+        sat->methods = methods;
+        sat->width   = pic->width;
+        sat->height  = pic->height;
+        s.pic  = pic;
+        s.sat  = sat;
+        s.tile = Parallel_tile(methods, pic->pixels);
+        /* blocks of the table line up with those of the image */
+        sat->sums = methods->new_with_blocksize(sat->width, sat->height,
+                                                sizeof(struct Sat_sums),
+                                                s.tile);
+        TRACE_BEGIN(TRACE_DETAIL, "sat rows");
+        run_pass(&s, (sat->height + s.tile - 1) / s.tile, threads,
+                 sum_rows);
+        TRACE_END(TRACE_DETAIL);
+        TRACE_BEGIN(TRACE_DETAIL, "sat columns");
+        run_pass(&s, (sat->width + s.tile - 1) / s.tile, threads,
+                 sum_columns);
+        TRACE_END(TRACE_DETAIL);
+        return sat;
+}
+
+/*
+ * Sat_free
+ *    Purpose: Frees a table and sets *sat to NULL
+ */
+void Sat_free(T *sat)
+{
+        assert(sat != NULL && *sat != NULL);
+        (*sat)->methods->free(&(*sat)->sums);
+        free(*sat);
+        *sat = NULL;
+}
+
+/*
+ * Sat_sum
+ *    Purpose: Sums each channel over a rectangle of the image
+ * Parameters: The table, and the rectangle's top left corner and size
+ *    Returns: The sums
+ *    Expects: The rectangle lies inside the image and is not empty
+ *             (checked)
+ */
+struct Sat_sums Sat_sum(T sat, int x, int y, int width, int height)
+{
+        int x1 = x + width - 1, y1 = y + height - 1;
+        struct Sat_sums sum, left, above, corner;
+
+        assert(sat != NULL);
+        assert(x >= 0 && y >= 0 && width >= 1 && height >= 1
+               && x1 < sat->width && y1 < sat->height);
+        sum    = entry(sat, x1, y1);
+        left   = entry(sat, x - 1, y1);
+        above  = entry(sat, x1, y - 1);
+        corner = entry(sat, x - 1, y - 1);
+        sum.red   = sum.red   - left.red   - above.red   + corner.red;
+        sum.green = sum.green - left.green - above.green + corner.green;
+        sum.blue  = sum.blue  - left.blue  - above.blue  + corner.blue;
+        return sum;
+}
+
+/*
+ * Sat_mean
+ *    Purpose: Averages each channel over a rectangle of the image
+ * Parameters: As for Sat_sum
+ *    Returns: The means, rounded to the nearest integer
+ *    Expects: As for Sat_sum
+ */
+struct Pnm_rgb Sat_mean(T sat, int x, int y, int width, int height)
+{
+        struct Sat_sums sum = Sat_sum(sat, x, y, width, height);
+        uint64_t n = (uint64_t)width * height;
+        struct Pnm_rgb mean;
+
+        mean.red   = (sum.red + n / 2) / n;
+        mean.green = (sum.green + n / 2) / n;
+        mean.blue  = (sum.blue + n / 2) / n;
+        return mean;
+}
+
+/* An entry of the table, or zeros left of or above the image */
+static struct Sat_sums entry(T sat, int x, int y)
+{
+        static const struct Sat_sums zero = {0, 0, 0};
+
+        if (x < 0 || y < 0) {
+                return zero;
+        }
+        return *(struct Sat_sums *)sat->methods->at(sat->sums, x, y);
+}
+
+/* Runs one pass over nbands bands with up to threads threads */
+static void run_pass(struct scan *s, int nbands, int threads,
+                     Parallel_task *pass)
+{
+        int nworkers = Parallel_workers(nbands, threads);
+
+        s->carry = malloc((long)nworkers * s->tile * sizeof(*s->carry));
+        assert(s->carry != NULL);
+        Parallel_for(nbands, threads, pass, s);
+        free(s->carry);
+}
+
+/*
+ * sum_rows
+ *    Purpose: A task of the first pass: stores in each entry of a band of
+ *             tile rows the sums of its row up to it, walking the band a
+ *             tile at a time, left to right
+ */
+static void sum_rows(int band, int worker, void *scan)
+{
+        struct scan *s = scan;
+        A2Methods_T methods = s->sat->methods;
+        struct Sat_sums *carry = s->carry + (long)worker * s->tile;
+        int y0 = band * s->tile;
+        int y1 = y0 + s->tile < s->sat->height ? y0 + s->tile
+                                               : s->sat->height;
+
+        for (int y = y0; y < y1; y++) {
+                carry[y - y0].red   = 0;
+                carry[y - y0].green = 0;
+                carry[y - y0].blue  = 0;
+        }
+        for (int x0 = 0; x0 < s->sat->width; x0 += s->tile) {
+                int x1 = x0 + s->tile < s->sat->width ? x0 + s->tile
+                                                      : s->sat->width;
+                for (int y = y0; y < y1; y++) {
+                        struct Sat_sums *run = &carry[y - y0];
+                        for (int x = x0; x < x1; x++) {
+                                struct Pnm_rgb *p = methods->at(s->pic->pixels,
+                                                                x, y);
+                                run->red   += p->red;
+                                run->green += p->green;
+                                run->blue  += p->blue;
+                                *(struct Sat_sums *)methods->at(
+                                        s->sat->sums, x, y) = *run;
+                        }
+                }
+        }
+}
+
+/*
+ * sum_columns
+ *    Purpose: A task of the second pass: adds the row sums down each
+ *             column of a strip of tile columns, walking the strip top to
+ *             bottom, so that it moves through one tile at a time
+ */
+static void sum_columns(int strip, int worker, void *scan)
+{
+        struct scan *s = scan;
+        A2Methods_T methods = s->sat->methods;
+        struct Sat_sums *carry = s->carry + (long)worker * s->tile;
+        int x0 = strip * s->tile;
+        int x1 = x0 + s->tile < s->sat->width ? x0 + s->tile
+                                              : s->sat->width;
+
+        for (int x = x0; x < x1; x++) {
+                carry[x - x0].red   = 0;
+                carry[x - x0].green = 0;
+                carry[x - x0].blue  = 0;
+        }
+        for (int y = 0; y < s->sat->height; y++) {
+                for (int x = x0; x < x1; x++) {
+                        struct Sat_sums *run = &carry[x - x0];
+                        struct Sat_sums *e = methods->at(s->sat->sums, x, y);
+                        run->red   += e->red;
+                        run->green += e->green;
+                        run->blue  += e->blue;
+                        *e = *run;
+                }
+        }
+}
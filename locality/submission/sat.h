@@ -0,0 +1,44 @@
+/***********************************************************************
+ *                              sat.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Summed-area tables (integral images) of PPM images, for the
+ *          sums and means of rectangles that auto-cropping and exposure
+ *          checks need. Entry (x, y) of the table holds, for each channel,
+ *          the 64-bit sum of every pixel (x', y') with x' <= x and y' <=
+ *          y, so the sum over any rectangle is found from at most four
+ *          entries, in constant time.
+ *
+ *          The table is itself an A2 made with the image's methods suite,
+ *          plain or blocked, and is built through that suite in two
+ *          passes: sums along the rows, then down the columns. Each pass
+ *          runs in bands of rows (or strips of columns) claimed by
+ *          threads, and walks each band one square tile at a time, the
+ *          tiles being the blocks of a blocked image, carrying the running
+ *          sums from one tile to the next.
+ ***********************************************************************/
+
+#ifndef SAT_H
+#define SAT_H
+
+#include <stdint.h>
+#include "a2methods.h"
+#include "pnm.h"
+
+#define T Sat_T
+typedef struct T *T;
+
+struct Sat_sums {
+        uint64_t red, green, blue;
+};
+
+extern T               Sat_new (Pnm_ppm pic, A2Methods_T methods,
+                                int threads);
+extern void            Sat_free(T *sat);
+extern struct Sat_sums Sat_sum (T sat, int x, int y, int width,
+                                int height);
+extern struct Pnm_rgb  Sat_mean(T sat, int x, int y, int width,
+                                int height);
+
+#undef T
+#endif
@@ -0,0 +1,205 @@
+/***********************************************************************
+ *                              scale.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the fused downscale in scale.h.
+ *
+ *          Along each axis, transformed pixel t spans [t s, (t + 1) s) of
+ *          the output, where s is the output size over the input size.
+ *          Since s is at most 1 that span meets at most two output
+ *          pixels, so an axis is described once, before the map, by the
+ *          first output pixel each t meets and the share of t that falls
+ *          in it; the rest falls in the next one. A source pixel then
+ *          adds into at most four sums, and each output pixel is its sum
+ *          divided by the total weight it received.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "assert.h"
+#include "trace.h"
+#include "transform.h"
+#include "scale.h"
+
+typedef A2Methods_UArray2 A2;
+
+/* Ignore slivers of overlap left by rounding */
+#define SHARE_EPSILON 1e-9
+
+struct axis {
+        int *first;             /* first output pixel each input meets */
+        double *share;          /* the share of the input that falls in it */
+};
+
+struct sum {
+        double red, green, blue, weight;
+};
+
+struct scale_closure {
+        struct transform_closure transform;     /* output unused */
+        int width, height;                      /* of the source */
+        int out_width, out_height;
+        struct axis cols, rows;                 /* transformed axes */
+        struct sum *sums;                       /* row-major, output size */
+};
+
+static void make_axis(struct axis *axis, int n, int out_n);
+static void free_axis(struct axis *axis);
+static void accumulate(int i, int j, A2 array, void *elem, void *cl);
+static void add(struct scale_closure *cl, int col, int row, double weight,
+                const struct Pnm_rgb *pixel);
+
+/*
+ * Scale_size
+ *    Purpose: Computes the size of an image scaled by a factor
+ * Parameters: The width and height of the image, the factor, and where to
+ *             put the width and height of the result
+ *    Returns: Nothing; each side is rounded and is at least 1
+ *    Expects: The pointers are nonnull (checked)
+ */
+void Scale_size(int width, int height, double factor, int *out_width,
+                int *out_height)
+{
+        assert(out_width != NULL && out_height != NULL);
+        *out_width  = (int)floor(width * factor + 0.5);
+        *out_height = (int)floor(height * factor + 0.5);
+        if (*out_width < 1) {
+                *out_width = 1;
+        }
+        if (*out_height < 1) {
+                *out_height = 1;
+        }
+}
+
+/*
+ * Scale_transform
+ *    Purpose: Transforms an image and scales it down in one traversal
+ * Parameters: The source image, the rotation or code, the factor, the
+ *             methods the source was read with (also used for the
+ *             output), and the map function to traverse the source
+ *    Returns: The scaled, transformed pixels, to be freed with
+ *             methods->free
+ *    Expects: pic, methods and map are nonnull and the factor is in
+ *             (0, 1] (checked); the rotation is valid (raises
+ *             invalid_parameter otherwise)
+ */
+A2 Scale_transform(Pnm_ppm pic, int rotation, double factor,
+                   A2Methods_T methods, A2Methods_mapfun *map)
+{
+        struct scale_closure cl = {{rotation, methods, NULL, NULL},
+                                   0, 0, 0, 0, {NULL, NULL}, {NULL, NULL},
+                                   NULL};
+        int swap = rotation == 90 || rotation == 270
+                   || rotation == TRANSPOSE_CODE;
+        int tw, th;
+        A2 out;
+
+        assert(pic != NULL && methods != NULL && map != NULL);
+        assert(factor > 0 && factor <= 1);
+        assign_coords_calc(&cl.transform);
+        cl.width  = pic->width;
+        cl.height = pic->height;
+        tw = swap ? cl.height : cl.width;
+        th = swap ? cl.width : cl.height;
+        Scale_size(tw, th, factor, &cl.out_width, &cl.out_height);
+        make_axis(&cl.cols, tw, cl.out_width);
+        make_axis(&cl.rows, th, cl.out_height);
+        cl.sums = calloc((size_t)cl.out_width * cl.out_height,
+                         sizeof(struct sum));
+        assert(cl.sums != NULL);
+
+        TRACE_BEGIN(TRACE_DETAIL, "accumulate");
+        map(pic->pixels, accumulate, &cl);
+        TRACE_END(TRACE_DETAIL);
+
+        out = methods->new(cl.out_width, cl.out_height,
+                           sizeof(struct Pnm_rgb));
+        for (int row = 0; row < cl.out_height; row++) {
+                for (int col = 0; col < cl.out_width; col++) {
+                        struct sum *s = &cl.sums[row * cl.out_width + col];
+                        struct Pnm_rgb *to = methods->at(out, col, row);
+                        to->red   = (unsigned)(s->red / s->weight + 0.5);
+                        to->green = (unsigned)(s->green / s->weight + 0.5);
+                        to->blue  = (unsigned)(s->blue / s->weight + 0.5);
+                }
+        }
+        free(cl.sums);
+        free_axis(&cl.cols);
+        free_axis(&cl.rows);
+        return out;
+}
+
+/* Describes how n input pixels along an axis fall into out_n outputs */
+static void make_axis(struct axis *axis, int n, int out_n)
+{
+        double s = (double)out_n / n;
+
+        axis->first = malloc(n * sizeof(int));
+        axis->share = malloc(n * sizeof(double));
+        assert(axis->first != NULL && axis->share != NULL);
+        for (int t = 0; t < n; t++) {
+                double lo = t * s, hi = (t + 1) * s;
+                int first = (int)floor(lo);
+
+                if (first > out_n - 1) {
+                        first = out_n - 1;
+                }
+                axis->first[t] = first;
+                axis->share[t] = 1;
+                if (first + 1 < out_n && hi > first + 1 + SHARE_EPSILON) {
+                        axis->share[t] = (first + 1 - lo) / (hi - lo);
+                }
+        }
+}
+
+static void free_axis(struct axis *axis)
+{
+        free(axis->first);
+        free(axis->share);
+}
+
+/*
+ * accumulate
+ *    Purpose: Meant to be passed into a map function. Adds a source pixel
+ *             into the output pixels its transformed place covers
+ * Parameters: As for transform, with cl pointing to a scale_closure
+ *    Returns: Nothing
+ *    Expects: The coordinates are in bounds (unchecked)
+ */
+static void accumulate(int i, int j, A2 array, void *elem, void *cl)
+{
+        struct scale_closure *scale = cl;
+        struct Coordinates to = {i, j};
+        int c, r;
+        double cw, rw;
+
+        (void) array;
+        to = scale->transform.coords_calc(scale->height, scale->width,
+                                          scale->transform.amount, to);
+        c  = scale->cols.first[to.col];
+        r  = scale->rows.first[to.row];
+        cw = scale->cols.share[to.col];
+        rw = scale->rows.share[to.row];
+        add(scale, c, r, cw * rw, elem);
+        if (cw < 1) {
+                add(scale, c + 1, r, (1 - cw) * rw, elem);
+        }
+        if (rw < 1) {
+                add(scale, c, r + 1, cw * (1 - rw), elem);
+                if (cw < 1) {
+                        add(scale, c + 1, r + 1, (1 - cw) * (1 - rw), elem);
+                }
+        }
+}
+
+static void add(struct scale_closure *cl, int col, int row, double weight,
+                const struct Pnm_rgb *pixel)
+{
+        struct sum *s = &cl->sums[row * cl->out_width + col];
+
+        s->red    += weight * pixel->red;
+        s->green  += weight * pixel->green;
+        s->blue   += weight * pixel->blue;
+        s->weight += weight;
+}
@@ -0,0 +1,32 @@
+/***********************************************************************
+ *                              scale.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Downscaling fused with the ppmtrans transforms, for making
+ *          thumbnails. Scale_transform maps over the source once, as
+ *          transform_image does, but instead of storing each pixel at its
+ *          transformed place it adds it, weighted by how much of its area
+ *          falls there, into the one to four pixels of the scaled output
+ *          it covers (an area-averaging or "box" filter). The transformed
+ *          image at full size never exists: only the scaled output and
+ *          its running sums do.
+ *
+ *          The factor is the ratio of the output size to the input size,
+ *          at most 1: 0.5 averages 2 by 2 squares of pixels, and a factor
+ *          such as 0.3 that is not one over an integer averages the
+ *          fractional pixels that overlap each output pixel.
+ ***********************************************************************/
+
+#ifndef SCALE_H
+#define SCALE_H
+
+#include "a2methods.h"
+#include "pnm.h"
+
+void Scale_size(int width, int height, double factor, int *out_width,
+                int *out_height);
+A2Methods_UArray2 Scale_transform(Pnm_ppm pic, int rotation, double factor,
+                                  A2Methods_T methods,
+                                  A2Methods_mapfun *map);
+
+#endif
@@ -0,0 +1,380 @@
+/***********************************************************************
+ *                              server.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the transform server in server.h. Images are
+ *          read with Ppmio_try_read_header and Ppmio_try_load_raster, so
+ *          that a malformed or oversized request gets an ERR reply instead
+ *          of an uncaught exception that would take the whole server
+ *          down. A reply is encoded into memory first, since its length
+ *          goes in front of it.
+ *
+ *          QUIT shuts the listening socket down, which wakes every thread
+ *          still waiting in accept().
+ ***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "assert.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "pnm.h"
+#include "ppmio.h"
+#include "storage.h"
+#include "trace.h"
+#include "transform.h"
+#include "server.h"
+
+/* Request times for one phase, in milliseconds */
+struct phase_stats {
+        long count;
+        double total, min, max;
+};
+
+enum { READ, TRANSFORM, WRITE, TOTAL, NPHASES };
+static const char *phase_names[NPHASES] = {
+        "read", "transform", "write", "total"
+};
+
+struct server {
+        int listener;
+        volatile int stopping;
+        pthread_mutex_t lock;           /* guards everything below */
+        long requests, errors;
+        struct phase_stats phases[NPHASES];
+};
+
+static void  *serve(void *server);
+static void   serve_connection(struct server *s, int fd);
+static int    handle_transform(struct server *s, char *args, FILE *in,
+                               FILE *out);
+static Pnm_ppm read_image(FILE *in, A2Methods_T methods,
+                          const char **error);
+static int    parse_transform(const char *what, const char *layout,
+                              int *rotation, A2Methods_T *methods,
+                              A2Methods_mapfun **map);
+static void   send_payload(FILE *out, const char *payload, size_t bytes);
+static void   send_stats(struct server *s, FILE *out);
+static void   record(struct server *s, const double *times, int failed);
+static double now_ms(void);
+
+/*
+ * Server_run
+ *    Purpose: Serves transform requests on a Unix domain socket until a
+ *             client sends QUIT
+ * Parameters: The path to bind the socket to, replacing any stale socket
+ *             there, and how many connections to serve at once
+ *    Returns: EXIT_SUCCESS after QUIT, EXIT_FAILURE if the socket could
+ *             not be set up
+ *    Expects: threads >= 1 (checked)
+ */
+int Server_run(const char *socket_path, int threads)
+{
+        struct server s;
+        struct sockaddr_un addr;
+        pthread_t *pool;
+
+        assert(threads >= 1);
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+                fprintf(stderr, "Socket path too long: %s\n", socket_path);
+                return EXIT_FAILURE;
+        }
+        strcpy(addr.sun_path, socket_path);
+        s.listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(socket_path);
+        if (s.listener < 0
+            || bind(s.listener, (struct sockaddr *)&addr, sizeof(addr)) < 0
+            || listen(s.listener, 16 * threads) < 0) {
+                perror(socket_path);
+                return EXIT_FAILURE;
+        }
+
+        /* a client that hangs up mid-reply must not kill the server */
+        signal(SIGPIPE, SIG_IGN);
+        Storage_set_pool(2 * threads);
+        s.stopping = 0;
+        s.requests = 0;
+        s.errors   = 0;
+        memset(s.phases, 0, sizeof(s.phases));
+        pthread_mutex_init(&s.lock, NULL);
+
+        pool = malloc(threads * sizeof(pthread_t));
+        assert(pool != NULL);
+        for (int i = 0; i < threads; i++) {
+                pthread_create(&pool[i], NULL, serve, &s);
+        }
+        for (int i = 0; i < threads; i++) {
+                pthread_join(pool[i], NULL);
+        }
+
+        free(pool);
+        close(s.listener);
+        unlink(socket_path);
+        pthread_mutex_destroy(&s.lock);
+        Storage_set_pool(0);
+        return EXIT_SUCCESS;
+}
+
+/*
+ * serve
+ *    Purpose: Pool thread. Accepts and serves connections until QUIT.
+ */
+static void *serve(void *server)
+{
+        struct server *s = server;
+
+        while (!s->stopping) {
+                struct timeval timeout = { SERVER_TIMEOUT, 0 };
+                int fd = accept(s->listener, NULL, NULL);
+                if (fd < 0) {
+                        if (errno == EINTR || errno == ECONNABORTED) {
+                                continue;
+                        }
+                        break;
+                }
+                /* reads that wait longer fail, as at end of file */
+                setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                           sizeof(timeout));
+                serve_connection(s, fd);
+        }
+        return NULL;
+}
+
+/*
+ * serve_connection
+ *    Purpose: Answers the requests on one connection until the client
+ *             hangs up, sends QUIT, or sends an inline image that cannot
+ *             be read
+ */
+static void serve_connection(struct server *s, int fd)
+{
+        FILE *in  = fdopen(fd, "r");
+        FILE *out = fdopen(dup(fd), "w");
+        char line[SERVER_MAX_LINE];
+
+        assert(in != NULL && out != NULL);
+        while (fgets(line, sizeof(line), in) != NULL) {
+                line[strcspn(line, "\r\n")] = '\0';
+                if (strncmp(line, "TRANSFORM ", 10) == 0) {
+                        if (!handle_transform(s, line + 10, in, out)) {
+                                break;
+                        }
+                } else if (strcmp(line, "STATS") == 0) {
+                        send_stats(s, out);
+                } else if (strcmp(line, "QUIT") == 0) {
+                        s->stopping = 1;
+                        shutdown(s->listener, SHUT_RDWR);
+                        send_payload(out, "", 0);
+                        break;
+                } else {
+                        fprintf(out, "ERR unknown request\n");
+                        fflush(out);
+                }
+        }
+        fclose(out);
+        fclose(in);
+}
+
+/*
+ * handle_transform
+ *    Purpose: Answers one TRANSFORM request and records its times
+ * Parameters: The server, the text after "TRANSFORM ", and the connection
+ *    Returns: 0 if the connection must be closed, 1 otherwise
+ */
+static int handle_transform(struct server *s, char *args, FILE *in,
+                            FILE *out)
+{
+        char what[32], layout[16], source[SERVER_MAX_LINE];
+        int rotation;
+        A2Methods_T methods;
+        A2Methods_mapfun *map;
+        Pnm_ppm pic;
+        double times[NPHASES], start = now_ms(), t;
+        char *payload = NULL;
+        size_t bytes = 0;
+        const char *error;
+
+        TRACE_SCOPE(TRACE_DETAIL, "request");
+        if (sscanf(args, "%31s %15s %4095s", what, layout, source) != 3
+            || !parse_transform(what, layout, &rotation, &methods, &map)) {
+                fprintf(out, "ERR bad transform request\n");
+                fflush(out);
+                record(s, NULL, 1);
+                /* an inline image may follow, and could not be skipped */
+                return 0;
+        }
+
+        if (strcmp(source, "-") == 0) {
+                pic = read_image(in, methods, &error);
+        } else {
+                FILE *image = fopen(source, "rb");
+                error = "could not read a P6 image";
+                pic = image == NULL ? NULL
+                                    : read_image(image, methods, &error);
+                if (image != NULL) {
+                        fclose(image);
+                }
+        }
+        if (pic == NULL) {
+                fprintf(out, "ERR %s from %s\n", error, source);
+                fflush(out);
+                record(s, NULL, 1);
+                return strcmp(source, "-") != 0;
+        }
+        t = now_ms();
+        times[READ] = t - start;
+
+        struct Pnm_ppm result = { 0, 0, pic->denominator,
+                                  transform_image(pic, rotation, methods,
+                                                  map),
+                                  methods };
+        result.width  = methods->width(result.pixels);
+        result.height = methods->height(result.pixels);
+        Ppmio_free(&pic);
+        times[TRANSFORM] = now_ms() - t;
+        t = now_ms();
+
+        FILE *encoded = open_memstream(&payload, &bytes);
+        assert(encoded != NULL);
+        Ppmio_store(encoded, &result);
+        fclose(encoded);
+        methods->free(&result.pixels);
+        send_payload(out, payload, bytes);
+        free(payload);
+        times[WRITE] = now_ms() - t;
+        times[TOTAL] = now_ms() - start;
+        record(s, times, 0);
+        return 1;
+}
+
+/*
+ * read_image
+ *    Purpose: Reads the image of a request, refusing one of more than
+ *             SERVER_MAX_PIXELS pixels before allocating anything for it
+ * Parameters: The input, the methods for the pixel array, and where to put
+ *             the reason if the image is not read
+ *    Returns: The image, to be freed with Ppmio_free, or NULL
+ */
+static Pnm_ppm read_image(FILE *in, A2Methods_T methods, const char **error)
+{
+        struct Ppmio_header h;
+
+        *error = "could not read a P6 image";
+        if (!Ppmio_try_read_header(in, &h)) {
+                return NULL;
+        }
+        if ((long)h.width * h.height > SERVER_MAX_PIXELS) {
+                *error = "image too large";
+                return NULL;
+        }
+        return Ppmio_try_load_raster(in, &h, methods);
+}
+
+/*
+ * parse_transform
+ *    Purpose: Turns the <what> and <layout> words of a request into a
+ *             rotation or code and the methods and map to apply it with
+ *    Returns: 1 if both words are valid, 0 otherwise
+ */
+static int parse_transform(const char *what, const char *layout,
+                           int *rotation, A2Methods_T *methods,
+                           A2Methods_mapfun **map)
+{
+        int found = transform_from_name(what, rotation);
+
+        if (strcmp(layout, "row") == 0) {
+                *methods = uarray2_methods_plain;
+                *map     = (*methods)->map_row_major;
+        } else if (strcmp(layout, "col") == 0) {
+                *methods = uarray2_methods_plain;
+                *map     = (*methods)->map_col_major;
+        } else if (strcmp(layout, "block") == 0) {
+                *methods = uarray2_methods_blocked;
+                *map     = (*methods)->map_block_major;
+        } else {
+                return 0;
+        }
+        return found && *map != NULL;
+}
+
+/* Sends an OK reply with its payload */
+static void send_payload(FILE *out, const char *payload, size_t bytes)
+{
+        fprintf(out, "OK %zu\n", bytes);
+        fwrite(payload, 1, bytes, out);
+        fflush(out);
+}
+
+/*
+ * send_stats
+ *    Purpose: Answers STATS with the request counts and, for each phase,
+ *             the number of requests timed and their total, mean, fastest
+ *             and slowest times in milliseconds
+ */
+static void send_stats(struct server *s, FILE *out)
+{
+        char *text = NULL;
+        size_t bytes = 0;
+        FILE *report = open_memstream(&text, &bytes);
+
+        assert(report != NULL);
+        pthread_mutex_lock(&s->lock);
+        fprintf(report, "requests: %ld\nerrors: %ld\n", s->requests,
+                s->errors);
+        fprintf(report, "%-10s %8s %12s %10s %10s %10s\n", "phase", "count",
+                "total ms", "mean ms", "min ms", "max ms");
+        for (int i = 0; i < NPHASES; i++) {
+                struct phase_stats *p = &s->phases[i];
+                fprintf(report, "%-10s %8ld %12.3f %10.3f %10.3f %10.3f\n",
+                        phase_names[i], p->count, p->total,
+                        p->count > 0 ? p->total / p->count : 0.0, p->min,
+                        p->max);
+        }
+        pthread_mutex_unlock(&s->lock);
+        fclose(report);
+        send_payload(out, text, bytes);
+        free(text);
+}
+
+/* Adds one request, and its phase times unless it failed, to the stats */
+static void record(struct server *s, const double *times, int failed)
+{
+        pthread_mutex_lock(&s->lock);
+        s->requests++;
+        if (failed) {
+                s->errors++;
+        } else {
+                for (int i = 0; i < NPHASES; i++) {
+                        struct phase_stats *p = &s->phases[i];
+                        if (p->count == 0 || times[i] < p->min) {
+                                p->min = times[i];
+                        }
+                        if (times[i] > p->max) {
+                                p->max = times[i];
+                        }
+                        p->total += times[i];
+                        p->count++;
+                }
+        }
+        pthread_mutex_unlock(&s->lock);
+}
+
+/* Milliseconds on the monotonic clock */
+static double now_ms(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
@@ -0,0 +1,55 @@
+/***********************************************************************
+ *                              server.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Interface to the server mode of ppmtrans, a long-running
+ *          process that answers transform requests on a Unix domain
+ *          socket, so that a stream of small images pays for process
+ *          startup, thread creation and fresh pages once instead of once
+ *          per image. ppmclient is the bundled client.
+ *
+ *          A fixed pool of threads waits in accept() on the socket; each
+ *          serves one connection at a time, and a connection may carry
+ *          any number of requests. Freed pixel arrays go to the storage
+ *          pool (storage.h) for the next request to reuse.
+ *
+ *          So that no client can take a pool thread for good, an image
+ *          of more than SERVER_MAX_PIXELS pixels is refused before its
+ *          arrays are allocated, and a connection that sends nothing for
+ *          SERVER_TIMEOUT seconds, whether between requests or in the
+ *          middle of an inline image, is closed.
+ *
+ *          The protocol is a text line per request, answered by a text
+ *          line and, on success, a payload of the given length:
+ *
+ *          TRANSFORM <what> <layout> <source>\n
+ *                  what:   rotate0, rotate90, rotate180, rotate270,
+ *                          transpose, fliph or flipv
+ *                  layout: row, col or block (the map, as for -row-major)
+ *                  source: "-" if a P6 image follows the line, otherwise
+ *                          the path of one the server can open
+ *          STATS\n         per-phase request times since startup
+ *          QUIT\n          stops the server once open requests finish
+ *
+ *          OK <bytes>\n<payload>   the transformed P6 image or the stats
+ *          ERR <message>\n         the request failed; if the request
+ *                                  line was bad or its inline image
+ *                                  could not be read, the connection
+ *                                  is then closed, since the rest of
+ *                                  the stream cannot be trusted
+ ***********************************************************************/
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#define SERVER_MAX_LINE 4096
+
+/* Largest image served: 64M pixels, or 768MB of struct Pnm_rgb */
+#define SERVER_MAX_PIXELS (64L * 1024 * 1024)
+
+/* Seconds a connection may send nothing before it is closed */
+#define SERVER_TIMEOUT 30
+
+int Server_run(const char *socket_path, int threads);
+
+#endif
@@ -0,0 +1,358 @@
+/***********************************************************************
+ *                              storage.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the aligned, optionally huge-page backed
+ *          storage in storage.h. Small allocations come from
+ *          posix_memalign; large ones from anonymous mmap, which is page
+ *          (and, with MAP_HUGETLB, huge page) aligned and already zeroed.
+ *          Storage_free decides which of the two it is looking at from
+ *          the size alone, so callers must pass the size they allocated.
+ *
+ *          Every large mapping is recorded in a list of live mappings
+ *          with its real length, because a pooled mapping may be longer
+ *          than the request it is reused for. Freed mappings move to the
+ *          pool list while it has room. Both lists are short (one entry
+ *          per image buffer) and guarded by one mutex.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "except.h"
+#include "storage.h"
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0
+#endif
+#ifndef MAP_POPULATE
+#define MAP_POPULATE 0
+#endif
+
+#define SMALL_PAGE    4096
+#define MAX_TOUCHERS  8
+
+struct mapping {
+        char *mem;
+        long length;
+        struct mapping *next;
+};
+
+struct touch_range {
+        char *start, *end;
+};
+
+Except_T Storage_failed = { "Could not allocate array storage" };
+
+static Storage_policy   policy       = STORAGE_THP;
+static Storage_prefault prefault     = STORAGE_NO_PREFAULT;
+static int              pool_limit   = 0;
+static int              pool_size    = 0;
+static struct mapping  *live         = NULL;
+static struct mapping  *pool         = NULL;
+static pthread_mutex_t  lists_lock   = PTHREAD_MUTEX_INITIALIZER;
+
+static void *map_pages(long bytes);
+static void *map_aligned(long bytes, int flags);
+static void *take_from_pool(long bytes);
+static void  record_live(char *mem, long length);
+static void  touch_pages(char *mem, long bytes);
+static void *touch_range(void *range);
+
+/*
+ * Storage_set_policy
+ *    Purpose: Chooses how later large allocations are backed
+ * Parameters: One of the Storage_policy values
+ *    Returns: Nothing
+ */
+void Storage_set_policy(Storage_policy new_policy)
+{
+        policy = new_policy;
+}
+
+/*
+ * Storage_set_prefault
+ *    Purpose: Chooses whether later large allocations are prefaulted, and
+ *             how
+ * Parameters: One of the Storage_prefault values
+ *    Returns: Nothing
+ */
+void Storage_set_prefault(Storage_prefault new_prefault)
+{
+        prefault = new_prefault;
+}
+
+/*
+ * Storage_set_pool
+ *    Purpose: Sets how many freed large allocations are kept for reuse.
+ *             Shrinking the limit releases pooled mappings beyond it.
+ * Parameters: The maximum number of pooled mappings; 0 turns pooling off
+ *    Returns: Nothing
+ */
+void Storage_set_pool(int max_buffers)
+{
+        pthread_mutex_lock(&lists_lock);
+        pool_limit = max_buffers < 0 ? 0 : max_buffers;
+        while (pool_size > pool_limit) {
+                struct mapping *m = pool;
+                pool = m->next;
+                pool_size--;
+                munmap(m->mem, m->length);
+                free(m);
+        }
+        pthread_mutex_unlock(&lists_lock);
+}
+
+/*
+ * Storage_round
+ *    Purpose: How many bytes Storage_alloc will actually reserve for a
+ *             request, which memstats counts as padding
+ * Parameters: The requested size in bytes
+ *    Returns: The size rounded up to a cache line, or to a huge page for
+ *             large allocations
+ */
+long Storage_round(long bytes)
+{
+        long unit = bytes >= STORAGE_HUGE_THRESHOLD ? STORAGE_HUGE_PAGE
+                                                    : STORAGE_ALIGNMENT;
+        return (bytes + unit - 1) / unit * unit;
+}
+
+/*
+ * Storage_alloc
+ *    Purpose: Allocates zero filled, cache line aligned storage
+ * Parameters: The number of bytes needed
+ *    Returns: A pointer to the storage
+ *    Expects: bytes > 0 (checked). Raises Storage_failed if the memory
+ *             cannot be had.
+ */
+void *Storage_alloc(long bytes)
+{
+        void *mem = NULL;
+
+        if (bytes < 1) {
+                RAISE(Storage_failed);
+        }
+        if (bytes >= STORAGE_HUGE_THRESHOLD) {
+                mem = take_from_pool(Storage_round(bytes));
+                if (mem == NULL) {
+                        mem = map_pages(Storage_round(bytes));
+                        record_live(mem, Storage_round(bytes));
+                }
+                return mem;
+        }
+        if (posix_memalign(&mem, STORAGE_ALIGNMENT, Storage_round(bytes))
+            != 0) {
+                RAISE(Storage_failed);
+        }
+        memset(mem, 0, Storage_round(bytes));
+        return mem;
+}
+
+/*
+ * Storage_free
+ *    Purpose: Releases storage from Storage_alloc
+ * Parameters: The storage and the size that was passed to Storage_alloc
+ *    Returns: Nothing
+ *    Expects: bytes is the size originally requested (unchecked)
+ */
+void Storage_free(void *mem, long bytes)
+{
+        if (mem == NULL) {
+                return;
+        }
+        if (bytes < STORAGE_HUGE_THRESHOLD) {
+                free(mem);
+                return;
+        }
+
+        struct mapping **link, *m;
+        pthread_mutex_lock(&lists_lock);
+        for (link = &live; *link != NULL && (*link)->mem != mem;
+             link = &(*link)->next) {
+        }
+        m = *link;
+        if (m == NULL) {                /* not ours; nothing safe to do */
+                pthread_mutex_unlock(&lists_lock);
+                RAISE(Storage_failed);
+        }
+        *link = m->next;
+        if (pool_size < pool_limit) {
+                m->next = pool;
+                pool = m;
+                pool_size++;
+                m = NULL;
+        }
+        pthread_mutex_unlock(&lists_lock);
+        if (m != NULL) {
+                munmap(m->mem, m->length);
+                free(m);
+        }
+}
+
+/*
+ * map_pages
+ *    Purpose: Maps a whole number of huge pages according to the policy.
+ *             If the hugetlbfs pool is empty the request quietly falls back
+ *             to transparent huge pages.
+ */
+static void *map_pages(long bytes)
+{
+        void *mem = MAP_FAILED;
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+        if (prefault == STORAGE_POPULATE) {
+                flags |= MAP_POPULATE;
+        }
+        if (policy == STORAGE_HUGETLB && MAP_HUGETLB != 0) {
+                mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                           flags | MAP_HUGETLB, -1, 0);
+        }
+        if (mem == MAP_FAILED) {
+                /* Populating before the advice would fault in small
+                 * pages, so populate afterwards by touching instead. */
+                mem = map_aligned(bytes, flags & ~MAP_POPULATE);
+#ifdef MADV_HUGEPAGE
+                if (policy != STORAGE_SMALL_PAGES) {
+                        madvise(mem, bytes, MADV_HUGEPAGE);
+                }
+#endif
+                if (prefault == STORAGE_POPULATE) {
+                        touch_pages(mem, bytes);
+                }
+        }
+        if (prefault == STORAGE_TOUCH) {
+                touch_pages(mem, bytes);
+        }
+        return mem;
+}
+
+/*
+ * map_aligned
+ *    Purpose: Maps bytes of ordinary pages starting on a huge page
+ *             boundary, so that the kernel can back every 2MB of it with a
+ *             transparent huge page. Over-maps by one huge page and unmaps
+ *             the slack at either end.
+ *    Expects: bytes is a multiple of STORAGE_HUGE_PAGE (unchecked)
+ */
+static void *map_aligned(long bytes, int flags)
+{
+        char *raw = mmap(NULL, bytes + STORAGE_HUGE_PAGE,
+                         PROT_READ | PROT_WRITE, flags, -1, 0);
+        char *start;
+        long head;
+
+        if (raw == MAP_FAILED) {
+                RAISE(Storage_failed);
+        }
+        head  = (STORAGE_HUGE_PAGE - (long)((unsigned long)raw
+                                            % STORAGE_HUGE_PAGE))
+                % STORAGE_HUGE_PAGE;
+        start = raw + head;
+        if (head > 0) {
+                munmap(raw, head);
+        }
+        munmap(start + bytes, STORAGE_HUGE_PAGE - head);
+        return start;
+}
+
+/*
+ * take_from_pool
+ *    Purpose: Removes and returns the smallest pooled mapping that holds
+ *             at least bytes, moving it back to the live list
+ *    Returns: The mapping, or NULL if no pooled mapping is big enough
+ */
+static void *take_from_pool(long bytes)
+{
+        struct mapping **link, **best = NULL, *m;
+
+        pthread_mutex_lock(&lists_lock);
+        for (link = &pool; *link != NULL; link = &(*link)->next) {
+                if ((*link)->length >= bytes
+                    && (best == NULL || (*link)->length < (*best)->length)) {
+                        best = link;
+                }
+        }
+        if (best == NULL) {
+                pthread_mutex_unlock(&lists_lock);
+                return NULL;
+        }
+        m = *best;
+        *best = m->next;
+        pool_size--;
+        m->next = live;
+        live = m;
+        pthread_mutex_unlock(&lists_lock);
+        return m->mem;
+}
+
+/*
+ * record_live
+ *    Purpose: Adds a new mapping to the live list so that Storage_free can
+ *             find its length
+ */
+static void record_live(char *mem, long length)
+{
+        struct mapping *m = malloc(sizeof(*m));
+
+        if (m == NULL) {
+                RAISE(Storage_failed);
+        }
+        m->mem    = mem;
+        m->length = length;
+        pthread_mutex_lock(&lists_lock);
+        m->next = live;
+        live = m;
+        pthread_mutex_unlock(&lists_lock);
+}
+
+/*
+ * touch_pages
+ *    Purpose: Takes the first-touch page faults of a new mapping now, by
+ *             writing one byte of every page. The range is split between
+ *             up to MAX_TOUCHERS threads, one per online CPU, so that the
+ *             kernel can zero pages on several cores at once.
+ *    Expects: mem is page aligned and bytes is a multiple of SMALL_PAGE
+ *             (unchecked)
+ */
+static void touch_pages(char *mem, long bytes)
+{
+        pthread_t threads[MAX_TOUCHERS];
+        int started[MAX_TOUCHERS] = { 0 };
+        struct touch_range ranges[MAX_TOUCHERS];
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        int n = cpus < 1 ? 1 : cpus > MAX_TOUCHERS ? MAX_TOUCHERS : cpus;
+        long pages = bytes / SMALL_PAGE;
+
+        for (int i = 0; i < n; i++) {
+                ranges[i].start = mem + pages * i / n * SMALL_PAGE;
+                ranges[i].end   = mem + pages * (i + 1) / n * SMALL_PAGE;
+        }
+        for (int i = 1; i < n; i++) {
+                started[i] = pthread_create(&threads[i], NULL, touch_range,
+                                            &ranges[i]) == 0;
+                if (!started[i]) {
+                        touch_range(&ranges[i]);   /* do it ourselves */
+                }
+        }
+        touch_range(&ranges[0]);
+        for (int i = 1; i < n; i++) {
+                if (started[i]) {
+                        pthread_join(threads[i], NULL);
+                }
+        }
+}
+
+/* Thread body for touch_pages: write a zero to each page of the range */
+static void *touch_range(void *range)
+{
+        struct touch_range *r = range;
+
+        for (volatile char *p = r->start; p < r->end; p += SMALL_PAGE) {
+                *p = 0;
+        }
+        return NULL;
+}
@@ -0,0 +1,54 @@
+/***********************************************************************
+ *                              storage.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Interface for the raw element storage behind UArray2 and
+ *          UArray2b. Every allocation starts on a cache line. Allocations
+ *          of at least STORAGE_HUGE_THRESHOLD bytes are mapped directly
+ *          and rounded up to whole 2MB huge pages, and depending on the
+ *          huge page policy are backed by transparent huge pages
+ *          (madvise) or by the hugetlbfs pool (MAP_HUGETLB), so that a
+ *          column-strided walk over a large image needs far fewer TLB
+ *          entries. Storage is always zero filled, like Hanson's UArray,
+ *          except when it comes from the pool (below).
+ *
+ *          Large allocations can also be prefaulted, so that the page
+ *          faults of first touch are taken when the array is created
+ *          rather than inside a timed transform: either the kernel fills
+ *          the mapping (MAP_POPULATE) or several threads touch its pages
+ *          in parallel.
+ *
+ *          Finally, freed large allocations can be kept in a pool and
+ *          handed out again to any later request they are big enough for,
+ *          so a process that handles many images stops paying for fresh
+ *          pages. Pooled storage is NOT zeroed again: only enable the pool
+ *          when every array is completely written before it is read.
+ ***********************************************************************/
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#define STORAGE_ALIGNMENT       64                  /* cache line   */
+#define STORAGE_HUGE_PAGE       (2L * 1024 * 1024)  /* x86-64 huge  */
+#define STORAGE_HUGE_THRESHOLD  (4L * 1024 * 1024)
+
+typedef enum {
+        STORAGE_SMALL_PAGES,    /* plain mmap, no advice                */
+        STORAGE_THP,            /* mmap + madvise(MADV_HUGEPAGE)        */
+        STORAGE_HUGETLB         /* MAP_HUGETLB, falling back to THP     */
+} Storage_policy;
+
+typedef enum {
+        STORAGE_NO_PREFAULT,
+        STORAGE_POPULATE,       /* MAP_POPULATE                         */
+        STORAGE_TOUCH           /* parallel first touch                 */
+} Storage_prefault;
+
+void  Storage_set_policy(Storage_policy policy);
+void  Storage_set_prefault(Storage_prefault prefault);
+void  Storage_set_pool(int max_buffers);
+void *Storage_alloc(long bytes);
+void  Storage_free (void *mem, long bytes);
+long  Storage_round(long bytes);
+
+#endif
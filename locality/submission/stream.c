@@ -0,0 +1,238 @@
+/***********************************************************************
+ *                              stream.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the frame pipeline in stream.h. It has the
+ *          same shape as the band pipeline of pipeline.c, one level up:
+ *
+ *              empty --> decoder --> full --> workers --> done --> encoder
+ *                ^                                                    |
+ *                +----------------------------------------------------+
+ *
+ *          Workers may finish frames out of order, so the encoder parks
+ *          early arrivals. No more frames are in flight than there are
+ *          slots, so a frame can be parked at its sequence number modulo
+ *          the slot count without colliding with another.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "assert.h"
+#include "pnm.h"
+#include "chan.h"
+#include "ppmio.h"
+#include "trace.h"
+#include "transform.h"
+#include "stream.h"
+
+typedef A2Methods_UArray2 A2;
+
+struct frame {
+        int seq;
+        struct Ppmio_header header;     /* of the source                */
+        A2 source, dest;                /* kept across frames when the  */
+        int width, height;              /* ... size stays the same      */
+};
+
+struct stream {
+        const struct Stream_spec *spec;
+        FILE *in, *out;
+        int nslots;
+        int nframes;                    /* written so far */
+        Chan_T empty, full, done;
+};
+
+static void *decode(void *stream);
+static void *work(void *stream);
+static void *encode(void *stream);
+static void  size_frame(const struct Stream_spec *spec, struct frame *f);
+
+/*
+ * Stream_run
+ *    Purpose: Transforms every frame of a stream of binary PPM images
+ * Parameters: The input and output files and the transform to apply
+ *    Returns: The number of frames transformed
+ *    Expects: spec is nonnull with at least one thread (checked). Every
+ *             frame must be a P6 image; raises Ppmio_badformat otherwise.
+ *             An empty input is zero frames, not an error.
+ */
+int Stream_run(FILE *in, FILE *out, const struct Stream_spec *spec)
+{
+        struct stream s;
+        pthread_t decoder, encoder, *workers;
+        struct frame *frames;
+
+        assert(spec != NULL && spec->threads >= 1);
+        s.spec    = spec;
+        s.in      = in;
+        s.out     = out;
+        s.nslots  = spec->threads + 2;  /* one each to decode and encode */
+        s.nframes = 0;
+        frames    = calloc(s.nslots, sizeof(struct frame));
+        workers   = malloc(spec->threads * sizeof(pthread_t));
+        assert(frames != NULL && workers != NULL);
+        s.empty   = Chan_new(s.nslots);
+        s.full    = Chan_new(s.nslots);
+        s.done    = Chan_new(s.nslots);
+        for (int i = 0; i < s.nslots; i++) {
+                Chan_put(s.empty, &frames[i]);
+        }
+
+        pthread_create(&decoder, NULL, decode, &s);
+        for (int i = 0; i < spec->threads; i++) {
+                pthread_create(&workers[i], NULL, work, &s);
+        }
+        pthread_create(&encoder, NULL, encode, &s);
+        pthread_join(decoder, NULL);
+        for (int i = 0; i < spec->threads; i++) {
+                pthread_join(workers[i], NULL);
+        }
+        Chan_close(s.done);
+        pthread_join(encoder, NULL);
+
+        for (int i = 0; i < s.nslots; i++) {
+                if (frames[i].source != NULL) {
+                        spec->methods->free(&frames[i].source);
+                        spec->methods->free(&frames[i].dest);
+                }
+        }
+        Chan_free(&s.empty);
+        Chan_free(&s.full);
+        Chan_free(&s.done);
+        free(frames);
+        free(workers);
+        return s.nframes;
+}
+
+/*
+ * decode
+ *    Purpose: Decoder thread. Reads frames into recycled slots until the
+ *             input runs out, then closes the "full" channel.
+ */
+static void *decode(void *stream)
+{
+        struct stream *s = stream;
+        A2Methods_T methods = s->spec->methods;
+        unsigned char *row = NULL;
+        long row_capacity = 0;
+        struct frame *f;
+
+        for (int seq = 0; (f = Chan_get(s->empty)) != NULL; seq++) {
+                TRACE_SCOPE(TRACE_DETAIL, "decode frame");
+                if (!Ppmio_read_header(s->in, &f->header)) {
+                        break;
+                }
+                f->seq = seq;
+                size_frame(s->spec, f);
+                if (Ppmio_row_bytes(&f->header) > row_capacity) {
+                        row_capacity = Ppmio_row_bytes(&f->header);
+                        row = realloc(row, row_capacity);
+                        assert(row != NULL);
+                }
+                for (int r = 0; r < f->height; r++) {
+                        Ppmio_read_rows(s->in, &f->header, row, 1);
+                        for (int c = 0; c < f->width; c++) {
+                                Ppmio_to_rgb(&f->header, row,
+                                             methods->at(f->source, c, r), c);
+                        }
+                }
+                Chan_put(s->full, f);
+        }
+        free(row);
+        Chan_close(s->full);
+        return NULL;
+}
+
+/*
+ * work
+ *    Purpose: Transform worker thread. Maps each frame's source into its
+ *             destination until the decoder has finished.
+ */
+static void *work(void *stream)
+{
+        struct stream *s = stream;
+        const struct Stream_spec *spec = s->spec;
+        struct frame *f;
+
+        while ((f = Chan_get(s->full)) != NULL) {
+                TRACE_SCOPE(TRACE_DETAIL, "transform frame");
+                struct transform_closure cl = {spec->rotation, spec->methods,
+                                               f->dest, NULL};
+                assign_coords_calc(&cl);
+                spec->map(f->source, transform, &cl);
+                Chan_put(s->done, f);
+        }
+        return NULL;
+}
+
+/*
+ * encode
+ *    Purpose: Encoder thread. Writes finished frames in order and recycles
+ *             their slots.
+ */
+static void *encode(void *stream)
+{
+        struct stream *s = stream;
+        A2Methods_T methods = s->spec->methods;
+        struct frame **parked = calloc(s->nslots, sizeof(struct frame *));
+        unsigned char *row = NULL;
+        long row_capacity = 0;
+        struct frame *f;
+
+        assert(parked != NULL);
+        while ((f = Chan_get(s->done)) != NULL) {
+                parked[f->seq % s->nslots] = f;
+                while ((f = parked[s->nframes % s->nslots]) != NULL) {
+                        TRACE_SCOPE(TRACE_DETAIL, "encode frame");
+                        struct Ppmio_header h = f->header;
+                        h.width  = methods->width(f->dest);
+                        h.height = methods->height(f->dest);
+                        if (Ppmio_row_bytes(&h) > row_capacity) {
+                                row_capacity = Ppmio_row_bytes(&h);
+                                row = realloc(row, row_capacity);
+                                assert(row != NULL);
+                        }
+                        Ppmio_write_header(s->out, &h);
+                        for (int r = 0; r < h.height; r++) {
+                                for (int c = 0; c < h.width; c++) {
+                                        Ppmio_from_rgb(&h, methods->at(f->dest,
+                                                                       c, r),
+                                                       row, c);
+                                }
+                                Ppmio_write_rows(s->out, &h, row, 1);
+                        }
+                        parked[s->nframes % s->nslots] = NULL;
+                        s->nframes++;
+                        Chan_put(s->empty, f);
+                }
+        }
+        free(row);
+        free(parked);
+        return NULL;
+}
+
+/*
+ * size_frame
+ *    Purpose: Makes sure a slot's arrays fit the frame just read into its
+ *             header, reusing them when the size has not changed
+ */
+static void size_frame(const struct Stream_spec *spec, struct frame *f)
+{
+        A2Methods_T methods = spec->methods;
+        struct Pnm_ppm shape = {f->header.width, f->header.height,
+                                f->header.maxval, NULL, methods};
+
+        if (f->source != NULL && f->width == f->header.width
+            && f->height == f->header.height) {
+                return;
+        }
+        if (f->source != NULL) {
+                methods->free(&f->source);
+                methods->free(&f->dest);
+        }
+        f->width  = f->header.width;
+        f->height = f->header.height;
+        f->source = methods->new(f->width, f->height, sizeof(struct Pnm_rgb));
+        f->dest   = make_a2_out(spec->rotation, methods, &shape);
+}
@@ -0,0 +1,34 @@
+/***********************************************************************
+ *                              stream.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Interface to the stream mode of ppmtrans, which transforms
+ *          every image of a multi-image PPM stream (several P6 images
+ *          concatenated, as in a dump of video frames) instead of only
+ *          the first.
+ *
+ *          Frames are pipelined: a decoder thread reads frame n + 1 while
+ *          transform workers handle frame n and the calling thread writes
+ *          frame n - 1, in order. Each frame travels in a slot that owns
+ *          its source and destination arrays, and slots are recycled, so
+ *          a run of same-size frames allocates nothing after the first
+ *          few frames; a slot only reallocates when the frame size
+ *          changes.
+ ***********************************************************************/
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdio.h>
+#include "a2methods.h"
+
+struct Stream_spec {
+        A2Methods_T methods;    /* layout of both arrays of every frame */
+        A2Methods_mapfun *map;  /* traversal of the source              */
+        int rotation;           /* rotation or code, as in transform.h  */
+        int threads;            /* transform workers, at least 1        */
+};
+
+int Stream_run(FILE *in, FILE *out, const struct Stream_spec *spec);
+
+#endif
@@ -0,0 +1,391 @@
+/***********************************************************************
+ *                              tiled.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the tiled image files in tiled.h. A file
+ *          on disk is loaded by mapping it whole (MAP_PRIVATE, so that
+ *          the array can be written without touching the file) and
+ *          handing the tiles to UArray2b_new_mapped; input that cannot be
+ *          mapped, such as a pipe, is read into a new UArray2b with one
+ *          fread for all the tiles. A blocked image with a matching
+ *          layout is written the same way; any other is gathered a tile
+ *          at a time.
+ ***********************************************************************/
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "assert.h"
+#include "a2blocked.h"
+#include "storage.h"
+#include "trace.h"
+#include "uarray2b_storage.h"
+#include "tiled.h"
+
+Except_T Tiled_badformat = { "Badly formatted tiled image" };
+
+#define MAGIC       "A2TILED\n"
+#define BYTE_ORDER_MARK 0x01020304
+#define VERSION     1
+
+/* The fixed part of the header, as it is on disk */
+struct disk_header {
+        char magic[8];
+        uint32_t byte_order, version;
+        uint32_t width, height, blocksize, elem_size, maxval, ntiles;
+        uint64_t tile_bytes, data_offset;
+};
+
+static int     check_header(const struct disk_header *d,
+                            struct Tiled_header *h, long length);
+static int     check_offsets(const struct Tiled_header *h,
+                             const uint64_t *offsets);
+static long    file_length(FILE *fp);
+static Pnm_ppm load_mapped(FILE *fp, long length);
+static Pnm_ppm load_stream(FILE *fp);
+static Pnm_ppm new_pic(const struct Tiled_header *h, UArray2b_T pixels);
+static void    gather_tile(Pnm_ppm pic, const struct Tiled_header *h,
+                           long tile, unsigned char *bytes);
+
+/*
+ * Tiled_peek
+ *    Purpose: Tells whether fp is at a tiled image, without consuming
+ *             anything, as Ppmio_peek_format does
+ *    Returns: 1 if the input starts with "A2", 0 otherwise
+ *    Expects: As for Ppmio_peek_format
+ */
+int Tiled_peek(FILE *fp)
+{
+        int a = getc(fp), two;
+
+        if (a == EOF) {
+                return 0;
+        }
+        two = getc(fp);
+        if (two != EOF) {
+                ungetc(two, fp);
+        }
+        ungetc(a, fp);
+        return a == 'A' && two == '2';
+}
+
+/*
+ * Tiled_read_header
+ *    Purpose: Reads the header and tile offsets of a tiled image, leaving
+ *             fp at the first tile
+ * Parameters: An open file and the header to fill in
+ *    Returns: Nothing
+ *    Expects: fp holds a tiled image written on a host with the same byte
+ *             order; raises Tiled_badformat otherwise, or if a regular
+ *             file is too short for the tiles its header promises
+ */
+void Tiled_read_header(FILE *fp, struct Tiled_header *h)
+{
+        struct disk_header d;
+        uint64_t offset;
+        long skip;
+
+        assert(fp != NULL && h != NULL);
+        if (fread(&d, sizeof(d), 1, fp) != 1
+            || !check_header(&d, h, file_length(fp))) {
+                RAISE(Tiled_badformat);
+        }
+        /* One offset at a time, so that nothing is sized by the header */
+        for (long k = 0; k < h->ntiles; k++) {
+                if (fread(&offset, sizeof(offset), 1, fp) != 1
+                    || offset != (uint64_t)Tiled_tile_offset(h, k)) {
+                        RAISE(Tiled_badformat);
+                }
+        }
+        skip = h->data_offset - sizeof(d) - h->ntiles * sizeof(offset);
+        while (skip-- > 0) {
+                if (getc(fp) == EOF) {
+                        RAISE(Tiled_badformat);
+                }
+        }
+}
+
+/*
+ * Tiled_tile_offset
+ *    Purpose: Where a tile starts in the file
+ * Parameters: A header from Tiled_read_header and a tile number, in the
+ *             block order of uarray2b_storage.h
+ *    Returns: The file offset of the tile
+ */
+long Tiled_tile_offset(const struct Tiled_header *h, long tile)
+{
+        assert(h != NULL && tile >= 0 && tile < h->ntiles);
+        return h->data_offset + tile * h->tile_bytes;
+}
+
+/*
+ * Tiled_load
+ *    Purpose: Loads a tiled image, mapping it if fp is a regular file
+ * Parameters: An open file at the start of the image
+ *    Returns: The image, whose pixels are a UArray2b of
+ *             uarray2_methods_blocked with the file's blocksize; free it
+ *             with Ppmio_free
+ *    Expects: fp holds a tiled image of struct Pnm_rgb; raises
+ *             Tiled_badformat otherwise. A mapped file is read from its
+ *             start, whatever fp has already consumed.
+ */
+Pnm_ppm Tiled_load(FILE *fp)
+{
+        struct stat st;
+        Pnm_ppm pic;
+
+        assert(fp != NULL);
+        TRACE_BEGIN(TRACE_DETAIL, "tiled load");
+        if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode)) {
+                pic = load_mapped(fp, st.st_size);
+        } else {
+                pic = load_stream(fp);
+        }
+        TRACE_END(TRACE_DETAIL);
+        return pic;
+}
+
+/*
+ * Tiled_write
+ *    Purpose: Writes an image as a tiled file, keeping its blocksize if
+ *             it has one and otherwise using blocks of about 64KB, as
+ *             UArray2b_new_64K_block does
+ * Parameters: An open file and the image
+ *    Returns: Nothing
+ *    Expects: fp and pic are nonnull (checked)
+ */
+void Tiled_write(FILE *fp, Pnm_ppm pic)
+{
+        const struct A2Methods_T *methods;
+        struct Tiled_header h;
+        struct disk_header d;
+        unsigned char *tile;
+        long table_end;
+
+        assert(fp != NULL && pic != NULL);
+        methods = pic->methods;
+        h.width     = pic->width;
+        h.height    = pic->height;
+        h.elem_size = methods->size(pic->pixels);
+        h.maxval    = pic->denominator;
+        h.blocksize = methods->blocksize(pic->pixels);
+        if (h.blocksize <= 1) {
+                h.blocksize = sqrt(64 * 1024 / h.elem_size);
+                h.blocksize = h.blocksize < 1 ? 1 : h.blocksize;
+        }
+        h.ntiles = (long)((h.width + h.blocksize - 1) / h.blocksize)
+                   * ((h.height + h.blocksize - 1) / h.blocksize);
+        h.tile_bytes = UArray2b_block_bytes(h.blocksize, h.elem_size);
+        table_end = sizeof(d) + h.ntiles * sizeof(uint64_t);
+        h.data_offset = (table_end + TILED_ALIGNMENT - 1) / TILED_ALIGNMENT
+                        * TILED_ALIGNMENT;
+
+        memset(&d, 0, sizeof(d));
+        memcpy(d.magic, MAGIC, sizeof(d.magic));
+        d.byte_order  = BYTE_ORDER_MARK;
+        d.version     = VERSION;
+        d.width       = h.width;
+        d.height      = h.height;
+        d.blocksize   = h.blocksize;
+        d.elem_size   = h.elem_size;
+        d.maxval      = h.maxval;
+        d.ntiles      = h.ntiles;
+        d.tile_bytes  = h.tile_bytes;
+        d.data_offset = h.data_offset;
+        fwrite(&d, sizeof(d), 1, fp);
+        for (long k = 0; k < h.ntiles; k++) {
+                uint64_t offset = Tiled_tile_offset(&h, k);
+                fwrite(&offset, sizeof(offset), 1, fp);
+        }
+        for (long k = table_end; k < h.data_offset; k++) {
+                putc(0, fp);
+        }
+
+        TRACE_BEGIN(TRACE_DETAIL, "tiled write");
+        if (methods == uarray2_methods_blocked) {
+                long block_bytes, nblocks;
+                void *blocks = UArray2b_blocks(pic->pixels, &block_bytes,
+                                               &nblocks);
+                if (block_bytes == h.tile_bytes && nblocks == h.ntiles) {
+                        fwrite(blocks, h.tile_bytes, h.ntiles, fp);
+                        TRACE_END(TRACE_DETAIL);
+                        return;
+                }
+        }
+        tile = malloc(h.tile_bytes);
+        assert(tile != NULL);
+        for (long k = 0; k < h.ntiles; k++) {
+                gather_tile(pic, &h, k, tile);
+                fwrite(tile, h.tile_bytes, 1, fp);
+        }
+        free(tile);
+        TRACE_END(TRACE_DETAIL);
+}
+
+/*
+ * check_header
+ *    Purpose: Validates the fixed part of a header and converts it
+ * Parameters: The header as read, the one to fill in, and the length of
+ *             the file from file_length
+ *    Returns: 1 if the header is one this build can load and its offset
+ *             table and tiles fit in the file, 0 otherwise
+ *    Notes: Every size is bounded before it is multiplied, so that a
+ *           hostile header cannot overflow the sums below or
+ *           UArray2b_block_bytes
+ */
+static int check_header(const struct disk_header *d, struct Tiled_header *h,
+                        long length)
+{
+        long blocks_across, blocks_down;
+
+        if (memcmp(d->magic, MAGIC, sizeof(d->magic)) != 0
+            || d->byte_order != BYTE_ORDER_MARK || d->version != VERSION
+            || d->width < 1 || d->height < 1 || d->blocksize < 1
+            || d->width > INT32_MAX || d->height > INT32_MAX
+            || d->blocksize > INT32_MAX
+            || d->elem_size != sizeof(struct Pnm_rgb)
+            || d->maxval < 1 || d->maxval > 65535) {
+                return 0;
+        }
+        /* A tile holds its blocksize squared cells, which is below 2^62 */
+        if (d->ntiles < 1
+            || d->tile_bytes > (uint64_t)(length / d->ntiles)
+            || (uint64_t)d->blocksize * d->blocksize
+                > d->tile_bytes / d->elem_size
+            || d->data_offset > (uint64_t)(length
+                                           - d->ntiles * d->tile_bytes)) {
+                return 0;
+        }
+        h->width     = d->width;
+        h->height    = d->height;
+        h->blocksize = d->blocksize;
+        h->elem_size = d->elem_size;
+        h->maxval    = d->maxval;
+        h->ntiles    = d->ntiles;
+        h->tile_bytes  = d->tile_bytes;
+        h->data_offset = d->data_offset;
+        blocks_across = (h->width + h->blocksize - 1) / h->blocksize;
+        blocks_down   = (h->height + h->blocksize - 1) / h->blocksize;
+        return h->ntiles == blocks_across * blocks_down
+               && h->tile_bytes == UArray2b_block_bytes(h->blocksize,
+                                                        h->elem_size)
+               && h->data_offset % STORAGE_ALIGNMENT == 0
+               && h->data_offset >= (long)(sizeof(*d) + h->ntiles
+                                           * sizeof(uint64_t));
+}
+
+/*
+ * file_length
+ *    Purpose: The most bytes a tiled image in fp can hold
+ *    Returns: The length of fp if it is a regular file; otherwise the most
+ *             a long can hold with room to round a tile up to whole cache
+ *             lines, as UArray2b_block_bytes does
+ */
+static long file_length(FILE *fp)
+{
+        struct stat st;
+
+        if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode)) {
+                return st.st_size;
+        }
+        return LONG_MAX - STORAGE_ALIGNMENT;
+}
+
+/* Whether the tiles lie one after another, as a UArray2b holds them */
+static int check_offsets(const struct Tiled_header *h,
+                         const uint64_t *offsets)
+{
+        for (long k = 0; k < h->ntiles; k++) {
+                if (offsets[k] != (uint64_t)Tiled_tile_offset(h, k)) {
+                        return 0;
+                }
+        }
+        return 1;
+}
+
+/* Tiled_load for a regular file of the given length */
+static Pnm_ppm load_mapped(FILE *fp, long length)
+{
+        struct disk_header d;
+        struct Tiled_header h;
+        char *mapping;
+
+        if (length < (long)sizeof(d)) {
+                RAISE(Tiled_badformat);
+        }
+        mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                       fileno(fp), 0);
+        if (mapping == MAP_FAILED) {
+                return load_stream(fp);
+        }
+        memcpy(&d, mapping, sizeof(d));
+        if (!check_header(&d, &h, length)
+            || !check_offsets(&h, (uint64_t *)(mapping + sizeof(d)))) {
+                munmap(mapping, length);
+                RAISE(Tiled_badformat);
+        }
+        return new_pic(&h, UArray2b_new_mapped(h.width, h.height,
+                                               h.elem_size, h.blocksize,
+                                               mapping, length,
+                                               h.data_offset));
+}
+
+/* Tiled_load for input that cannot be mapped */
+static Pnm_ppm load_stream(FILE *fp)
+{
+        struct Tiled_header h;
+        UArray2b_T pixels;
+        long block_bytes, nblocks;
+        void *blocks;
+
+        Tiled_read_header(fp, &h);
+        pixels = UArray2b_new(h.width, h.height, h.elem_size, h.blocksize);
+        blocks = UArray2b_blocks(pixels, &block_bytes, &nblocks);
+        assert(block_bytes == h.tile_bytes && nblocks == h.ntiles);
+        if (fread(blocks, h.tile_bytes, h.ntiles, fp) != (size_t)h.ntiles) {
+                UArray2b_free(&pixels);
+                RAISE(Tiled_badformat);
+        }
+        return new_pic(&h, pixels);
+}
+
+static Pnm_ppm new_pic(const struct Tiled_header *h, UArray2b_T pixels)
+{
+        Pnm_ppm pic = malloc(sizeof(*pic));
+
+        assert(pic != NULL);
+        pic->width       = h->width;
+        pic->height      = h->height;
+        pic->denominator = h->maxval;
+        pic->pixels      = pixels;
+        pic->methods     = uarray2_methods_blocked;
+        return pic;
+}
+
+/*
+ * gather_tile
+ *    Purpose: Copies the pixels of one tile of an image of any layout into
+ *             a tile buffer, with zeros past the edges
+ */
+static void gather_tile(Pnm_ppm pic, const struct Tiled_header *h,
+                        long tile, unsigned char *bytes)
+{
+        long blocks_down = (h->height + h->blocksize - 1) / h->blocksize;
+        int x0 = tile / blocks_down * h->blocksize;
+        int y0 = tile % blocks_down * h->blocksize;
+
+        memset(bytes, 0, h->tile_bytes);
+        for (int r = 0; r < h->blocksize && y0 + r < h->height; r++) {
+                for (int c = 0; c < h->blocksize && x0 + c < h->width; c++) {
+                        memcpy(bytes + ((long)r * h->blocksize + c)
+                                       * h->elem_size,
+                               pic->methods->at(pic->pixels, x0 + c,
+                                                y0 + r),
+                               h->elem_size);
+                }
+        }
+}
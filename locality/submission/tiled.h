@@ -0,0 +1,57 @@
+/***********************************************************************
+ *                              tiled.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: A tiled image file whose pixels are stored exactly as a
+ *          UArray2b holds them in memory (see uarray2b_storage.h), so
+ *          that loading one is a single mmap with no parsing or
+ *          conversion, and any tile can be read on its own from the
+ *          offset the header gives for it.
+ *
+ *          Layout, every number in the writer's byte order:
+ *
+ *              magic "A2TILED\n"                   8 bytes
+ *              byte order mark 0x01020304          uint32
+ *              version (1)                         uint32
+ *              width, height, blocksize,           uint32 each
+ *              element size, maxval, tiles
+ *              bytes per tile                      uint64
+ *              offset of the first tile            uint64
+ *              file offset of each tile            uint64 each
+ *              zeros up to the first tile, which starts on a multiple
+ *              of TILED_ALIGNMENT
+ *              the tiles, one after another
+ *
+ *          The tiles go in the UArray2b's column-major block order; each
+ *          holds its pixels in row-major order as struct Pnm_rgb, with
+ *          zeros for the cells past the edges of the image, and is
+ *          padded to a whole number of cache lines.
+ ***********************************************************************/
+
+#ifndef TILED_H
+#define TILED_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "except.h"
+#include "pnm.h"
+
+#define TILED_ALIGNMENT 4096
+
+extern Except_T Tiled_badformat;
+
+struct Tiled_header {
+        int width, height, blocksize, elem_size;
+        unsigned maxval;
+        long ntiles;
+        long tile_bytes;
+        long data_offset;               /* of the first tile */
+};
+
+extern int     Tiled_peek (FILE *fp);
+extern void    Tiled_read_header(FILE *fp, struct Tiled_header *h);
+extern long    Tiled_tile_offset(const struct Tiled_header *h, long tile);
+extern Pnm_ppm Tiled_load (FILE *fp);
+extern void    Tiled_write(FILE *fp, Pnm_ppm pic);
+
+#endif
@@ -1,24 +1,115 @@
+/***********************************************************************
+ *                              timing_test.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Sanity check for the CPUTime interface, extended into a small
+ *          memory calibration tool. After the original arithmetic loop it
+ *          measures STREAM-style copy, read, write and strided bandwidth
+ *          and random access latency at working sets that step across
+ *          each cache level and out into main memory.
+ *
+ *          Usage: timing_test [-o calibration_file] [-max-mb n]
+ *
+ *          With -o, the results for the largest working set (the one that
+ *          lives in DRAM) are written in the roofline.h format so that
+ *          ppmtrans -bandwidth can report transforms against them.
+ ***********************************************************************/
+
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include "assert.h"
 #include "cputiming.h"
+#include "roofline.h"
+
+/* Every measurement is repeated until it has touched at least this many
+ * bytes, so that small working sets still run long enough to time. */
+static const double MIN_BYTES_TOUCHED = 512.0 * 1024 * 1024;
+
+/* Stride, in elements, of the strided read. 1024 doubles is 8KB, roughly
+ * the distance between vertically adjacent pixels in a large image. */
+static const long STRIDE = 1024;
+
+/* Smallest working set; each one after it is twice the last */
+static const long MIN_WORKING_SET = 16 * 1024;
+
+static volatile double sink;  /* keeps the compiler from dropping loops */
 
+static void time_arithmetic(CPUTime_T timer);
+static void measure(CPUTime_T timer, long bytes, struct Roofline *r);
+static double time_copy   (CPUTime_T timer, double *a, double *b, long n);
+static double time_read   (CPUTime_T timer, double *a, long n);
+static double time_write  (CPUTime_T timer, double *a, long n);
+static double time_strided(CPUTime_T timer, double *a, long n);
+static double time_latency(CPUTime_T timer, long *chain, long n);
+static long   repeats_for(long bytes);
 
 int
 main(int argc, char *argv[])
 {
-        (void)argc;
-        (void)argv;
+        const char *calibration_name = NULL;
+        long max_mb = 256, max_bytes;
+        struct Roofline r = {0, 0, 0, 0, 0};
+        CPUTime_T timer;
+
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+                        calibration_name = argv[++i];
+                } else if (strcmp(argv[i], "-max-mb") == 0 && i + 1 < argc) {
+                        max_mb = strtol(argv[++i], NULL, 10);
+                } else {
+                        fprintf(stderr, "Usage: %s [-o calibration_file] "
+                                        "[-max-mb n]\n", argv[0]);
+                        exit(1);
+                }
+        }
+        if (max_mb < 1) {
+                max_mb = 1;
+        }
+
+        timer = CPUTime_New();
+        time_arithmetic(timer);
+
+        printf("\n%10s %10s %10s %10s %10s %12s\n", "size", "copy GB/s",
+               "read GB/s", "write GB/s", "strd GB/s", "latency ns");
+        /* doubling from 16KB resolves each cache level's knee on the way
+         * out to DRAM, and the last working set is always max_mb itself */
+        max_bytes = max_mb * 1024 * 1024;
+        for (long bytes = MIN_WORKING_SET; bytes < max_bytes; bytes *= 2) {
+                measure(timer, bytes, &r);
+        }
+        measure(timer, max_bytes, &r);
+
+        if (calibration_name != NULL) {
+                FILE *fp = fopen(calibration_name, "w");
+                if (fp == NULL) {
+                        fprintf(stderr, "Could not open %s\n",
+                                calibration_name);
+                        exit(EXIT_FAILURE);
+                }
+                Roofline_write(fp, &r);
+                fclose(fp);
+        }
+
+        CPUTime_Free(&timer);
+
+        return EXIT_SUCCESS;
+}
+
+/*
+ * time_arithmetic
+ *    Purpose: The original CPUTime sanity check: times a summing loop of
+ *             increasing length.
+ */
+static void time_arithmetic(CPUTime_T timer)
+{
         int i;
         double sum;
-        CPUTime_T timer;
         double time_used;
         const int outerlooptimes = 8;
         int outerct;
         int innerlimit = 1;
 
-        timer = CPUTime_New();
-
-
         for (outerct = 0; outerct < outerlooptimes; outerct++) {
                 sum = 0.0;
                 CPUTime_Start(timer);
@@ -30,8 +121,155 @@ main(int argc, char *argv[])
                         time_used);
                 innerlimit *= 10;
         }
+}
 
-        CPUTime_Free(&timer);
+/*
+ * measure
+ *    Purpose: Runs every kernel on a working set of the given size, prints
+ *             one row of the table and records the results in *r, so that
+ *             after the last call *r holds the largest working set.
+ * Parameters: The timer, the working set size in bytes, the results
+ *    Expects: bytes is a multiple of sizeof(double) (unchecked)
+ */
+static void measure(CPUTime_T timer, long bytes, struct Roofline *r)
+{
+        long n = bytes / sizeof(double);
+        double *a = malloc(bytes), *b = malloc(bytes);
+        long *chain = malloc(n * sizeof(long));
+        assert(a != NULL && b != NULL && chain != NULL);
 
-        return EXIT_SUCCESS;
+        for (long i = 0; i < n; i++) {   /* also takes the page faults */
+                a[i] = i;
+                b[i] = 0;
+        }
+
+        r->copy    = time_copy(timer, a, b, n);
+        r->read    = time_read(timer, a, n);
+        r->write   = time_write(timer, a, n);
+        r->strided = time_strided(timer, a, n);
+        r->latency = time_latency(timer, chain, n);
+
+        printf("%9ldK %10.2f %10.2f %10.2f %10.2f %12.2f\n", bytes / 1024,
+               r->copy, r->read, r->write, r->strided, r->latency);
+
+        free(a);
+        free(b);
+        free(chain);
+}
+
+/*
+ * repeats_for
+ *    Purpose: How many passes over a working set it takes to touch at
+ *             least MIN_BYTES_TOUCHED bytes
+ */
+static long repeats_for(long bytes)
+{
+        long reps = MIN_BYTES_TOUCHED / bytes;
+        return reps < 1 ? 1 : reps;
+}
+
+/* b[i] = a[i]; counts both the read and the write, as STREAM does */
+static double time_copy(CPUTime_T timer, double *a, double *b, long n)
+{
+        long reps = repeats_for(n * sizeof(double));
+
+        CPUTime_Start(timer);
+        for (long rep = 0; rep < reps; rep++) {
+                memcpy(b, a, n * sizeof(double));
+        }
+        double ns = CPUTime_Stop(timer);
+        sink = b[n - 1];
+        return 2.0 * reps * n * sizeof(double) / ns;
+}
+
+static double time_read(CPUTime_T timer, double *a, long n)
+{
+        long reps = repeats_for(n * sizeof(double));
+        double s0 = 0, s1 = 0, s2 = 0, s3 = 0;  /* independent adds */
+
+        CPUTime_Start(timer);
+        for (long rep = 0; rep < reps; rep++) {
+                for (long i = 0; i + 3 < n; i += 4) {
+                        s0 += a[i];
+                        s1 += a[i + 1];
+                        s2 += a[i + 2];
+                        s3 += a[i + 3];
+                }
+        }
+        double ns = CPUTime_Stop(timer);
+        sink = s0 + s1 + s2 + s3;
+        return (double)reps * n * sizeof(double) / ns;
+}
+
+static double time_write(CPUTime_T timer, double *a, long n)
+{
+        long reps = repeats_for(n * sizeof(double));
+
+        CPUTime_Start(timer);
+        for (long rep = 0; rep < reps; rep++) {
+                memset(a, rep & 0xff, n * sizeof(double));
+        }
+        double ns = CPUTime_Stop(timer);
+        sink = a[0];
+        return (double)reps * n * sizeof(double) / ns;
+}
+
+/*
+ * time_strided
+ *    Purpose: Reads every element once, but walks down "columns" STRIDE
+ *             elements apart, the way a column-major pass over a row-major
+ *             image does. Only the bytes actually used are counted.
+ */
+static double time_strided(CPUTime_T timer, double *a, long n)
+{
+        long reps = repeats_for(n * sizeof(double));
+        long stride = n < STRIDE ? 1 : STRIDE;
+        double sum = 0;
+
+        CPUTime_Start(timer);
+        for (long rep = 0; rep < reps; rep++) {
+                for (long start = 0; start < stride; start++) {
+                        for (long i = start; i < n; i += stride) {
+                                sum += a[i];
+                        }
+                }
+        }
+        double ns = CPUTime_Stop(timer);
+        sink = sum;
+        return (double)reps * n * sizeof(double) / ns;
+}
+
+/*
+ * time_latency
+ *    Purpose: Chases pointers around one random cycle through the working
+ *             set (Sattolo's algorithm), so each load depends on the last
+ *             and no prefetcher can guess the next address.
+ *    Returns: Nanoseconds per load
+ */
+static double time_latency(CPUTime_T timer, long *chain, long n)
+{
+        long loads = MIN_BYTES_TOUCHED / 64;
+        long p = 0;
+
+        if (loads > 16 * 1024 * 1024) {
+                loads = 16 * 1024 * 1024;
+        }
+        for (long i = 0; i < n; i++) {
+                chain[i] = i;
+        }
+        srand(40);
+        for (long i = n - 1; i > 0; i--) {
+                long j = ((long)rand() * RAND_MAX + rand()) % i;
+                long tmp = chain[i];
+                chain[i] = chain[j];
+                chain[j] = tmp;
+        }
+
+        CPUTime_Start(timer);
+        for (long i = 0; i < loads; i++) {
+                p = chain[p];
+        }
+        double ns = CPUTime_Stop(timer);
+        sink = p;
+        return ns / loads;
 }
@@ -0,0 +1,315 @@
+/***********************************************************************
+ *                              trace.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the tracing interface in trace.h.
+ *
+ *          Every thread owns a growable array of events and a small stack
+ *          of the regions it currently has open. Trace_begin appends an
+ *          event holding the region name and start tick; Trace_end fills
+ *          in the end tick of the innermost open event. Because events
+ *          are appended in start order and record their depth, the
+ *          nesting can be rebuilt when the buffers are written out.
+ *
+ *          Buffers are chained onto a global list (under a mutex, only
+ *          when a thread records its first event) and written by an
+ *          atexit handler, so threads may finish before the trace does.
+ ***********************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_USE_TSC 1
+#endif
+
+#include "assert.h"
+#include "trace.h"
+
+#define MAX_DEPTH 64
+
+struct event {
+        const char *name;
+        uint64_t start, end;
+        int depth;
+};
+
+struct buffer {
+        struct event *events;
+        long length, capacity;
+        long open[MAX_DEPTH];   /* indices of the currently open events */
+        int depth;
+        int tid;
+        struct buffer *next;
+};
+
+int Trace_enabled = 0;
+
+static char            *trace_name      = NULL;
+static int              chrome_format   = 0;
+static double           ns_per_tick     = 1.0;
+static uint64_t         overhead_ticks  = 0;
+static uint64_t         origin          = 0;
+static struct buffer   *buffers         = NULL;
+static int              next_tid        = 0;
+static pthread_mutex_t  buffers_lock    = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct buffer *my_buffer = NULL;
+
+static uint64_t       ticks(void);
+static uint64_t       monotonic_ns(void);
+static void           calibrate(void);
+static struct buffer *new_buffer(void);
+static void           flush(void);
+static void           write_chrome(FILE *fp);
+static void           write_folded(FILE *fp);
+
+/*
+ * Trace_open
+ *    Purpose: Turns tracing on. Calibrates the clock and the cost of a
+ *             region, and arranges for the trace to be written to filename
+ *             when the program exits.
+ * Parameters: The output file name; a name ending in ".json" produces a
+ *             Chrome trace (chrome://tracing, Perfetto), anything else
+ *             produces folded stacks for flamegraph.pl
+ *    Returns: Nothing
+ *    Expects: filename is nonnull (checked) and Trace_open is called at
+ *             most once, before any other thread starts recording
+ */
+void Trace_open(const char *filename)
+{
+        size_t len;
+
+        assert(filename != NULL);
+        assert(trace_name == NULL);
+        len = strlen(filename);
+        trace_name = malloc(len + 1);
+        assert(trace_name != NULL);
+        memcpy(trace_name, filename, len + 1);
+        chrome_format = len >= 5 && strcmp(filename + len - 5, ".json") == 0;
+
+        calibrate();
+        origin = ticks();
+        Trace_enabled = 1;
+        atexit(flush);
+}
+
+/*
+ * Trace_begin
+ *    Purpose: Opens a region in the calling thread
+ * Parameters: The region name, which must outlive the program (a string
+ *             literal)
+ *    Returns: Nothing
+ *    Expects: Regions nest no deeper than MAX_DEPTH (checked)
+ */
+void Trace_begin(const char *name)
+{
+        struct buffer *b = my_buffer;
+
+        if (b == NULL) {
+                b = my_buffer = new_buffer();
+        }
+        assert(b->depth < MAX_DEPTH);
+        if (b->length == b->capacity) {
+                b->capacity *= 2;
+                b->events = realloc(b->events,
+                                    b->capacity * sizeof(struct event));
+                assert(b->events != NULL);
+        }
+        struct event *e = &b->events[b->length];
+        e->name  = name;
+        e->depth = b->depth;
+        b->open[b->depth++] = b->length++;
+        e->end   = 0;
+        e->start = ticks();
+}
+
+/*
+ * Trace_end
+ *    Purpose: Closes the innermost open region of the calling thread
+ *    Returns: Nothing
+ *    Expects: A region is open (checked)
+ */
+void Trace_end(void)
+{
+        uint64_t now = ticks();
+        struct buffer *b = my_buffer;
+
+        assert(b != NULL && b->depth > 0);
+        b->events[b->open[--b->depth]].end = now;
+}
+
+/*
+ * Trace_scope_end
+ *    Purpose: Cleanup function behind TRACE_SCOPE; closes the region if
+ *             TRACE_SCOPE opened one
+ */
+void Trace_scope_end(int *opened)
+{
+        if (*opened) {
+                Trace_end();
+        }
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+ *     Clock
+ * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static uint64_t ticks(void)
+{
+#ifdef TRACE_USE_TSC
+        return __rdtsc();
+#else
+        return monotonic_ns();
+#endif
+}
+
+static uint64_t monotonic_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * calibrate
+ *    Purpose: Works out how long a tick is, by comparing the TSC against
+ *             CLOCK_MONOTONIC_RAW over about 10ms, and how many ticks an
+ *             empty begin/end pair costs, which is later subtracted from
+ *             every region.
+ */
+static void calibrate(void)
+{
+        const int pairs = 1000;
+        uint64_t t0 = monotonic_ns(), c0 = ticks(), t1, c1;
+
+        do {
+                t1 = monotonic_ns();
+        } while (t1 - t0 < 10000000);
+        c1 = ticks();
+        ns_per_tick = (double)(t1 - t0) / (double)(c1 - c0);
+
+        c0 = ticks();
+        for (int i = 0; i < pairs; i++) {
+                Trace_begin("calibration");
+                Trace_end();
+        }
+        c1 = ticks();
+        overhead_ticks = (c1 - c0) / pairs;
+        my_buffer->length = 0;          /* forget the calibration events */
+}
+
+/* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+ *     Buffers and output
+ * - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
+
+static struct buffer *new_buffer(void)
+{
+        struct buffer *b = malloc(sizeof(*b));
+        assert(b != NULL);
+        b->capacity = 1024;
+        b->length   = 0;
+        b->depth    = 0;
+        b->events   = malloc(b->capacity * sizeof(struct event));
+        assert(b->events != NULL);
+
+        pthread_mutex_lock(&buffers_lock);
+        b->tid  = next_tid++;
+        b->next = buffers;
+        buffers = b;
+        pthread_mutex_unlock(&buffers_lock);
+        return b;
+}
+
+/* Duration of an event in ns, less the measured cost of tracing it */
+static double duration_ns(struct event *e)
+{
+        uint64_t d = e->end - e->start;
+        d = d > overhead_ticks ? d - overhead_ticks : 0;
+        return d * ns_per_tick;
+}
+
+/*
+ * flush
+ *    Purpose: atexit handler that writes every thread's events. Regions
+ *             still open at exit are closed at the time of the flush.
+ */
+static void flush(void)
+{
+        uint64_t now = ticks();
+        FILE *fp = fopen(trace_name, "w");
+
+        Trace_enabled = 0;
+        if (fp == NULL) {
+                fprintf(stderr, "Could not open trace file %s\n", trace_name);
+                return;
+        }
+        for (struct buffer *b = buffers; b != NULL; b = b->next) {
+                while (b->depth > 0) {
+                        b->events[b->open[--b->depth]].end = now;
+                }
+        }
+        if (chrome_format) {
+                write_chrome(fp);
+        } else {
+                write_folded(fp);
+        }
+        fclose(fp);
+}
+
+static void write_chrome(FILE *fp)
+{
+        int first = 1;
+
+        fprintf(fp, "{\"traceEvents\":[\n");
+        for (struct buffer *b = buffers; b != NULL; b = b->next) {
+                for (long i = 0; i < b->length; i++) {
+                        struct event *e = &b->events[i];
+                        fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\","
+                                    "\"pid\":1,\"tid\":%d,"
+                                    "\"ts\":%.3f,\"dur\":%.3f}",
+                                first ? "" : ",\n", e->name, b->tid,
+                                (e->start - origin) * ns_per_tick / 1000,
+                                duration_ns(e) / 1000);
+                        first = 0;
+                }
+        }
+        fprintf(fp, "\n],\"displayTimeUnit\":\"ns\"}\n");
+}
+
+/*
+ * write_folded
+ *    Purpose: Writes one "thread;outer;inner self_ns" line per event, where
+ *             self time excludes the time spent in child regions. Lines
+ *             for the same stack are summed by flamegraph.pl.
+ */
+static void write_folded(FILE *fp)
+{
+        for (struct buffer *b = buffers; b != NULL; b = b->next) {
+                double *self = malloc((b->length + 1) * sizeof(double));
+                long stack[MAX_DEPTH];
+                assert(self != NULL);
+
+                for (long i = 0; i < b->length; i++) {
+                        struct event *e = &b->events[i];
+                        self[i] = duration_ns(e);
+                        stack[e->depth] = i;
+                        if (e->depth > 0) {
+                                self[stack[e->depth - 1]] -= self[i];
+                        }
+                }
+                for (long i = 0; i < b->length; i++) {
+                        struct event *e = &b->events[i];
+                        stack[e->depth] = i;
+                        fprintf(fp, "thread%d", b->tid);
+                        for (int d = 0; d <= e->depth; d++) {
+                                fprintf(fp, ";%s", b->events[stack[d]].name);
+                        }
+                        fprintf(fp, " %.0f\n", self[i] > 0 ? self[i] : 0);
+                }
+                free(self);
+        }
+}
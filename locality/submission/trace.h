@@ -0,0 +1,77 @@
+/***********************************************************************
+ *                              trace.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Low-overhead tracing of named, nested regions; the successor
+ *          to cputiming.h for finding out where a whole run spends its
+ *          time rather than timing one piece of it.
+ *
+ *          Usage:
+ *
+ *          Trace_open("run.json");       (".json" gives a Chrome trace,
+ *                                          anything else folded stacks)
+ *          TRACE_BEGIN(TRACE_PHASE, "transform");
+ *                  ... work, possibly containing more regions ...
+ *          TRACE_END(TRACE_PHASE);
+ *
+ *          or, for a region that lasts until the end of the enclosing
+ *          block,
+ *
+ *          TRACE_SCOPE(TRACE_DETAIL, "UArray2_map_row_major");
+ *
+ *          Each region has a level. Regions above the compile-time
+ *          TRACE_LEVEL (set in the Makefile) compile to nothing, so the
+ *          fine-grained ones cost nothing in a normal build. Regions that
+ *          are compiled in but run before Trace_open, or without it,
+ *          cost one predictable branch.
+ *
+ *          Times come from the TSC on x86 and CLOCK_MONOTONIC_RAW
+ *          elsewhere. The cost of a begin/end pair is measured when the
+ *          trace is opened and subtracted from every region. Each thread
+ *          records into its own buffer; all buffers are written out when
+ *          the program exits.
+ ***********************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+/* Region granularities, coarsest first */
+#define TRACE_PHASE  1          /* ppmtrans phases: read, transform ...  */
+#define TRACE_DETAIL 2          /* map functions and I/O paths           */
+#define TRACE_LOOP   3          /* one region per row, column or block   */
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_PHASE
+#endif
+
+extern int Trace_enabled;
+
+void Trace_open (const char *filename);
+void Trace_begin(const char *name);
+void Trace_end  (void);
+void Trace_scope_end(int *unused);
+
+#define TRACE_BEGIN(level, name) do {                           \
+        if ((level) <= TRACE_LEVEL && Trace_enabled) {          \
+                Trace_begin(name);                              \
+        }                                                       \
+} while (0)
+
+#define TRACE_END(level) do {                                   \
+        if ((level) <= TRACE_LEVEL && Trace_enabled) {          \
+                Trace_end();                                    \
+        }                                                       \
+} while (0)
+
+#define TRACE_CAT_(a, b) a ## b
+#define TRACE_CAT(a, b) TRACE_CAT_(a, b)
+
+/* The region ends when the variable goes out of scope. Only usable with
+ * a compile-time constant level. */
+#define TRACE_SCOPE(level, name)                                          \
+        int TRACE_CAT(trace_scope_, __LINE__)                             \
+                __attribute__((cleanup(Trace_scope_end), unused)) =       \
+                ((level) <= TRACE_LEVEL && Trace_enabled                  \
+                 ? (Trace_begin(name), 1) : 0)
+
+#endif
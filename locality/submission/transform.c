@@ -0,0 +1,228 @@
+/***********************************************************************
+ *                              transform.c
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Implementation of the transform machinery in transform.h,
+ *          moved out of ppmtrans.c so that every mode of ppmtrans can
+ *          share it.
+ ***********************************************************************/
+
+#include <string.h>
+
+#include "transform.h"
+
+typedef A2Methods_UArray2 A2;
+
+Except_T invalid_parameter = {"Invalid Parameter"};
+
+/*
+ * transform
+ *    Purpose: Meant to be passed into a map function. Copies the given
+ *             pixel into the appropriate place in the output array
+ * Parameters: int i and j for the col and row coordinates; an A2 object; a
+ *             void pointer to a pixel in the existing photo; and a void
+ *             pointer to the closure argument
+ *    Returns: Nothing
+ *    Expects: That the A2 is valid and the coordinates are in bounds
+ *             (checked), that the void *elem points to a valid Pnm_rgb struct
+ *             (unchecked), that the void *elem is nonnull (checked), that
+ *             the void *cl is nonnull (checked), and that the void *cl
+ *             points to a valid transform_closure struct (unchecked)
+ */
+void transform(int i, int j, A2 array, void *elem, void *cl) {
+        struct transform_closure *closure = cl;
+        struct Coordinates new_coords = {i, j};
+        struct Pnm_rgb *pixel = elem, *at_p;
+        if (array == NULL || closure == NULL) {
+                RAISE(invalid_parameter);
+        }
+        if (i < 0 || i >= closure->methods->width(array) ||
+            j < 0 || j >= closure->methods->height(array)) {
+                    RAISE(invalid_parameter);
+        }
+
+        new_coords = closure->coords_calc(closure->methods->height(array),
+                             closure->methods->width(array), closure->amount,
+                             new_coords);
+
+        at_p = closure->methods->at(closure->output, new_coords.col,
+                                    new_coords.row);
+        if (pixel == NULL || at_p == NULL) {
+                RAISE(invalid_parameter);
+        }
+        *at_p = *pixel;
+        return;
+}
+
+/*
+ * transform_sample
+ *    Purpose: Meant to be passed into a map function. Like transform, but
+ *             for arrays of any element size, such as the one- and
+ *             two-byte samples of a planar or grayscale image: copies
+ *             methods->size bytes
+ * Parameters: As for transform
+ *    Returns: Nothing
+ *    Expects: The output has the source's element size; the coordinates
+ *             are in bounds (unchecked)
+ */
+void transform_sample(int i, int j, A2 array, void *elem, void *cl)
+{
+        struct transform_closure *closure = cl;
+        A2Methods_T methods = closure->methods;
+        struct Coordinates to = {i, j};
+
+        to = closure->coords_calc(methods->height(array),
+                                  methods->width(array), closure->amount,
+                                  to);
+        memcpy(methods->at(closure->output, to.col, to.row), elem,
+               methods->size(array));
+}
+
+/*
+ * make_a2_out
+ *    Purpose: Creates a new A2 object based on the type of transformation it
+ *             is given. For rotations in the first if statement, these
+ *             transformations are marked by keeping the width and height the
+ *             same in the new A2 object. For the rest of the rotations, the
+ *             width and height parameters must be switched.
+ * Parameters: int rotation, A2Methods_T object, Pnm_ppm object
+ *    Returns: A new A2 object with the new dimensions after the image has
+ *             been transformed.
+ *    Expects: int rotation must be a valid degree or code (checked),
+ *             A2Methods_T object cannot be NULL (checked),
+ *             and Pnm_ppm object also cannot be NULL (checked)
+ */
+A2 make_a2_out(int rotation, A2Methods_T methods, Pnm_ppm pic)
+{
+        if (methods == NULL || pic == NULL) {
+                RAISE(invalid_parameter);
+        }
+        A2 result = NULL;
+        if (rotation % 180 == 0 || rotation == 0 ||
+            rotation == FLIP_HOR_CODE || rotation == FLIP_VER_CODE ) {
+                result = methods->new(pic->width, pic->height, sizeof(struct
+                                      Pnm_rgb));
+        }
+        else if (rotation % 90 == 0 || rotation == TRANSPOSE_CODE) {
+                result = methods->new(pic->height, pic->width,
+                                      sizeof(struct Pnm_rgb));
+        } else {
+                RAISE(invalid_parameter);
+        }
+        return result;
+}
+
+/*
+ * assign_coords_calc
+ *    Purpose: Handles the rotation. Calls the appropriate rotation method
+ *             based on the degrees it gets passed in or the code passed in
+ * Parameters: Closure argument; in this case, a pointer to a struct
+ *    Returns: Nothing
+ *    Expects: The closure argument/struct is valid (unchecked), not NULL
+ *             (checked), and the amount element of the struct must be a valid
+ *             degree or flip code (checked).
+ */
+void assign_coords_calc(struct transform_closure *cl)
+{
+        if (cl == NULL) {
+                RAISE(invalid_parameter);
+        }
+        // need a case to handle null/exception
+        if (cl->amount == 0 || cl->amount % 90 == 0) {
+                cl->coords_calc = rotate_calc;
+        } else if (cl->amount == TRANSPOSE_CODE) {
+                cl->coords_calc = transpose_calc;
+        } else if (cl->amount == FLIP_HOR_CODE) {
+                cl->coords_calc = flip_hor_calc;
+        } else if (cl->amount == FLIP_VER_CODE) {
+                cl->coords_calc = flip_ver_calc;
+        } else {
+                RAISE(invalid_parameter);
+        }
+        return;
+}
+
+/*
+ * transform_image
+ *    Purpose: Applies a whole transform to an image: creates the output
+ *             array and maps over the source with transform
+ * Parameters: The source image, the rotation or code, the methods the
+ *             source was read with, and the map function to traverse it
+ *    Returns: The transformed pixels, which the caller must free with
+ *             methods->free
+ *    Expects: pic, methods and map are nonnull (checked by make_a2_out
+ *             and assign_coords_calc) and the rotation is valid (checked)
+ */
+A2 transform_image(Pnm_ppm pic, int rotation, A2Methods_T methods,
+                   A2Methods_mapfun *map)
+{
+        A2 out = make_a2_out(rotation, methods, pic);
+        struct transform_closure cl = {rotation, methods, out, NULL};
+
+        assign_coords_calc(&cl);
+        map(pic->pixels, transform, &cl);
+        return out;
+}
+
+/*
+ * transform_fanout
+ *    Purpose: Meant to be passed into a map function. Copies the given
+ *             pixel into its place in every output of a fanout_closure
+ * Parameters: As for transform, with cl pointing to a fanout_closure
+ *    Returns: Nothing
+ *    Expects: As for transform; every target shares the source's methods
+ *             (unchecked)
+ */
+void transform_fanout(int i, int j, A2 array, void *elem, void *cl)
+{
+        struct fanout_closure *fanout = cl;
+        struct Pnm_rgb *pixel = elem;
+        int width, height;
+
+        if (array == NULL || fanout == NULL || pixel == NULL
+            || fanout->count < 1) {
+                RAISE(invalid_parameter);
+        }
+        width  = fanout->targets[0].methods->width(array);
+        height = fanout->targets[0].methods->height(array);
+        if (i < 0 || i >= width || j < 0 || j >= height) {
+                RAISE(invalid_parameter);
+        }
+        for (int k = 0; k < fanout->count; k++) {
+                struct transform_closure *t = &fanout->targets[k];
+                struct Coordinates to = {i, j};
+                to = t->coords_calc(height, width, t->amount, to);
+                *(struct Pnm_rgb *)t->methods->at(t->output, to.col,
+                                                  to.row) = *pixel;
+        }
+}
+
+/*
+ * transform_from_name
+ *    Purpose: Looks up a transform by the short name used in output specs
+ *             and server requests: rot0, rot90, rot180, rot270 (or
+ *             rotate0 ... rotate270), transpose, fliph or flipv
+ * Parameters: The name and where to put its rotation or code
+ *    Returns: 1 if the name is known, 0 otherwise
+ */
+int transform_from_name(const char *name, int *rotation)
+{
+        static const struct {
+                const char *name;
+                int rotation;
+        } names[] = {
+                { "rot0", 0 }, { "rot90", 90 }, { "rot180", 180 },
+                { "rot270", 270 }, { "rotate0", 0 }, { "rotate90", 90 },
+                { "rotate180", 180 }, { "rotate270", 270 },
+                { "transpose", TRANSPOSE_CODE }, { "fliph", FLIP_HOR_CODE },
+                { "flipv", FLIP_VER_CODE }
+        };
+
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+                if (strcmp(name, names[i].name) == 0) {
+                        *rotation = names[i].rotation;
+                        return 1;
+                }
+        }
+        return 0;
+}
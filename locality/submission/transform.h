@@ -0,0 +1,59 @@
+/***********************************************************************
+ *                              transform.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: The transform machinery of ppmtrans, shared by its sequential,
+ *          pipelined and batch modes: the codes for the non-rotation
+ *          transforms, the closure passed to the map functions, the apply
+ *          functions that move one pixel or sample, and the helpers that
+ *          size the output array and pick the coordinates calculator.
+ *
+ *          transform_fanout applies several transforms in one traversal:
+ *          each source pixel is read once and stored into every output,
+ *          so N outputs cost one pass over the source instead of N.
+ ***********************************************************************/
+
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "except.h"
+#include "a2methods.h"
+#include "pnm.h"
+#include "coordinates.h"
+#include "coords_calcs.h"
+
+/* Transforms that are not rotations; rotations use their angle */
+#define TRANSPOSE_CODE 1
+#define FLIP_HOR_CODE  2
+#define FLIP_VER_CODE  3
+
+struct transform_closure {
+        int amount;
+        A2Methods_T methods;
+        A2Methods_UArray2 output;
+        struct Coordinates (*coords_calc)(int img_height, int img_width,
+                                          int amount, struct Coordinates c);
+};
+
+/* Closure for transform_fanout: one transform_closure per output */
+struct fanout_closure {
+        int count;
+        struct transform_closure *targets;
+};
+
+extern Except_T invalid_parameter;
+
+void transform(int i, int j, A2Methods_UArray2 array, void *elem, void *cl);
+void transform_sample(int i, int j, A2Methods_UArray2 array, void *elem,
+                      void *cl);
+A2Methods_UArray2 make_a2_out(int rotation, A2Methods_T methods,
+                              Pnm_ppm pic);
+void assign_coords_calc(struct transform_closure *cl);
+A2Methods_UArray2 transform_image(Pnm_ppm pic, int rotation,
+                                  A2Methods_T methods,
+                                  A2Methods_mapfun *map);
+void transform_fanout(int i, int j, A2Methods_UArray2 array, void *elem,
+                      void *cl);
+int  transform_from_name(const char *name, int *rotation);
+
+#endif
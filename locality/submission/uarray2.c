@@ -6,23 +6,46 @@
  *
  * Summary: This file implements the UArray2_T interface described in
  *          UArray2_T.h. It is a 2 dimensional unboxed array.
+ *
+ *          Element (col, row) lives at origin + col * col_stride
+ *          + row * row_stride. A new array is stored row by row, but the
+ *          strides may be anything, negative included, which is what
+ *          lets a flip, rotation, transpose or crop be a new UArray2_T
+ *          over the same elements. The elements belong to a shared,
+ *          reference counted block of storage that is freed with the last
+ *          UArray2_T using it.
  ***********************************************************************/
 
 #include "uarray2.h"
-#include <uarray.h>
+#include "trace.h"
+#include "memstats.h"
+#include "storage.h"
 #include <stdlib.h>
+#include <string.h>
 #include <except.h>
 #include <stdio.h>
 
+/* Element storage shared by an array and every view of it */
+struct storage {
+        char *elems;            /* cache line aligned, see storage.h */
+        long bytes;
+        int refs;               /* updated atomically */
+};
+
 struct UArray2_T {
-        UArray_T arry;
+        struct storage *store;
+        char *origin;           /* element (0, 0)                     */
+        long col_stride;        /* bytes between columns, may be < 0  */
+        long row_stride;        /* bytes between rows, may be < 0     */
         int size, width, height;
 };
         /* Exceptions */
 Except_T Bad_coords = { "Invalid Coordinates" };
 Except_T Bad_array  = {"UArray2 object is not working correctly"};
         /* Private functions */
-int UArray2_coords_to_index(UArray2_T arr, int col, int row);
+static char     *UArray2_address(UArray2_T arr, int col, int row);
+static UArray2_T UArray2_view_of(UArray2_T arr);
+static long      UArray2_bytes(UArray2_T arr);
 
 /*
  * UArray2_new
@@ -45,19 +68,37 @@ UArray2_T UArray2_new(int w, int h, int elem_size)
                 return NULL;
         }
         UArray2_T uarray = malloc(sizeof(struct UArray2_T));
+        if (uarray == NULL) {
+                RAISE(Bad_array);
+        }
+        struct storage *store = malloc(sizeof(struct storage));
+        if (store == NULL) {
+                free(uarray);
+                RAISE(Bad_array);
+        }
 
-        uarray->arry   = UArray_new((h * w), elem_size);
-        uarray->size   = elem_size;
-        uarray->width  = w;
-        uarray->height = h;
+        uarray->size       = elem_size;
+        uarray->width      = w;
+        uarray->height     = h;
+        uarray->col_stride = elem_size;
+        uarray->row_stride = (long)w * elem_size;
+        store->bytes       = UArray2_bytes(uarray);
+        store->elems       = Storage_alloc(store->bytes);
+        store->refs        = 1;
+        uarray->store      = store;
+        uarray->origin     = store->elems;
+        Memstats_alloc(sizeof(struct UArray2_T) + sizeof(struct storage)
+                       + Storage_round(store->bytes),
+                       Storage_round(store->bytes) - store->bytes);
 
         return uarray;
 }
 
 /*
  * UArray2_free
- *    Purpose: Frees all of the heap memory associated with a UArray2_T object
- *             and then sets its address to NULL to prevent further use.
+ *    Purpose: Frees a UArray2_T object and then sets its address to NULL to
+ *             prevent further use. The elements are freed with the last
+ *             array or view sharing them.
  * Parameters: a pointer to a UArray2_T object
  *    Returns: nothing
  *    Expects: That the parameter is a valid, nonnull UArray2 pointer
@@ -67,10 +108,17 @@ void UArray2_free(UArray2_T *arr)
         if (arr == NULL || *arr == NULL) {
                 return;
         }
-        UArray_free(&((*arr)->arry));
-        if ((*arr)->arry != NULL) {
-                RAISE(Bad_array);
+        struct storage *store = (*arr)->store;
+
+        Memstats_free(sizeof(struct UArray2_T));
+        if (__sync_sub_and_fetch(&store->refs, 1) == 0) {
+                Memstats_free(sizeof(struct storage)
+                              + Storage_round(store->bytes));
+                Storage_free(store->elems, store->bytes);
+                free(store);
         }
+        (*arr)->store  = NULL;
+        (*arr)->origin = NULL;
 
         (*arr)->size   = 0;
         (*arr)->width  = 0;
@@ -149,17 +197,10 @@ void *UArray2_at(UArray2_T arr, int col, int row)
         if (arr == NULL) {
                 RAISE(Bad_array);
         }
-        int index;
-        void *return_val;
-        TRY
-                index = UArray2_coords_to_index(arr, col, row);
-                return_val = UArray_at(arr->arry, index);
-        EXCEPT(Bad_coords)
-                RAISE(Bad_coords);
-                return_val = NULL;
-        END_TRY;
-
-        return return_val;
+        /* No TRY here: UArray2_address raises Bad_coords itself, and
+         * Hanson's exception stack is shared by every thread, so a TRY
+         * frame would break the pipeline's concurrent workers. */
+        return UArray2_address(arr, col, row);
 }
 
 /*
@@ -182,10 +223,15 @@ void UArray2_map_row_major(UArray2_T arr, void apply(int col, int row,
                 RAISE(Bad_array);
         }
         int col = 0, row = 0;
+        TRACE_SCOPE(TRACE_DETAIL, "UArray2_map_row_major");
         for (row = 0; row < arr->height; row++) {
+                char *elem = arr->origin + row * arr->row_stride;
+                TRACE_BEGIN(TRACE_LOOP, "row");
                 for (col = 0; col < arr->width; col++) {
-                        apply(col, row, arr, UArray2_at(arr, col, row), cl);
+                        apply(col, row, arr, elem, cl);
+                        elem += arr->col_stride;
                 }
+                TRACE_END(TRACE_LOOP);
         }
 }
 
@@ -209,32 +255,179 @@ void UArray2_map_col_major(UArray2_T arr, void apply(int col, int row,
                 RAISE(Bad_array);
         }
         int col = 0, row = 0;
+        TRACE_SCOPE(TRACE_DETAIL, "UArray2_map_col_major");
         for (col = 0; col < arr->width; col++) {
+                char *elem = arr->origin + col * arr->col_stride;
+                TRACE_BEGIN(TRACE_LOOP, "column");
                 for (row = 0; row < arr->height; row++) {
-                        apply(col, row, arr, UArray2_at(arr, col, row), cl);
+                        apply(col, row, arr, elem, cl);
+                        elem += arr->row_stride;
                 }
+                TRACE_END(TRACE_LOOP);
+        }
+}
+
+/*
+ * UArray2_transpose
+ *    Purpose: Makes a view of an array with rows and columns swapped. No
+ *             elements move: the view swaps the strides.
+ * Parameters: A UArray2_T object
+ *    Returns: A new UArray2_T sharing the elements of arr, to be freed with
+ *             UArray2_free like any other
+ *    Expects: That the UArray2_T object is valid (checked)
+ */
+UArray2_T UArray2_transpose(UArray2_T arr)
+{
+        UArray2_T view = UArray2_view_of(arr);
+        long stride = view->col_stride;
+
+        view->width      = arr->height;
+        view->height     = arr->width;
+        view->col_stride = view->row_stride;
+        view->row_stride = stride;
+        return view;
+}
+
+/*
+ * UArray2_flip_horizontal
+ *    Purpose: Makes a mirror image view of an array, left to right, by
+ *             starting at the last column and negating the column stride
+ * Parameters: A UArray2_T object
+ *    Returns: A new view of arr, as for UArray2_transpose
+ *    Expects: That the UArray2_T object is valid (checked)
+ */
+UArray2_T UArray2_flip_horizontal(UArray2_T arr)
+{
+        UArray2_T view = UArray2_view_of(arr);
+
+        view->origin     += (arr->width - 1) * arr->col_stride;
+        view->col_stride  = -arr->col_stride;
+        return view;
+}
+
+/*
+ * UArray2_flip_vertical
+ *    Purpose: Makes an upside down view of an array
+ * Parameters: A UArray2_T object
+ *    Returns: A new view of arr, as for UArray2_transpose
+ *    Expects: That the UArray2_T object is valid (checked)
+ */
+UArray2_T UArray2_flip_vertical(UArray2_T arr)
+{
+        UArray2_T view = UArray2_view_of(arr);
+
+        view->origin     += (arr->height - 1) * arr->row_stride;
+        view->row_stride  = -arr->row_stride;
+        return view;
+}
+
+/*
+ * UArray2_rotate
+ *    Purpose: Makes a view of an array rotated clockwise, composed of the
+ *             transpose and flips above (90 is a transpose then a
+ *             horizontal flip, 270 a transpose then a vertical flip)
+ * Parameters: A UArray2_T object and the rotation: 0, 90, 180 or 270
+ *    Returns: A new view of arr, as for UArray2_transpose
+ *    Expects: That the UArray2_T object is valid and the rotation is one of
+ *             those four (both checked)
+ */
+UArray2_T UArray2_rotate(UArray2_T arr, int degrees)
+{
+        UArray2_T step = NULL, view = NULL;
+
+        if (degrees == 0) {
+                return UArray2_view_of(arr);
+        } else if (degrees == 180) {
+                step = UArray2_flip_horizontal(arr);
+                view = UArray2_flip_vertical(step);
+        } else if (degrees == 90) {
+                step = UArray2_transpose(arr);
+                view = UArray2_flip_horizontal(step);
+        } else if (degrees == 270) {
+                step = UArray2_transpose(arr);
+                view = UArray2_flip_vertical(step);
+        } else {
+                RAISE(Bad_coords);
         }
+        UArray2_free(&step);
+        return view;
 }
 
 /*
- * UArray2_coords_to_index
- *    Purpose: Converts col and row coordinates to a single array index
- *             compatible with a Hanson UArray. Col and row can also be
- *             considered the x and y coordinates. Col, or x, measures the
- *             rightward distance from the top-left element. Row, or y,
- *             measures the downward distance from the top-left element.
+ * UArray2_crop
+ *    Purpose: Makes a view of a rectangle of an array
+ * Parameters: A UArray2_T object, the column and row of the rectangle's top
+ *             left element, and its width and height
+ *    Returns: A new view of arr, as for UArray2_transpose
+ *    Expects: That the UArray2_T object is valid and the rectangle is not
+ *             empty and lies inside it (both checked)
+ */
+UArray2_T UArray2_crop(UArray2_T arr, int col, int row, int w, int h)
+{
+        UArray2_T view;
+
+        if (w < 1 || h < 1 || col < 0 || row < 0 || arr == NULL
+            || col > arr->width || w > arr->width - col
+            || row > arr->height || h > arr->height - row) {
+                RAISE(Bad_coords);
+        }
+        view = UArray2_view_of(arr);
+        view->origin = UArray2_address(arr, col, row);
+        view->width  = w;
+        view->height = h;
+        return view;
+}
+
+/*
+ * UArray2_copy
+ *    Purpose: Copies an array or view into a new array of its own, laid
+ *             out row by row. This is the only operation here that moves
+ *             elements, for when a view's layout is no longer good enough
+ *             (say, a transposed view about to be read row by row many
+ *             times).
+ * Parameters: A UArray2_T object
+ *    Returns: The new array, which shares nothing with arr
+ *    Expects: That the UArray2_T object is valid (checked)
+ */
+UArray2_T UArray2_copy(UArray2_T arr)
+{
+        if (arr == NULL) {
+                RAISE(Bad_array);
+        }
+        UArray2_T copy = UArray2_new(arr->width, arr->height, arr->size);
+
+        for (int row = 0; row < arr->height; row++) {
+                char *from = arr->origin + row * arr->row_stride;
+                char *to   = copy->origin + row * copy->row_stride;
+                if (arr->col_stride == arr->size) {
+                        memcpy(to, from, (size_t)arr->width * arr->size);
+                        continue;
+                }
+                for (int col = 0; col < arr->width; col++) {
+                        memcpy(to, from, arr->size);
+                        to   += arr->size;
+                        from += arr->col_stride;
+                }
+        }
+        return copy;
+}
+
+/*
+ * UArray2_address
+ *    Purpose: The address of the element at col and row. Col, or x,
+ *             measures the rightward distance from the top-left element.
+ *             Row, or y, measures the downward distance from the top-left
+ *             element.
  * Parameters: A UArray2_T object, an int for the col coordinate, and an int
  *             for the row coordinate
- *    Returns: an int for the corresponding Hanson UArray coordinate
+ *    Returns: A pointer to the element
  *    Expects: NOT to be used by client code; rather; to only be called
  *             within other UArray2 functions.
  *             Expects that the UArray2_T object is valid, and that col and
  *             row are valid coordinates, that is, that they are within the
- *             dimensions of the UArray2_T object. In other words, col and row
- *             should be from -1 to the width/height of the UArray2_T,
- *             respectively, noninclusive.
+ *             dimensions of the UArray2_T object (checked).
  */
-int  UArray2_coords_to_index(UArray2_T arr, int col, int row)
+static char *UArray2_address(UArray2_T arr, int col, int row)
 {
         if (arr == NULL) {
                 RAISE(Bad_array);
@@ -242,5 +435,40 @@ int  UArray2_coords_to_index(UArray2_T arr, int col, int row)
         if (col < 0 || col >= arr->width || row < 0 || row >= arr->height) {
                 RAISE(Bad_coords);
         }
-        return (row * arr->width) + col;
+        return arr->origin + col * arr->col_stride + row * arr->row_stride;
+}
+
+/*
+ * UArray2_view_of
+ *    Purpose: A new UArray2_T identical to arr that shares its storage,
+ *             for the view functions to adjust
+ * Parameters: A UArray2_T object
+ *    Returns: The new view
+ *    Expects: That the UArray2_T object is valid (checked)
+ */
+static UArray2_T UArray2_view_of(UArray2_T arr)
+{
+        if (arr == NULL) {
+                RAISE(Bad_array);
+        }
+        UArray2_T view = malloc(sizeof(struct UArray2_T));
+        if (view == NULL) {
+                RAISE(Bad_array);
+        }
+        *view = *arr;
+        __sync_add_and_fetch(&arr->store->refs, 1);
+        Memstats_alloc(sizeof(struct UArray2_T), 0);
+        return view;
+}
+
+/*
+ * UArray2_bytes
+ *    Purpose: The number of bytes of element storage a new UArray2_T needs
+ * Parameters: A UArray2_T object
+ *    Returns: width * height * size
+ *    Expects: That the UArray2_T object is valid (unchecked)
+ */
+static long UArray2_bytes(UArray2_T arr)
+{
+        return (long)arr->width * arr->height * arr->size;
 }
@@ -0,0 +1,49 @@
+/***********************************************************************
+ *                              uarray2.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Interface of UArray2_T, the unboxed 2D array behind the plain
+ *          A2Methods suite (a2plain.c). The first block of functions is
+ *          the course interface, unchanged; this copy of it adds views.
+ *
+ *          A view is a new UArray2_T over the elements of another, with
+ *          its own width, height and strides: a transpose, a flip, a
+ *          rotation by a multiple of 90 degrees, or a crop. Making one
+ *          takes O(1) time and moves no element. Views may be made of
+ *          views, and every handle, array or view, is freed with
+ *          UArray2_free; the elements go with the last handle sharing
+ *          them. UArray2_copy is the one function that moves elements,
+ *          into a new array of its own laid out row by row.
+ ***********************************************************************/
+
+#ifndef ARRAY2_INCLUDED
+#define ARRAY2_INCLUDED
+#include "except.h"
+#define T UArray2_T
+typedef struct T *T;
+
+typedef void UArray2_applyfun(int i, int j, T array2, void *elem, void *cl);
+typedef void UArray2_mapfun(T array2, UArray2_applyfun apply, void *cl);
+
+extern T     UArray2_new   (int width, int height, int size);
+extern void  UArray2_free  (T *array2);
+extern int   UArray2_width (T array2);
+extern int   UArray2_height(T array2);
+extern int   UArray2_size  (T array2);
+extern void *UArray2_at    (T array2, int i, int j);
+extern void  UArray2_map_row_major(T array2, UArray2_applyfun apply, void *cl);
+extern void  UArray2_map_col_major(T array2, UArray2_applyfun apply, void *cl);
+
+/* Views: new handles on the same elements, each freed with UArray2_free */
+extern T     UArray2_transpose      (T array2);
+extern T     UArray2_flip_horizontal(T array2);
+extern T     UArray2_flip_vertical  (T array2);
+extern T     UArray2_rotate         (T array2, int degrees);
+extern T     UArray2_crop           (T array2, int i, int j, int width,
+                                     int height);
+extern T     UArray2_copy           (T array2);
+
+/* Raised for coordinates outside an array, or a crop that is not inside */
+extern Except_T Bad_coords;
+#undef T
+#endif
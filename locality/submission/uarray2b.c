@@ -5,7 +5,9 @@
  * By Camille Calabrese (ccalab04) and Sophia Wang (swang30)
  * October 2019 for Comp 40, HW3: Locality
  *
- * The UArray2b relies on a one dimensional Hansen UArray_T. The coordinates
+ * The UArray2b owns one cache line aligned allocation (see storage.h),
+ * or a mapped file (see uarray2b_storage.h), addressed through one
+ * dimensional cell indices. The coordinates
  * translation functions maintain the arrangement of elements in the array.
  * Blocks in the array are organized in a column major structure, but
  * cells within a block are organized in a row major structure. For a
@@ -17,8 +19,8 @@
  * Invariants: Any column coordinate from 0 to width is accessible, and
  *             any row coordinate from 0 to height is accessible. Other
  *             coordinates are inaccessible. Real_width >= width and
- *             real_height >= height. The length of the underlying
- *             UArray_T equals real_width * real_height. The strip of
+ *             real_height >= height. The storage holds
+ *             real_width * real_height cells. The strip of
  *             unused cells around the side of the uarray2b has a width
  *             that's less than blocksize. All int members of the
  *             UArray2b_T struct >= 1.
@@ -30,22 +32,36 @@
  *             dimensional index.
  *
  *             Another is that blocks of the UArray2b are stored
- *             contiguously in memory.
+ *             contiguously in memory, each starting on a cache line
+ *             boundary: a block occupies block_bytes, which is
+ *             blocksize * blocksize * elem_size rounded up to a multiple
+ *             of 64. Blocks smaller than a cache line are not padded, as
+ *             that could multiply the storage several times over; they
+ *             are packed one after another instead.
  *************************************************************************/
 
 #include "uarray2b.h"
-#include "uarray.h"
+#include "uarray2b_storage.h"
 #include "coordinates.h"
+#include "trace.h"
+#include "memstats.h"
+#include "storage.h"
 #include "except.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
 #include <math.h>
+#include <sys/mman.h>
 
 static const int KILOBYTE = 1024;
 
 struct UArray2b_T {
         int width, height, blocksize, elem_size, real_width, real_height;
-        UArray_T array;
+        long block_bytes;       /* distance between block starts */
+        int cell_shift;         /* log2 of cells per block, or -1 */
+        char *array;            /* cache line aligned, see storage.h */
+        char *mapping;          /* for UArray2b_new_mapped, else NULL */
+        long mapping_bytes;
 };
 
 Except_T invalid_input = {"Invalid Parameter"};
@@ -53,6 +69,12 @@ Except_T invalid_input = {"Invalid Parameter"};
         /* Private function prototypes */
 int coords_2D_to_1D(UArray2b_T arr, int col, int row);
 struct Coordinates coords_1D_to_2D(UArray2b_T arr, int i);
+static void init_storage(UArray2b_T arr);
+static void init_shape(UArray2b_T arr);
+static void *cell_address(UArray2b_T arr, int i);
+static long storage_bytes(UArray2b_T arr);
+static long footprint(UArray2b_T arr);
+static long padding(UArray2b_T arr);
 
 
 /*
@@ -83,16 +105,7 @@ extern UArray2b_T UArray2b_new(int w, int h, int size, int blocksize)
         aux->height    = h;
         aux->elem_size = size;
         aux->blocksize = blocksize;
-
-        aux->real_width  = w + (aux->blocksize - (w % aux->blocksize));
-        aux->real_height = h + (aux->blocksize - (h % aux->blocksize));
-        if (w % aux->blocksize == 0) {
-                aux->real_width = w;
-        }
-        if (h % aux->blocksize == 0) {
-                aux->real_height = h;
-        }
-        aux->array     = UArray_new(aux->real_width * aux->real_height, size);
+        init_storage(aux);
 
         return aux;
 }
@@ -131,10 +144,7 @@ extern UArray2b_T UArray2b_new_64K_block(int w, int h, int size)
         if (aux->blocksize < 1) { /* in case one elem is over 64KB */
                 aux->blocksize = 1;
         }
-        aux->real_width  = w + (aux->blocksize - (w % aux->blocksize));
-        aux->real_height = h + (aux->blocksize - (h % aux->blocksize));
-
-        aux->array     = UArray_new(aux->real_width * aux->real_height, size);
+        init_storage(aux);
 
         return aux;
 }
@@ -152,12 +162,103 @@ extern void UArray2b_free(UArray2b_T *array2b)
         if (array2b == NULL || *array2b == NULL) {
                 return;
         }
-        UArray_free(&((*array2b)->array));
+        if ((*array2b)->mapping != NULL) {
+                munmap((*array2b)->mapping, (*array2b)->mapping_bytes);
+        } else {
+                Memstats_free(footprint(*array2b));
+                Storage_free((*array2b)->array, storage_bytes(*array2b));
+        }
         free(*(array2b));
         *array2b = NULL;
         return;
 }
 
+/*
+ * UArray2b_new_mapped
+ *    Purpose: Creates a blocked 2D array over existing block storage (see
+ *             uarray2b_storage.h) instead of allocating its own
+ * Parameters: width, height, element size and blocksize, as for
+ *             UArray2b_new; the start and length of an mmap'ed region,
+ *             which the array now owns; and the offset in that region of
+ *             the first block
+ *    Returns: The blocked 2D array
+ *    Expects: The dimensions are at least 1, the first block is cache line
+ *             aligned, and the region holds every block past the offset
+ *             (checked runtime errors)
+ */
+extern UArray2b_T UArray2b_new_mapped(int w, int h, int size, int blocksize,
+                                      void *mapping, long mapping_bytes,
+                                      long offset)
+{
+        if (w < 1 || h < 1 || size < 1 || blocksize < 1 || mapping == NULL
+            || offset < 0 || offset % STORAGE_ALIGNMENT != 0) {
+                RAISE(invalid_input);
+        }
+        UArray2b_T aux = malloc(sizeof(struct UArray2b_T));
+
+        aux->width     = w;
+        aux->height    = h;
+        aux->elem_size = size;
+        aux->blocksize = blocksize;
+        init_shape(aux);
+        if (offset + storage_bytes(aux) > mapping_bytes) {
+                free(aux);
+                RAISE(invalid_input);
+        }
+        aux->array         = (char *)mapping + offset;
+        aux->mapping       = mapping;
+        aux->mapping_bytes = mapping_bytes;
+
+        return aux;
+}
+
+/*
+ * UArray2b_block_bytes
+ *    Purpose: The distance between the starts of blocks of the given shape
+ *             in the storage of a UArray2b, or of the tiles of a tiled
+ *             image file: the bytes of a block, rounded up to whole cache
+ *             lines unless the block is smaller than one
+ * Parameters: The blocksize and the size of an element in bytes
+ *    Returns: The number of bytes
+ *    Expects: Both are at least 1, and the rounded-up size fits in a long
+ *             (checked runtime errors)
+ */
+extern long UArray2b_block_bytes(int blocksize, int size)
+{
+        long bytes;
+
+        if (blocksize < 1 || size < 1
+            || (long)blocksize * blocksize
+               > (LONG_MAX - STORAGE_ALIGNMENT) / size) {
+                RAISE(invalid_input);
+        }
+        bytes = (long)blocksize * blocksize * size;
+        if (bytes < STORAGE_ALIGNMENT) {
+                return bytes;
+        }
+        return (bytes + STORAGE_ALIGNMENT - 1) / STORAGE_ALIGNMENT
+               * STORAGE_ALIGNMENT;
+}
+
+/*
+ * UArray2b_blocks
+ *    Purpose: Gives access to the block storage of a blocked 2D array
+ * Parameters: The array, and where to put the distance between blocks and
+ *             the number of blocks
+ *    Returns: A pointer to the first block
+ *    Expects: That the array is valid (checked runtime error)
+ */
+extern void *UArray2b_blocks(UArray2b_T array2b, long *block_bytes,
+                             long *nblocks)
+{
+        if (array2b == NULL || block_bytes == NULL || nblocks == NULL) {
+                RAISE(invalid_input);
+        }
+        *block_bytes = array2b->block_bytes;
+        *nblocks     = storage_bytes(array2b) / array2b->block_bytes;
+        return array2b->array;
+}
+
 /*
  * UArray2b_width
  *    Purpose: Returns the width of a blocked 2D array
@@ -240,8 +341,8 @@ extern void *UArray2b_at(UArray2b_T array2b, int col, int row)
                 return NULL;
         }
         else {
-                return UArray_at(array2b->array, coords_2D_to_1D(array2b,
-                                                                col, row));
+                return cell_address(array2b, coords_2D_to_1D(array2b,
+                                                             col, row));
         }
 }
 
@@ -264,13 +365,29 @@ extern void  UArray2b_map(UArray2b_T array2b,
                 RAISE(invalid_input);
         }
         struct Coordinates coords;
+        TRACE_SCOPE(TRACE_DETAIL, "UArray2b_map");
+#if TRACE_LEVEL >= TRACE_LOOP
+        /* the per-block regions cost a division a cell, so they are only
+         * compiled in when asked for */
+        int cells = array2b->blocksize * array2b->blocksize;
+#endif
         for (int i = 0; i < array2b->real_width * array2b->real_height; i++) {
+#if TRACE_LEVEL >= TRACE_LOOP
+                if (i % cells == 0) {
+                        TRACE_BEGIN(TRACE_LOOP, "block");
+                }
+#endif
                 coords = coords_1D_to_2D(array2b, i);
                 if (coords.col != -1 && coords.row != -1) {
                         apply(coords.col, coords.row, array2b,
                               UArray2b_at(array2b, coords.col, coords.row),
                               cl);
                 }
+#if TRACE_LEVEL >= TRACE_LOOP
+                if (i % cells == cells - 1) {
+                        TRACE_END(TRACE_LOOP);
+                }
+#endif
         }
         return;
 }
@@ -278,8 +395,8 @@ extern void  UArray2b_map(UArray2b_T array2b,
 /*
  * coords_2D_to_1D
  *    Purpose: Converts column and row coordinate into one single index i,
- *             which represents the location in the underlying UArray_T that
- *             corresponds with the specified coordinates
+ *             which represents the cell in the underlying storage that
+ *             corresponds with the specified coordinates (see cell_address)
  * Parameters: A UArray2b and ints for the column and row coordinates
  *    Returns: an integer for the one-dimensional index value
  *    Expects: That the UArray2b is valid (checked runtime error), and
@@ -316,8 +433,8 @@ int coords_2D_to_1D(UArray2b_T arr, int col, int row)
 
 /*
  * coords_1D_to_2D
- *    Purpose: Converts a single integer index, representing a slot in the
- *             underlying UArray_T, to the col and row coordinates that
+ *    Purpose: Converts a single integer index, representing a cell in the
+ *             underlying storage, to the col and row coordinates that
  *             correspond to that slot
  * Parameters: A UArray2b and an integer index
  *    Returns: A Coordinates struct with the column and row coordinates that
@@ -358,3 +475,114 @@ struct Coordinates coords_1D_to_2D(UArray2b_T arr, int i)
 
         return c;
 }
+
+/*
+ * init_storage
+ *    Purpose: Shared tail of both allocating constructors. Rounds the
+ *             dimensions up to whole blocks, rounds each block up to whole
+ *             cache lines so that every block starts on a line of its own
+ *             (see init_shape), and allocates the storage.
+ * Parameters: A UArray2b whose width, height, elem_size and blocksize are
+ *             already set
+ *    Returns: Nothing
+ *    Expects: NOT to be called by client code (private)
+ */
+static void init_storage(UArray2b_T arr)
+{
+        init_shape(arr);
+        arr->array         = Storage_alloc(storage_bytes(arr));
+        arr->mapping       = NULL;
+        arr->mapping_bytes = 0;
+        Memstats_alloc(footprint(arr), padding(arr));
+}
+
+/*
+ * init_shape
+ *    Purpose: The part of init_storage that UArray2b_new_mapped shares:
+ *             the real dimensions, the distance between blocks, and the
+ *             shift that cell_address uses when the cells of a block are a
+ *             power of two
+ */
+static void init_shape(UArray2b_T arr)
+{
+        int bs = arr->blocksize;
+        long cells = (long)bs * bs;
+
+        arr->real_width  = (arr->width  + bs - 1) / bs * bs;
+        arr->real_height = (arr->height + bs - 1) / bs * bs;
+        arr->block_bytes = UArray2b_block_bytes(bs, arr->elem_size);
+        arr->cell_shift  = -1;
+        if ((cells & (cells - 1)) == 0) {
+                arr->cell_shift = 0;
+                while (1L << arr->cell_shift < cells) {
+                        arr->cell_shift++;
+                }
+        }
+}
+
+/*
+ * cell_address
+ *    Purpose: Converts a one-dimensional index from coords_2D_to_1D into
+ *             the address of that cell, skipping the cache line padding at
+ *             the end of each block. Without padding the index is the
+ *             cell's place in the storage; with a power of two cells per
+ *             block the block and cell come from a shift and a mask; only
+ *             other blocksizes need a division.
+ * Parameters: A UArray2b and an index in [0, real_width * real_height)
+ *    Returns: A pointer to the cell
+ *    Expects: A valid array and index (unchecked, private)
+ */
+static void *cell_address(UArray2b_T arr, int i)
+{
+        int cells = arr->blocksize * arr->blocksize;
+
+        if (arr->block_bytes == (long)cells * arr->elem_size) {
+                return arr->array + (long)i * arr->elem_size;
+        }
+        if (arr->cell_shift >= 0) {
+                return arr->array + (i >> arr->cell_shift) * arr->block_bytes
+                                  + (long)(i & (cells - 1)) * arr->elem_size;
+        }
+        return arr->array + (i / cells) * arr->block_bytes
+                          + (long)(i % cells) * arr->elem_size;
+}
+
+/*
+ * storage_bytes
+ *    Purpose: The number of bytes of element storage a UArray2b needs: one
+ *             padded block for every block of the real dimensions
+ */
+static long storage_bytes(UArray2b_T arr)
+{
+        long blocks = (long)(arr->real_width / arr->blocksize)
+                      * (arr->real_height / arr->blocksize);
+        return blocks * arr->block_bytes;
+}
+
+/*
+ * footprint
+ *    Purpose: The number of bytes a UArray2b occupies, for memstats,
+ *             including the unused cells that round it up to whole blocks
+ * Parameters: A UArray2b
+ *    Returns: The size of the struct plus the reserved element storage
+ *    Expects: That the UArray2b is valid (unchecked)
+ */
+static long footprint(UArray2b_T arr)
+{
+        return sizeof(struct UArray2b_T) + Storage_round(storage_bytes(arr));
+}
+
+/*
+ * padding
+ *    Purpose: The number of bytes of a UArray2b that no coordinate maps to:
+ *             cells outside width * height, cache line padding at the end
+ *             of each block, and rounding by the allocator
+ * Parameters: A UArray2b
+ *    Returns: The padding in bytes
+ *    Expects: That the UArray2b is valid (unchecked)
+ */
+static long padding(UArray2b_T arr)
+{
+        return Storage_round(storage_bytes(arr))
+               - (long)arr->width * arr->height * arr->elem_size;
+}
@@ -0,0 +1,34 @@
+/***********************************************************************
+ *                         uarray2b_storage.h
+ * Comp 40 HW3: Locality
+ *
+ * Summary: Access to the storage behind a UArray2b, for code that moves
+ *          whole blocks at a time, such as the tiled image files of
+ *          tiled.h, on top of the course's uarray2b.h. The functions
+ *          are implemented in uarray2b.c.
+ *
+ *          The storage is a sequence of blocks in column-major order
+ *          (all the blocks of the first column of blocks, top to bottom,
+ *          then the next column), each holding its cells in row-major
+ *          order and padded to block_bytes (UArray2b_block_bytes): a
+ *          multiple of 64, unless a block is smaller than that, in which
+ *          case blocks are not padded at all.
+ *
+ *          UArray2b_new_mapped builds an array over storage that already
+ *          holds blocks in that order, such as a file mapped with mmap,
+ *          and takes ownership of the mapping: UArray2b_free unmaps it.
+ ***********************************************************************/
+
+#ifndef UARRAY2B_STORAGE_H
+#define UARRAY2B_STORAGE_H
+
+#include "uarray2b.h"
+
+extern UArray2b_T UArray2b_new_mapped(int width, int height, int size,
+                                      int blocksize, void *mapping,
+                                      long mapping_bytes, long offset);
+extern long       UArray2b_block_bytes(int blocksize, int size);
+extern void      *UArray2b_blocks(UArray2b_T array2b, long *block_bytes,
+                                  long *nblocks);
+
+#endif